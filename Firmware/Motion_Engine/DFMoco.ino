@@ -128,39 +128,23 @@
   
   #define SERIAL_DEVICE SerialUSB
   
-  #define PIN_ON(port, pin) { gpio_write_bit(port, pin, HIGH); }
-  #define PIN_OFF(port, pin) { gpio_write_bit(port, pin, LOW); }
-
 #elif DFBOARD == CHIPKITMAX32
 
   #include <plib.h>
 
   #define SERIAL_DEVICE Serial
   
-  #define PIN_ON(port, pin)  { digitalWrite(port, HIGH); }
-  #define PIN_OFF(port, pin) { digitalWrite(port, LOW); }
-
 #elif DFBOARD == NMX
 
-  #include <TimerOne.h>
   #include "OM_MotorMaster.h"
 
   #define KILL_SWITCH_INTERRUPT 1
   #define SERIAL_DEVICE USBSerial
 
-  #define PIN_ON(port, pin)  digitalWrite((pin), HIGH)
-  #define PIN_OFF(port, pin) digitalWrite((pin), LOW)
-
-  void df_TimerHandler(void);
-
 #else
 
   #define SERIAL_DEVICE Serial
-  
-  #define PIN_ON(port, pin)  { port |= pin; }
-  #define PIN_OFF(port, pin) { port &= ~pin; }
-  
-#endif
+  #endif
 
 // Arduino Uno/Duemilanove  -> 4 MOTORS MAX
 // Arduino Mega 2560 / Mega -> 8 MOTORS MAX
@@ -172,156 +156,36 @@
 #define MOTOR_COUNT 8
 #endif
 
+// step core tick in microseconds while DFMoco is running. Check the pf worst
+// case before shortening it.
+#ifndef TIME_CHUNK
 #define TIME_CHUNK 50
+#endif
 #define SEND_POSITION_COUNT 20000
+#define TICKS_PER_SECOND (1000000L / TIME_CHUNK)
+// CPU cycles between two step core ticks
+#define ISR_BUDGET_CYCLES ((F_CPU / 1000000L) * TIME_CHUNK)
 
-// update velocities 20 x second
-#define VELOCITY_UPDATE_RATE (50000 / TIME_CHUNK)
-#define VELOCITY_INC(maxrate) (max(1.0f, maxrate / 70.0f))
-
-// setup step and direction pins
-#if DFBOARD == CHIPKITMAX32
-
-  #define MOTOR0_STEP_PORT 4
-  #define MOTOR0_STEP_PIN  0
-  
-  #define MOTOR1_STEP_PORT 6
-  #define MOTOR1_STEP_PIN  0
-
-  #define MOTOR2_STEP_PORT 8
-  #define MOTOR2_STEP_PIN  0
-
-  #define MOTOR3_STEP_PORT 10
-  #define MOTOR3_STEP_PIN  0
-
-  #if ( PINOUT_VERSION == 2 )
-
-    #define MOTOR4_STEP_PORT 28
-    #define MOTOR4_STEP_PIN  0
-  
-    #define MOTOR5_STEP_PORT 30
-    #define MOTOR5_STEP_PIN  0
-  
-    #define MOTOR6_STEP_PORT 32
-    #define MOTOR6_STEP_PIN  0
-  
-    #define MOTOR7_STEP_PORT 34
-    #define MOTOR7_STEP_PIN  0
-
-  #elif ( PINOUT_VERSION == 1 )
-
-    #define MOTOR4_STEP_PORT 22
-    #define MOTOR4_STEP_PIN  0
-  
-    #define MOTOR5_STEP_PORT 24
-    #define MOTOR5_STEP_PIN  0
-  
-    #define MOTOR6_STEP_PORT 26
-    #define MOTOR6_STEP_PIN  0
-  
-    #define MOTOR7_STEP_PORT 28
-    #define MOTOR7_STEP_PIN  0
-  
-  #endif
-
-#elif DFBOARD == MAPLE
-
-  #define MOTOR0_STEP_PORT GPIOB
-  #define MOTOR0_STEP_PIN  5
-  
-  #define MOTOR1_STEP_PORT GPIOA
-  #define MOTOR1_STEP_PIN  8
-
-  #define MOTOR2_STEP_PORT GPIOA
-  #define MOTOR2_STEP_PIN  10
-
-  #define MOTOR3_STEP_PORT GPIOA
-  #define MOTOR3_STEP_PIN  4
-
-  #if ( PINOUT_VERSION == 2 )
-
-    #define MOTOR4_STEP_PORT GPIOB
-    #define MOTOR4_STEP_PIN  1
-  
-    #define MOTOR5_STEP_PORT GPIOB
-    #define MOTOR5_STEP_PIN  11
-  
-    #define MOTOR6_STEP_PORT GPIOB
-    #define MOTOR6_STEP_PIN  13
-  
-    #define MOTOR7_STEP_PORT GPIOB
-    #define MOTOR7_STEP_PIN  15
-
-  #elif ( PINOUT_VERSION == 1 )
-
-    #define MOTOR4_STEP_PORT GPIOC
-    #define MOTOR4_STEP_PIN  14
-  
-    #define MOTOR5_STEP_PORT GPIOC
-    #define MOTOR5_STEP_PIN  15
-  
-    #define MOTOR6_STEP_PORT GPIOC
-    #define MOTOR6_STEP_PIN  6
-  
-    #define MOTOR7_STEP_PORT GPIOC
-    #define MOTOR7_STEP_PIN  7
-
-  #endif
-  
-#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-
-  #define MOTOR0_STEP_PORT PORTG
-  #define MOTOR0_STEP_PIN  B00100000
-  
-  #define MOTOR1_STEP_PORT PORTH
-  #define MOTOR1_STEP_PIN  B00001000
-
-  #define MOTOR2_STEP_PORT PORTH
-  #define MOTOR2_STEP_PIN  B00100000
-
-  #define MOTOR3_STEP_PORT PORTB
-  #define MOTOR3_STEP_PIN  B00010000
-
-  #if ( PINOUT_VERSION == 2 )
-  
-    #define MOTOR4_STEP_PORT PORTA
-    #define MOTOR4_STEP_PIN  B01000000
-  
-    #define MOTOR5_STEP_PORT PORTC
-    #define MOTOR5_STEP_PIN  B10000000
-  
-    #define MOTOR6_STEP_PORT PORTC
-    #define MOTOR6_STEP_PIN  B00100000
-  
-    #define MOTOR7_STEP_PORT PORTC
-    #define MOTOR7_STEP_PIN  B00001000
-
-  #elif ( PINOUT_VERSION == 1 )
-  
-    #define MOTOR4_STEP_PORT PORTA
-    #define MOTOR4_STEP_PIN  B00000001
-  
-    #define MOTOR5_STEP_PORT PORTA
-    #define MOTOR5_STEP_PIN  B00000100
-  
-    #define MOTOR6_STEP_PORT PORTA
-    #define MOTOR6_STEP_PIN  B00010000
-  
-    #define MOTOR7_STEP_PORT PORTA
-    #define MOTOR7_STEP_PIN  B01000000
-
-  #endif
+// velocity update period in microseconds, a multiple of TIME_CHUNK. 5000 - 50000 are sensible.
+#ifndef VELOCITY_UPDATE_US
+#define VELOCITY_UPDATE_US 10000
+#endif
 
-#elif DFBOARD == NMX
+// update velocities every VELOCITY_UPDATE_US
+#define VELOCITY_UPDATE_RATE (VELOCITY_UPDATE_US / TIME_CHUNK)
+// report positions of moving motors about once a second
+#define SEND_POSITION_UPDATES (1000000L / VELOCITY_UPDATE_US)
 
-  #define MOTOR0_STEP_PORT PORTF
-  #define MOTOR0_STEP_PIN  OM_MOT1_DSTEP
-  
-  #define MOTOR1_STEP_PORT PORTF
-  #define MOTOR1_STEP_PIN  OM_MOT2_DSTEP
+// fixed point formats of the pre-computed moves. times are in ISR ticks (TIME_CHUNK us),
+// velocities in steps/tick << DF_VEL_SHIFT, and accelerations (pre-multiplied by 0.5)
+// in steps/tick^2 << DF_ACC_SHIFT
+#define DF_VEL_SHIFT 24
+#define DF_ACC_SHIFT 40
+#define VELOCITY_INC(maxrate) (max(1.0f, maxrate / 70.0f))
 
-  #define MOTOR2_STEP_PORT PORTF
-  #define MOTOR2_STEP_PIN  OM_MOT3_DSTEP
+// step and direction pins for the NMX, the other boards compute theirs in df_setup()
+// (steps are sent by the shared step core, see OM_StepCore)
+#if DFBOARD == NMX
 
   #define DEBUG_PIN 12
 
@@ -329,24 +193,8 @@
   const uint8_t nmx_dir_pins[]  = { OM_MOT1_DDIR,  OM_MOT2_DDIR,  OM_MOT3_DDIR, };
   const uint8_t nmx_en_pins[]   = { OM_MOT1_DSLP,  OM_MOT2_DSLP,  OM_MOT3_DSLP, };
 
-#else
-
-  #define MOTOR0_STEP_PORT PORTD
-  #define MOTOR0_STEP_PIN  B00010000
-  
-  #define MOTOR1_STEP_PORT PORTD
-  #define MOTOR1_STEP_PIN  B01000000
-
-  #define MOTOR2_STEP_PORT PORTB
-  #define MOTOR2_STEP_PIN  B00000001
-
-  #define MOTOR3_STEP_PORT PORTB
-  #define MOTOR3_STEP_PIN  B00000100
-
 #endif
 
-
-
 /**
  * Serial output specialization
  */
@@ -359,6 +207,22 @@
 #define TX_UDRE  UDRE0
 #define TX_UDR   UDR0
 #endif
+
+/**
+ * Boards with queued serial output. Replies are formatted into txBuf and
+ * written one byte per pass of df_loop(), so they never hold up velocity
+ * updates.
+ */
+#if (DFBOARD == ARDUINOBOARD) || (DFBOARD == ARDUINOMEGA)
+#define DF_QUEUED_TX
+#define TX_READY()  ((TX_UCSRA) & (1 << TX_UDRE))
+#define TX_WRITE(c) { TX_UDR = (c); }
+#elif (DFBOARD == NMX)
+// only write when the USB endpoint has room, so write() never blocks the loop
+#define DF_QUEUED_TX
+#define TX_READY()  (SERIAL_DEVICE.availableForWrite() > 0)
+#define TX_WRITE(c) { SERIAL_DEVICE.write(c); }
+#endif
  
 char txBuf[32];
 char *txBufPtr;
@@ -393,6 +257,8 @@ char *txBufPtr;
 #define CMD_JM         70 // jog motor
 #define CMD_IM         71 // inch motor
 
+#define CMD_PF         80 // ISR performance
+
 
 #define MSG_HI 01
 #define MSG_MM 02
@@ -405,6 +271,7 @@ char *txBufPtr;
 #define MSG_GO 11
 #define MSG_JM 12
 #define MSG_IM 13
+#define MSG_PF 14
 
 
 struct UserCmd
@@ -443,80 +310,15 @@ TxMsgBuffer txMsgBuffer;
  Motor data.
  */
 
-uint16_t           motorAccumulator0;
-uint16_t           motorAccumulator1;
-uint16_t           motorAccumulator2;
-uint16_t           motorAccumulator3;
-#if MOTOR_COUNT > 4
-uint16_t           motorAccumulator4;
-uint16_t           motorAccumulator5;
-uint16_t           motorAccumulator6;
-uint16_t           motorAccumulator7;
-#endif
-uint16_t*          motorAccumulator[MOTOR_COUNT] =
-{
-  &motorAccumulator0, &motorAccumulator1, &motorAccumulator2,
-#if MOTOR_COUNT > 3
-  &motorAccumulator3, 
-#endif
-#if MOTOR_COUNT > 4
-  &motorAccumulator4, &motorAccumulator5, &motorAccumulator6, &motorAccumulator7 
-#endif
-};
-
-uint16_t           motorMoveSteps0;
-uint16_t           motorMoveSteps1;
-uint16_t           motorMoveSteps2;
-uint16_t           motorMoveSteps3;
-#if MOTOR_COUNT > 4
-uint16_t           motorMoveSteps4;
-uint16_t           motorMoveSteps5;
-uint16_t           motorMoveSteps6;
-uint16_t           motorMoveSteps7;
-#endif
-uint16_t*          motorMoveSteps[MOTOR_COUNT] =
-{
-  &motorMoveSteps0, &motorMoveSteps1, &motorMoveSteps2,
-#if MOTOR_COUNT > 3
-  &motorMoveSteps3,
-#endif
-#if MOTOR_COUNT > 4
-  &motorMoveSteps4, &motorMoveSteps5, &motorMoveSteps6, &motorMoveSteps7
-#endif
-};
-
-
-uint16_t           motorMoveSpeed0;
-uint16_t           motorMoveSpeed1;
-uint16_t           motorMoveSpeed2;
-uint16_t           motorMoveSpeed3;
-#if MOTOR_COUNT > 4
-uint16_t           motorMoveSpeed4;
-uint16_t           motorMoveSpeed5;
-uint16_t           motorMoveSpeed6;
-uint16_t           motorMoveSpeed7;
-#endif
-uint16_t         * motorMoveSpeed[MOTOR_COUNT] =
-{
-  &motorMoveSpeed0, &motorMoveSpeed1, &motorMoveSpeed2,
-#if MOTOR_COUNT > 3
-  &motorMoveSpeed3,
-#endif
-#if MOTOR_COUNT > 4
-  &motorMoveSpeed4, &motorMoveSpeed5, &motorMoveSpeed6, &motorMoveSpeed7
-#endif
-};
-
-volatile boolean nextMoveLoaded;
+// worst-case step core time in CPU cycles, as last reported by pf
+uint16_t           isrReportCycles;
 
-
-unsigned int   velocityUpdateCounter;
 byte           sendPositionCounter;
 boolean        hardStopRequested;
 
 byte sendPosition = 0;
 byte motorMoving = 0;
-byte toggleStep = 0;
+byte motorStepping = 0;   // motors with steps in the last queued segment
 
 
 #define P2P_MOVE_COUNT 7
@@ -526,29 +328,29 @@ struct Motor
   byte   stepPin;
   byte   dirPin;
 
-  // pre-computed move
-  float   moveTime[P2P_MOVE_COUNT];
-  int32_t movePosition[P2P_MOVE_COUNT];
-  float   moveVelocity[P2P_MOVE_COUNT];
-  float   moveAcceleration[P2P_MOVE_COUNT];
+  // pre-computed move (fixed point, see DF_VEL_SHIFT)
+  uint32_t moveTime[P2P_MOVE_COUNT];
+  int32_t  movePosition[P2P_MOVE_COUNT];
+  int32_t  moveVelocity[P2P_MOVE_COUNT];
+  int32_t  moveAcceleration[P2P_MOVE_COUNT];
 
-  float   gomoMoveTime[P2P_MOVE_COUNT];
-  int32_t gomoMovePosition[P2P_MOVE_COUNT];
-  float   gomoMoveVelocity[P2P_MOVE_COUNT];
-  float   gomoMoveAcceleration[P2P_MOVE_COUNT];
+  uint32_t gomoMoveTime[P2P_MOVE_COUNT];
+  int32_t  gomoMovePosition[P2P_MOVE_COUNT];
+  int32_t  gomoMoveVelocity[P2P_MOVE_COUNT];
+  int32_t  gomoMoveAcceleration[P2P_MOVE_COUNT];
 
   int       currentMove;
-  float     currentMoveTime;
+  uint32_t  currentMoveTime;
   
   volatile  boolean   dir;
 
   int32_t   position;
   int32_t   destination;
-  float     maxVelocity;
-  float     maxAcceleration;
+  int32_t   maxVelocity;      // steps/sec
+  int32_t   maxAcceleration;  // steps/sec^2
   
   uint16_t  nextMotorMoveSteps;
-  float     nextMotorMoveSpeed;
+  uint16_t  nextMotorMoveSpeed;
 
 };
 
@@ -566,10 +368,6 @@ void killSwitch()
 }
 #endif
 
-#if (DFBOARD == MAPLE)
-  HardwareTimer timer(2);
-#endif
-      
 /*
  * setup() gets called once, at the start of the program.
  */
@@ -578,9 +376,8 @@ void df_setup()
   goMoReady = false;
   lastUserData = 0;
   msgState = MSG_STATE_START;
-  velocityUpdateCounter = 0;
-  sendPositionCounter = 10;
-  nextMoveLoaded = false;
+  sendPositionCounter = SEND_POSITION_UPDATES / 2;
+  motorStepping = 0;
   hardStopRequested = false;
 
 #ifdef DEBUG_PIN
@@ -699,241 +496,15 @@ void df_setup()
 
   sendMessage(MSG_HI, 0);
     
-  // SET UP interrupt timer
-  
-  #if (DFBOARD == CHIPKITMAX32)
-  
-    ConfigIntTimer1(T1_INT_ON | T1_INT_PRIOR_1);
-    OpenTimer1(T1_ON | T1_PS_1_1, F_CPU / (2 * 1000000L / TIME_CHUNK));
-
-  #elif (DFBOARD == ARDUINOBOARD) || (DFBOARD == ARDUINOMEGA)
-
-    TCCR1A = 0;
-    TCCR1B = _BV(WGM13);
-  
-    ICR1 = (F_CPU / 4000000) * TIME_CHUNK; // goes twice as often as time chunk, but every other event turns off pins
-    TCCR1B &= ~(_BV(CS10) | _BV(CS11) | _BV(CS12));
-    TIMSK1 = _BV(TOIE1);
-    TCCR1B |= _BV(CS10);
-
-  #elif (DFBOARD == MAPLE)
-
-    timer.pause();
-    timer.setPeriod(TIME_CHUNK / 2); // in microseconds
-
-    // Set up an interrupt on channel 1
-    timer.setChannel1Mode(TIMER_OUTPUT_COMPARE);
-    timer.setCompare(TIMER_CH1, 1);  // Interrupt 1 count after each update
-    timer.attachCompare1Interrupt(mapleTimerHandler);
-
-    // Refresh the timer's count, prescale, and overflow
-    timer.refresh();
-
-    // Start the timer counting
-    timer.resume();
-
-  #elif (DFBOARD == NMX)
-
-    Timer1.initialize(TIME_CHUNK / 2);
-    Timer1.attachInterrupt(df_TimerHandler);
-
-  #endif
+  // hand the step timer to the segment queue, one tick per TIME_CHUNK
+  stepCoreStartQueue(TIME_CHUNK);
 }
 
-#if (DFBOARD == CHIPKITMAX32)
-extern "C"
-{
-void __ISR(_TIMER_1_VECTOR,ipl3) playSample(void)
-{
-  mT1ClearIntFlag();
-#elif (DFBOARD == MAPLE)
-void mapleTimerHandler(void)
-{
-#elif (DFBOARD == NMX)
-void df_TimerHandler(void)
-{
-#else
-ISR(TIMER1_OVF_vect)
-{
-#endif
-
-  toggleStep = !toggleStep;
-
-  if (toggleStep)
-  {
-    // MOTOR 1
-    if (motorMoveSteps0)
-    {
-      uint16_t a = motorAccumulator0;
-      motorAccumulator0 += motorMoveSpeed0;
-      if (motorAccumulator0 < a)
-      {
-        motorMoveSteps0--;
-        
-        PIN_ON(MOTOR0_STEP_PORT, MOTOR0_STEP_PIN);
-      }
-    }
-
-    // MOTOR 2
-    if (motorMoveSteps1)
-    {
-      uint16_t a = motorAccumulator1;
-      motorAccumulator1 += motorMoveSpeed1;
-      if (motorAccumulator1 < a)
-      {
-        motorMoveSteps1--;
-        
-        PIN_ON(MOTOR1_STEP_PORT, MOTOR1_STEP_PIN);
-      }
-    }
-
-    // MOTOR 3
-    if (motorMoveSteps2)
-    {
-      uint16_t a = motorAccumulator2;
-      motorAccumulator2 += motorMoveSpeed2;
-      if (motorAccumulator2 < a)
-      {
-        motorMoveSteps2--;
-        
-        PIN_ON(MOTOR2_STEP_PORT, MOTOR2_STEP_PIN);
-      }
-    }
-
-#if MOTOR_COUNT > 3
-
-    // MOTOR 4
-    if (motorMoveSteps3)
-    {
-      uint16_t a = motorAccumulator3;
-      motorAccumulator3 += motorMoveSpeed3;
-      if (motorAccumulator3 < a)
-      {
-        motorMoveSteps3--;
-        
-        PIN_ON(MOTOR3_STEP_PORT, MOTOR3_STEP_PIN);
-      }
-    }
-
-#endif
-#if MOTOR_COUNT > 4
-
-    // MOTOR 5
-    if (motorMoveSteps4)
-    {
-      uint16_t a = motorAccumulator4;
-      motorAccumulator4 += motorMoveSpeed4;
-      if (motorAccumulator4 < a)
-      {
-        motorMoveSteps4--;
-        
-        PIN_ON(MOTOR4_STEP_PORT, MOTOR4_STEP_PIN);
-      }
-    }
-
-    // MOTOR 6
-    if (motorMoveSteps5)
-    {
-      uint16_t a = motorAccumulator5;
-      motorAccumulator5 += motorMoveSpeed5;
-      if (motorAccumulator5 < a)
-      {
-        motorMoveSteps5--;
-        
-        PIN_ON(MOTOR5_STEP_PORT, MOTOR5_STEP_PIN);
-      }
-    }
-
-    // MOTOR 7
-    if (motorMoveSteps6)
-    {
-      uint16_t a = motorAccumulator6;
-      motorAccumulator6 += motorMoveSpeed6;
-      if (motorAccumulator6 < a)
-      {
-        motorMoveSteps6--;
-        
-        PIN_ON(MOTOR6_STEP_PORT, MOTOR6_STEP_PIN);
-      }
-    }
-
-    // MOTOR 8
-    if (motorMoveSteps7)
-    {
-      uint16_t a = motorAccumulator7;
-      motorAccumulator7 += motorMoveSpeed7;
-      if (motorAccumulator7 < a)
-      {
-        motorMoveSteps7--;
-        
-        PIN_ON(MOTOR7_STEP_PORT, MOTOR7_STEP_PIN);
-      }
-    }
-
-#endif
-
-  }
-  else
-  {
-    velocityUpdateCounter++;
-    if (velocityUpdateCounter == VELOCITY_UPDATE_RATE)
-    {
-      velocityUpdateCounter = 0;
-      
-      if (sendPositionCounter)
-      {
-        sendPositionCounter--;
-      }
-      
-      for (int i = 0; i < MOTOR_COUNT; i++)
-      {
-        if (*motorMoveSpeed[i] && !motors[i].nextMotorMoveSpeed)
-        {
-          bitSet(sendPosition, i);
-        }
-
-        *motorMoveSteps[i] = motors[i].nextMotorMoveSteps;
-        *motorMoveSpeed[i] = motors[i].nextMotorMoveSpeed;
-        digitalWrite(motors[i].dirPin, motors[i].dir);
-
-        *motorAccumulator[i] = 65535;
-      }
-      nextMoveLoaded = false; // ready for new move
-    }
-    
-    PIN_OFF(MOTOR0_STEP_PORT, MOTOR0_STEP_PIN);
-    PIN_OFF(MOTOR1_STEP_PORT, MOTOR1_STEP_PIN);
-    PIN_OFF(MOTOR2_STEP_PORT, MOTOR2_STEP_PIN);
-    #if MOTOR_COUNT > 3
-      PIN_OFF(MOTOR3_STEP_PORT, MOTOR3_STEP_PIN);
-    #endif
-
-    #if MOTOR_COUNT > 4
-      PIN_OFF(MOTOR4_STEP_PORT, MOTOR4_STEP_PIN);
-      PIN_OFF(MOTOR5_STEP_PORT, MOTOR5_STEP_PIN);
-      PIN_OFF(MOTOR6_STEP_PORT, MOTOR6_STEP_PIN);
-      PIN_OFF(MOTOR7_STEP_PORT, MOTOR7_STEP_PIN);
-    #endif
-  }
-}
-
-#if (DFBOARD == CHIPKITMAX32)
-} // extern "C"
-#endif
-
 /*
  * For stepper-motor timing, every clock cycle counts.
  */
 void df_loop()
 {
-#if (DFBOARD == ARDUINOBOARD || DFBOARD == ARDUINOMEGA)
-  int32_t *ramValues = (int32_t *)malloc(sizeof(int32_t) * MOTOR_COUNT);
-  int32_t *ramNotValues = (int32_t *)malloc(sizeof(int32_t) * MOTOR_COUNT);
-#else
-  int32_t ramValues[MOTOR_COUNT];
-  int32_t ramNotValues[MOTOR_COUNT];
-#endif
-  
   //Restore the motor sleep states
   for (int i = 0; i < MOTOR_COUNT; i++){
 	  bool tempSleep = false;
@@ -943,18 +514,18 @@ void df_loop()
 
   while (true)
   {
-    if (!nextMoveLoaded)
+    if (!stepQueueFull())
       updateMotorVelocities();
     
     processSerialCommand();
     
     // check if we have serial output
-    #if (DFBOARD == ARDUINOBOARD) || (DFBOARD == ARDUINOMEGA)
+    #ifdef DF_QUEUED_TX
     if (*txBufPtr)
     {
-      if ((TX_UCSRA) & (1 << TX_UDRE))
+      if (TX_READY())
       {
-        TX_UDR = *txBufPtr++;
+        TX_WRITE(*txBufPtr++);
   
         // we are done with this msg, get the next one
         if (!*txBufPtr)
@@ -965,7 +536,7 @@ void df_loop()
 
     if (!sendPositionCounter)
     {
-      sendPositionCounter = 20;
+      sendPositionCounter = SEND_POSITION_UPDATES;
 
       byte i;
       for (i = 0; i < MOTOR_COUNT; i++)
@@ -973,8 +544,6 @@ void df_loop()
         if (bitRead(motorMoving, i) || bitRead(sendPosition, i))
         {
           sendMessage(MSG_MP, i);
-//          ramValues[i] = motors[i].position;
-//          ramNotValues[i] = ~motors[i].position;
         }
       }
 
@@ -1015,10 +584,10 @@ void updateMotorVelocities()
       }
       else
       {
-		  float originalMoveTime = df_motor->currentMoveTime;
+		  uint32_t originalMoveTime = df_motor->currentMoveTime;
 		  int originalMove = df_motor->currentMove;
         
-		  df_motor->currentMoveTime += 0.05f;
+		  df_motor->currentMoveTime += VELOCITY_UPDATE_RATE;
         
 		  if (df_motor->currentMoveTime >= df_motor->moveTime[seg])
         {
@@ -1026,8 +595,7 @@ void updateMotorVelocities()
 			  df_motor->currentMove++;
           seg++;
         }
-		  float t = df_motor->currentMoveTime;
-		  int32_t xn = (int32_t)(df_motor->movePosition[seg] + df_motor->moveVelocity[seg] * t + df_motor->moveAcceleration[seg] * t * t); // accel was already multiplied * 0.5
+		  int32_t xn = segmentPosition(m, seg, df_motor->currentMoveTime);
 
 		  int32_t dx = abs(xn - df_motor->position);
 
@@ -1036,7 +604,7 @@ void updateMotorVelocities()
           
 		boolean forward = xn > df_motor->position;
 
-		if (forward != df_motor->dir) // direction setup time 1/20th second should be plenty
+		if (forward != df_motor->dir) // direction setup time of one update period should be plenty
         {
           // revert everything except for dir flag
 			df_motor->currentMoveTime = originalMoveTime;
@@ -1044,7 +612,8 @@ void updateMotorVelocities()
         }
         else
         {
-			df_motor->nextMotorMoveSpeed = max(1, min(65535, dx * 65.6f));
+			// dx steps over one update, with a little margin so they all fit
+			df_motor->nextMotorMoveSpeed = (dx < VELOCITY_UPDATE_RATE) ? max(1, dx * 65600UL / VELOCITY_UPDATE_RATE) : 65535;
 			df_motor->nextMotorMoveSteps = dx;
 			df_motor->position = xn;
         }
@@ -1053,7 +622,34 @@ void updateMotorVelocities()
       }      
     }
   }
-  nextMoveLoaded = true;
+
+  queueMotorVelocities();
+}
+
+/**
+ * Queue the velocities just computed as the next step core segment.
+ */
+
+void queueMotorVelocities()
+{
+  for (int m = 0; m < MOTOR_COUNT; m++)
+  {
+    // report the position once a motor runs out of steps
+    if (bitRead(motorStepping, m) && !motors[m].nextMotorMoveSpeed)
+    {
+      bitSet(sendPosition, m);
+    }
+    bitWrite(motorStepping, m, motors[m].nextMotorMoveSpeed != 0);
+
+    stepQueueSet(m, motors[m].nextMotorMoveSteps, motors[m].nextMotorMoveSpeed, motors[m].dir);
+  }
+
+  stepQueuePush(VELOCITY_UPDATE_RATE);
+
+  if (sendPositionCounter)
+  {
+    sendPositionCounter--;
+  }
 }
 
 /*
@@ -1069,7 +665,77 @@ void setPulsesPerSecond(int motorIndex, uint16_t pulsesPerSecond)
   uint16_t itersPerSecond = 1000000L / TIME_CHUNK;
   
   motors[motorIndex].maxVelocity = pulsesPerSecond;
-  motors[motorIndex].maxAcceleration = pulsesPerSecond * 0.5f;  
+  // integer math, keep at least 1 as stopMotor() and calculatePointToPoint() divide by it
+  motors[motorIndex].maxAcceleration = max(1, pulsesPerSecond / 2);
+}
+
+/*
+ * Fixed point helpers for the move planner. Velocities and accelerations
+ * are passed in steps/sec and steps/sec^2 and converted to the formats
+ * described at DF_VEL_SHIFT.
+ */
+int32_t velocityFixed(int32_t stepsPerSec)
+{
+  return ((int64_t)stepsPerSec << DF_VEL_SHIFT) / TICKS_PER_SECOND;
+}
+
+// returns half the acceleration, ready for the position calculation
+int32_t accelFixed(int32_t stepsPerSec2)
+{
+  return ((int64_t)stepsPerSec2 << (DF_ACC_SHIFT - 1)) / ((int64_t)TICKS_PER_SECOND * TICKS_PER_SECOND);
+}
+
+// current speed of the motor in steps/sec, negative when running backwards
+int32_t currentVelocity(int motorIndex)
+{
+  int32_t v = ((int32_t)motors[motorIndex].nextMotorMoveSpeed * TICKS_PER_SECOND) >> 16;
+  return motors[motorIndex].dir ? v : -v;
+}
+
+uint32_t isqrt64(uint64_t n)
+{
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while (bit > n)
+    bit >>= 2;
+
+  while (bit)
+  {
+    if (n >= root + bit)
+    {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+    bit >>= 2;
+  }
+  return root;
+}
+
+/*
+ * Position t ticks into segment seg of the motor's pre-computed move
+ */
+int32_t segmentPosition(int motorIndex, int seg, uint32_t t)
+{
+  Motor *motor = &motors[motorIndex];
+  int64_t x = ((int64_t)motor->moveVelocity[seg] * t) >> DF_VEL_SHIFT;
+
+  if (motor->moveAcceleration[seg])
+    x += ((((int64_t)motor->moveAcceleration[seg] * t) >> 20) * t) >> (DF_ACC_SHIFT - 20);
+
+  return motor->movePosition[seg] + (int32_t)x;
+}
+
+/*
+ * Velocity t ticks into segment seg of the motor's pre-computed move
+ */
+int32_t segmentVelocity(int motorIndex, int seg, uint32_t t)
+{
+  Motor *motor = &motors[motorIndex];
+  // acceleration is stored halved
+  return motor->moveVelocity[seg] + (int32_t)(((int64_t)motor->moveAcceleration[seg] * t * 2) >> (DF_ACC_SHIFT - DF_VEL_SHIFT));
 }
 
 
@@ -1110,32 +776,31 @@ void stopMotor(int motorIndex)
     motor->moveTime[i] = 0;
     motor->moveVelocity[i] = 0;
     motor->movePosition[i] = 0;
+    motor->moveAcceleration[i] = 0;
   }
 
-  float v = 20 * motors[motorIndex].nextMotorMoveSpeed / (float)65.536;
-  float maxA = motor->maxAcceleration;
-  float maxV = motor->maxVelocity;
+  int32_t v = currentVelocity(motorIndex);
+  int32_t maxA = motor->maxAcceleration;
+  int32_t maxV = motor->maxVelocity;
 
   if (v > maxV)
     v = maxV;
+  if (v < -maxV)
+    v = -maxV;
 
-  if (!motor->dir)
-    v = -v;
-
-  float t = fabs(v / maxA);
+  // time to decelerate to a stop
+  uint32_t t = (uint32_t)abs(v) * TICKS_PER_SECOND / maxA;
 
   motor->moveTime[0] = t;
   motor->movePosition[0] = motor->position;
-  motor->moveVelocity[0] = v;
-  motor->moveAcceleration[0] = (v > 0) ? -maxA : maxA;
+  motor->moveVelocity[0] = velocityFixed(v);
+  motor->moveAcceleration[0] = accelFixed((v > 0) ? -maxA : maxA);
 
   motor->moveTime[1] = 0;
-  motor->movePosition[1] = (int32_t)(motor->movePosition[0] + motor->moveVelocity[0] * t + 0.5f * motor->moveAcceleration[0] * t * t);
+  motor->movePosition[1] = segmentPosition(motorIndex, 0, t);
   motor->moveVelocity[1] = 0;
   motor->moveAcceleration[1] = 0;
 
-  motor->moveAcceleration[0] *= 0.5f;
-
   motor->destination = motor->movePosition[1];
   
   motor->currentMoveTime = 0;
@@ -1288,6 +953,11 @@ byte processUserMessage(char data)
       userCmd.command = CMD_IM;
       msgState = MSG_STATE_DATA;
     }
+    else if (lastUserData == 'p' && data == 'f') // pf -> pf [worst cycles] [cycles per tick]
+    {
+      userCmd.command = CMD_PF;
+      msgState = MSG_STATE_DONE;
+    }
     else
     {
       // error msg? unknown command?
@@ -1429,6 +1099,16 @@ void processSerialCommand()
           }
           break;
 
+        case CMD_PF:
+          parseError = (userCmd.argCount != 0);
+          if (!parseError)
+          {
+            // report the worst case since the last pf and start over
+            isrReportCycles = stepCoreMaxCycles(true);
+            sendMessage(MSG_PF, 0);
+          }
+          break;
+
         case CMD_SM:
           parseError = (userCmd.argCount != 1 || !isValidMotor(motor));
           if (!parseError)
@@ -1509,10 +1189,9 @@ void processSerialCommand()
                  enableMotor(m, true);
                }
             }
+            // nothing is moving, so drop the idle segments and start on the next tick
+            stepQueueClear();
             updateMotorVelocities();
-            noInterrupts();
-            velocityUpdateCounter = VELOCITY_UPDATE_RATE - 1;
-            interrupts();
           }
           break;
           
@@ -1562,7 +1241,7 @@ void processSerialCommand()
  */
 void sendMessage(byte msg, byte motorIndex)
 {
-#if (DFBOARD == ARDUINOBOARD) || (DFBOARD == ARDUINOMEGA)
+#ifdef DF_QUEUED_TX
 
   int i = (unsigned int)(txMsgBuffer.head + 1) % TX_MSG_BUF_SIZE;
 
@@ -1629,6 +1308,7 @@ void sendMessage(byte msg, byte motorIndex)
       SERIAL_DEVICE.print("bf ");
       SERIAL_DEVICE.print(goMoDelayTime);
       SERIAL_DEVICE.print("\r\n");
+      break;
     case MSG_JM:
       SERIAL_DEVICE.print("jm ");
       SERIAL_DEVICE.print(motorIndex + 1);
@@ -1639,14 +1319,67 @@ void sendMessage(byte msg, byte motorIndex)
       SERIAL_DEVICE.print(motorIndex + 1);
       SERIAL_DEVICE.print("\r\n");
       break;
+    case MSG_PF:
+      SERIAL_DEVICE.print("pf ");
+      SERIAL_DEVICE.print(isrReportCycles);
+      SERIAL_DEVICE.print(" ");
+      SERIAL_DEVICE.print(ISR_BUDGET_CYCLES);
+      SERIAL_DEVICE.print("\r\n");
+      break;
   }
 #endif
 }
 
-#if (DFBOARD == ARDUINOBOARD) || (DFBOARD == ARDUINOMEGA)
+#ifdef DF_QUEUED_TX
+/*
+ * Appends a string to the message being built, returning the new end
+ */
+char *txAppend(char *bufPtr, const char *str)
+{
+  while (*str)
+    *bufPtr++ = *str++;
+  return bufPtr;
+}
+
+/*
+ * Appends a number in decimal, returning the new end
+ */
+char *txAppendInt(char *bufPtr, int32_t value)
+{
+  char digits[10];
+  byte count = 0;
+  uint32_t n = value;
+
+  if (value < 0)
+  {
+    *bufPtr++ = '-';
+    n = -n;
+  }
+
+  do
+  {
+    digits[count++] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+
+  while (count)
+    *bufPtr++ = digits[--count];
+
+  return bufPtr;
+}
+
+/*
+ * Appends " <motor number>"
+ */
+char *txAppendMotor(char *bufPtr, byte motorIndex)
+{
+  *bufPtr++ = ' ';
+  return txAppendInt(bufPtr, motorIndex + 1);
+}
+
 void nextMessage()
 {
-  char *bufPtr;
+  char *bufPtr = txBuf;
   int i;
   
   if ((TX_MSG_BUF_SIZE + txMsgBuffer.head - txMsgBuffer.tail) % TX_MSG_BUF_SIZE)
@@ -1658,42 +1391,66 @@ void nextMessage()
     switch (msg)
     {
       case MSG_HI:
-        sprintf(txBuf, "hi %d %d %s\r\n", DFMOCO_VERSION, MOTOR_COUNT, DFMOCO_VERSION_STRING);
+        bufPtr = txAppend(bufPtr, "hi ");
+        bufPtr = txAppendInt(bufPtr, DFMOCO_VERSION);
+        *bufPtr++ = ' ';
+        bufPtr = txAppendInt(bufPtr, MOTOR_COUNT);
+        *bufPtr++ = ' ';
+        bufPtr = txAppend(bufPtr, DFMOCO_VERSION_STRING);
         break;
       case MSG_MM:
-        sprintf(txBuf, "mm %d %ld\r\n", motorIndex + 1, motors[motorIndex].destination);
+        bufPtr = txAppend(bufPtr, "mm");
+        bufPtr = txAppendMotor(bufPtr, motorIndex);
+        *bufPtr++ = ' ';
+        bufPtr = txAppendInt(bufPtr, motors[motorIndex].destination);
         break;
       case MSG_MP:
-        sprintf(txBuf, "mp %d %ld\r\n", motorIndex + 1, motors[motorIndex].position);
+        bufPtr = txAppend(bufPtr, "mp");
+        bufPtr = txAppendMotor(bufPtr, motorIndex);
+        *bufPtr++ = ' ';
+        bufPtr = txAppendInt(bufPtr, motors[motorIndex].position);
         break;
       case MSG_MS:
-        sprintf(txBuf, "ms ");
-        bufPtr = txBuf + 3;
+        bufPtr = txAppend(bufPtr, "ms ");
         for (i = 0; i < MOTOR_COUNT; i++)
           *bufPtr++ = bitRead(motorMoving, i) ? '1' : '0';
-        *bufPtr++ = '\r';
-        *bufPtr++ = '\n';
-        *bufPtr = 0;
         break;
       case MSG_PR:
-        sprintf(txBuf, "pr %d %u\r\n", motorIndex + 1, (uint16_t)motors[motorIndex].maxVelocity);
+        bufPtr = txAppend(bufPtr, "pr");
+        bufPtr = txAppendMotor(bufPtr, motorIndex);
+        *bufPtr++ = ' ';
+        bufPtr = txAppendInt(bufPtr, (uint16_t)motors[motorIndex].maxVelocity);
         break;
       case MSG_SM:
-        sprintf(txBuf, "sm %d\r\n", motorIndex + 1);
+        bufPtr = txAppend(bufPtr, "sm");
+        bufPtr = txAppendMotor(bufPtr, motorIndex);
         break;
       case MSG_SA:
-        sprintf(txBuf, "sa\r\n");
+        bufPtr = txAppend(bufPtr, "sa");
         break;
       case MSG_BF:
-        sprintf(txBuf, "bf %d\r\n", goMoDelayTime);
+        bufPtr = txAppend(bufPtr, "bf ");
+        bufPtr = txAppendInt(bufPtr, goMoDelayTime);
         break;
       case MSG_JM:
-        sprintf(txBuf, "jm %d\r\n", motorIndex + 1);
+        bufPtr = txAppend(bufPtr, "jm");
+        bufPtr = txAppendMotor(bufPtr, motorIndex);
         break;
       case MSG_IM:
-        sprintf(txBuf, "im %d\r\n", motorIndex + 1);
+        bufPtr = txAppend(bufPtr, "im");
+        bufPtr = txAppendMotor(bufPtr, motorIndex);
+        break;
+      case MSG_PF:
+        bufPtr = txAppend(bufPtr, "pf ");
+        bufPtr = txAppendInt(bufPtr, isrReportCycles);
+        *bufPtr++ = ' ';
+        bufPtr = txAppendInt(bufPtr, ISR_BUDGET_CYCLES);
         break;
     }
+
+    *bufPtr++ = '\r';
+    *bufPtr++ = '\n';
+    *bufPtr = 0;
     
     txBufPtr = txBuf;
   }
@@ -1704,7 +1461,7 @@ boolean jogMotor(int motorIndex, int32_t target, int32_t * destination)
 {
   Motor *motor = &motors[motorIndex];
   // ideally send motor to distance where decel happens after 2 seconds
-  float vi = (motor->dir ? 1 : -1) * 20 * motor->nextMotorMoveSpeed / 65.536f;
+  float vi = currentVelocity(motorIndex);
   
   int dir = (target > motor->position) ? 1 : -1;
   // if switching direction, just stop
@@ -1794,7 +1551,7 @@ void inchMotor(int motorIndex, int32_t target)
     motor->moveAcceleration[i] = 0;
   }
   motor->currentMoveTime = 0;
-  motor->moveTime[0] = 0.01f;
+  motor->moveTime[0] = TICKS_PER_SECOND / 100;
   motor->movePosition[0] = motor->position;
   motor->movePosition[1] = motor->position + dir * 2;
   motor->currentMove = 0;
@@ -1824,23 +1581,27 @@ void calculatePointToPoint(int motorIndex, int32_t destination)
   motor->currentMoveTime = 0;
   motor->movePosition[0] = motor->position;
 
-  float tmax = motor->maxVelocity / motor->maxAcceleration;
-  float dmax = motor->maxVelocity * tmax;
+  int32_t maxV = motor->maxVelocity;
+  int32_t maxA = motor->maxAcceleration;
+
+  // time to reach max velocity, and the distance covered accelerating to it and back down
+  uint32_t tmax = (uint32_t)maxV * TICKS_PER_SECOND / maxA;
+  int32_t dmax = (int64_t)maxV * maxV / maxA;
   
-  float dist = abs(destination - motor->position);
+  int32_t dist = abs(destination - motor->position);
   int dir = destination > motor->position ? 1 : -1;
   
   if (motor->nextMotorMoveSpeed > 5) // we need to account for existing velocity
   {
-    float vi = (motor->dir ? 1 : -1) * 20 * motor->nextMotorMoveSpeed / 65.536f;
-    float ti = fabs(vi / motor->maxAcceleration);
-    float di = 0.5f * motor->maxAcceleration * ti * ti;
+    int32_t vi = currentVelocity(motorIndex);
+    uint32_t ti = (uint32_t)abs(vi) * TICKS_PER_SECOND / maxA;
+    int32_t di = (int64_t)vi * vi / (2 * maxA);
     
     if (vi * dir < 0) // switching directions
     {
       motor->moveTime[moveCount] = ti;
-      motor->moveAcceleration[moveCount] = dir * motor->maxAcceleration;
-      motor->moveVelocity[moveCount] = vi;
+      motor->moveAcceleration[moveCount] = accelFixed(dir * maxA);
+      motor->moveVelocity[moveCount] = velocityFixed(vi);
       moveCount++;
       
       dist += di;
@@ -1848,8 +1609,8 @@ void calculatePointToPoint(int motorIndex, int32_t destination)
     else if (dist < di) // must decelerate and switch directions
     {
       motor->moveTime[moveCount] = ti;
-      motor->moveAcceleration[moveCount] = -dir * motor->maxAcceleration;
-      motor->moveVelocity[moveCount] = vi;
+      motor->moveAcceleration[moveCount] = accelFixed(-dir * maxA);
+      motor->moveVelocity[moveCount] = velocityFixed(vi);
       moveCount++;
 
       dist = (di - dist);
@@ -1864,40 +1625,36 @@ void calculatePointToPoint(int motorIndex, int32_t destination)
     }
   }
 
-  float t = tmax;
+  uint32_t t = tmax;
   if (dist <= dmax)
   {
-    t = sqrt(dist / motor->maxAcceleration);
+    // t = sqrt(dist / a), in ticks
+    t = isqrt64((uint64_t)dist * TICKS_PER_SECOND * TICKS_PER_SECOND / maxA);
   }
     
   motor->moveTime[moveCount] = t;
-  motor->moveAcceleration[moveCount] = dir * motor->maxAcceleration;
+  motor->moveAcceleration[moveCount] = accelFixed(dir * maxA);
   
   if (dist > dmax)
   {
     moveCount++;
     dist -= dmax;
-    float tconst = dist / motor->maxVelocity;
-    motor->moveTime[moveCount] = tconst;
+    motor->moveTime[moveCount] = (int64_t)dist * TICKS_PER_SECOND / maxV;
     motor->moveAcceleration[moveCount] = 0;
   }
 
   moveCount++;
   motor->moveTime[moveCount] = t;
-  motor->moveAcceleration[moveCount] = dir * -motor->maxAcceleration;
+  motor->moveAcceleration[moveCount] = accelFixed(-dir * maxA);
 
 
   for (i = 1; i <= moveCount; i++)
   {
-    float t = motor->moveTime[i - 1];
-    motor->movePosition[i] = (int32_t)(motor->movePosition[i - 1] + motor->moveVelocity[i - 1] * t + 0.5f * motor->moveAcceleration[i - 1] * t * t);
-    motor->moveVelocity[i] = motor->moveVelocity[i - 1] + motor->moveAcceleration[i - 1] * t;
+    uint32_t t = motor->moveTime[i - 1];
+    motor->movePosition[i] = segmentPosition(motorIndex, i - 1, t);
+    motor->moveVelocity[i] = segmentVelocity(motorIndex, i - 1, t);
   }
   motor->movePosition[moveCount + 1] = destination;
-  for (i = 0; i <= moveCount; i++)
-  {
-    motor->moveAcceleration[i] *= 0.5f; // pre-multiply here for later position calculation
-  }
   motor->currentMove = 0;
   
   return;
@@ -1909,13 +1666,11 @@ void setupBlur(int motorIndex, int exposure, int blur, int32_t p0, int32_t p1, i
   Motor *motor = &motors[motorIndex];
   int i;
   
-  float b = blur / 1000.0f;
-  float expTime = exposure / 1000.0f;
-  
-  p0 = p1 + b * (p0 - p1);
-  p2 = p1 + b * (p2 - p1);
+  // blur is in 1/1000ths, exposure in ms
+  p0 = p1 + (int64_t)blur * (p0 - p1) / 1000;
+  p2 = p1 + (int64_t)blur * (p2 - p1) / 1000;
   
-  float speedFactor = ( (1000.0f / exposure) );
+  uint32_t halfExp = (uint32_t)exposure * TICKS_PER_SECOND / 2000;
 
   for (i = 0; i < P2P_MOVE_COUNT; i++)
   {
@@ -1925,31 +1680,29 @@ void setupBlur(int motorIndex, int exposure, int blur, int32_t p0, int32_t p1, i
   }
   
   motor->gomoMovePosition[1] = p0;
-  motor->gomoMoveTime[1] = expTime * 0.5f;
-  motor->gomoMoveVelocity[1] = (float)(p1 - p0) / (expTime * 0.5f);
+  motor->gomoMoveTime[1] = halfExp;
+  motor->gomoMoveVelocity[1] = ((int64_t)(p1 - p0) << DF_VEL_SHIFT) / halfExp;
 
   motor->gomoMovePosition[2] = p1;
-  motor->gomoMoveTime[2] = expTime * 0.5f;
-  motor->gomoMoveVelocity[2] = (float)(p2 - p1) / (expTime * 0.5f);
+  motor->gomoMoveTime[2] = halfExp;
+  motor->gomoMoveVelocity[2] = ((int64_t)(p2 - p1) << DF_VEL_SHIFT) / halfExp;
 
-  // v = a*t -> a = v / t
-  float accelTime = 1.0f;
-  float a = motor->gomoMoveVelocity[1] / accelTime;
-  float dp = 0.5f * a * accelTime * accelTime;
-  float sp = p0 - dp; // starting position
+  // accelerate to speed over one second: v = a*t -> a = v / t, covering v*t / 2
+  uint32_t accelTime = TICKS_PER_SECOND;
+  int32_t dp = (int64_t)(p1 - p0) * 1000 / exposure;
+  int32_t sp = p0 - dp; // starting position
 
   motor->gomoMovePosition[0] = sp;
   motor->gomoMoveTime[0] = accelTime;
-  motor->gomoMoveAcceleration[0] = 0.5f * a; // pre-multiplied
+  motor->gomoMoveAcceleration[0] = ((int64_t)motor->gomoMoveVelocity[1] << (DF_ACC_SHIFT - DF_VEL_SHIFT)) / (2 * (int32_t)accelTime); // pre-multiplied
 
-  a = motor->gomoMoveVelocity[2] / accelTime;
-  dp = 0.5f * a * accelTime * accelTime;
-  float fp = p2 + dp;
+  dp = (int64_t)(p2 - p1) * 1000 / exposure;
+  int32_t fp = p2 + dp;
 
   motor->gomoMovePosition[3] = p2;
   motor->gomoMoveTime[3] = accelTime;
   motor->gomoMoveVelocity[3] = motor->gomoMoveVelocity[2];
-  motor->gomoMoveAcceleration[3] = -0.5f * a; // pre-multiplied
+  motor->gomoMoveAcceleration[3] = -((int64_t)motor->gomoMoveVelocity[2] << (DF_ACC_SHIFT - DF_VEL_SHIFT)) / (2 * (int32_t)accelTime); // pre-multiplied
 
   motor->gomoMovePosition[4] = fp;
 
@@ -28,6 +28,7 @@ class DebugClass
 	const static byte DB_GEN_SER	= B00001000;	// Debug flag -- toggles output of responses to certain serial commands
 	const static byte DB_FUNCT		= B00010000;	// Debug flag -- toggles output of debug messages within most functions
 	const static byte DB_CONFIRM	= B00100000;	// Debug flag -- toggles output of success and failure messages in response to serial commands
+	const static byte DB_BINLOG		= B01000000;	// Debug flag -- toggles binary log records (OM_Log.h) in place of text
 
 	void setState(byte state);		
 	byte getState();
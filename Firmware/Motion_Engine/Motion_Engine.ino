@@ -35,6 +35,8 @@ See dynamicperception.com for more information
 
 #include "OMMoCoPrint.h"
 #include "Debug.h"
+#include "OM_Log.h"
+#include "OM_Profile.h"
 #include <MsTimer2.h>
 #include <TimerOne.h>
 #include <EEPROM.h>
@@ -76,22 +78,22 @@ See dynamicperception.com for more information
 const int EE_ADDR       = 0;				// device_address (2 bytes)
 const int EE_NAME       = 2;				// device name (16 bytes)
 
-const int EE_POS_0   = EE_NAME    + 10;		// Motor 0 current position (long int)
-const int EE_END_0   = EE_POS_0   + 4;		// Motor 0 end limit position (long int)
+const int EE_RSVD_0  = EE_NAME    + 10;		// Motor 0 reserved, was the current position (long int)
+const int EE_END_0   = EE_RSVD_0  + 4;		// Motor 0 end limit position (long int)
 const int EE_START_0 = EE_END_0   + 4;		// Motor 0 program start position (long int)
 const int EE_STOP_0  = EE_START_0 + 4;		// Motor 0 program stop position (long int)
 const int EE_MS_0    = EE_STOP_0  + 4;		// Motor 0 microstep value (byte)
 const int EE_SLEEP_0 = EE_MS_0    + 1;		// Motor 0 sleep state (byte)
 
-const int EE_POS_1   = EE_SLEEP_0 + 1;		// Motor 1 current position (long int)
-const int EE_END_1   = EE_POS_1   + 4;		// Motor 1 end limit position (long int)
+const int EE_RSVD_1  = EE_SLEEP_0 + 1;		// Motor 1 reserved, was the current position (long int)
+const int EE_END_1   = EE_RSVD_1  + 4;		// Motor 1 end limit position (long int)
 const int EE_START_1 = EE_END_1   + 4;		// Motor 1 program start position (long int)
 const int EE_STOP_1  = EE_START_1 + 4;		// Motor 1 program stop position (long int)
 const int EE_MS_1    = EE_STOP_1  + 4;		// Motor 1 microstep value (byte)
 const int EE_SLEEP_1 = EE_MS_1    + 1;		// Motor 0 sleep state (byte)
 
-const int EE_POS_2   = EE_SLEEP_1 + 1;		// Motor 2 current position (long int)
-const int EE_END_2   = EE_POS_2   + 4;		// Motor 2 end limit position (long int)
+const int EE_RSVD_2  = EE_SLEEP_1 + 1;		// Motor 2 reserved, was the current position (long int)
+const int EE_END_2   = EE_RSVD_2  + 4;		// Motor 2 end limit position (long int)
 const int EE_START_2 = EE_END_2   + 4;		// Motor 2 program start position (long int)
 const int EE_STOP_2  = EE_START_2 + 4;		// Motor 2 program stop position (long int)
 const int EE_MS_2    = EE_STOP_2  + 4;		// Motor 2 microstep value (byte)
@@ -103,6 +105,13 @@ const int EE_LOAD_END		 = EE_LOAD_START_STOP + 1;	// Whether to load the motors'
 
 const int EE_MOTOR_MEMORY_SPACE = 18;		//Number of bytes required for storage for each motor's variables
 
+// Current positions are journaled into a ring of records rather than rewritten in place,
+// so the cells are worn evenly. EE_RSVD_x keep their bytes so the offsets after them don't
+// move. Each record is: sequence (2 bytes), 3 positions (long int), checksum (byte)
+const int EE_POS_JOURNAL		= EE_LOAD_END + 1;	// First byte of the position journal
+const byte EE_JOURNAL_RECORD	= 15;				// Bytes per journal record
+const byte EE_JOURNAL_SLOTS		= 8;				// Number of records in the ring
+
 // Variables that are loaded from EEPROM that determine whether the motors' various positions should be restored
 uint8_t ee_load_curPos = false;
 uint8_t ee_load_endPos = false;
@@ -232,8 +241,9 @@ const byte MOTOR_COUNT = 3;									// Number of motors possibly attached to con
 #define EIGHTH			8
 #define SIXTHEENTH		16
 
-uint8_t ISR_On = false;
-char byteFired = 0;				// Byte used to toggle the step pin for each motor within the ISR
+volatile uint8_t ISR_On = false;
+volatile uint8_t motionDone = false;	// Set by the step ISR when the last motor stops, cleared in loop()
+byte stepMask[MOTOR_COUNT];				// Step pin bit of each motor within the step register
 
 // This is used because setting the end position in the motor library causes the NMX communications to lock up.
 // That really ought to be looked into...
@@ -307,6 +317,7 @@ byte joystick_mode = false;
 
 ****************************************/
 
+const byte KF_MAX_POINTS = 10;							// Most key frames accepted per axis
 KeyFrames kf[MOTOR_COUNT] = { KeyFrames(), KeyFrames(), KeyFrames() };
 unsigned long kf_start_time;
 unsigned long kf_last_update;
@@ -449,6 +460,7 @@ void setup() {
 		motor[i].sleep(false);
 		motor[i].backlash(MOT_DEFAULT_BACKLASH);
 		motor[i].easing(OM_MOT_QUAD);
+		scurveEasing(i, false);
 		motor[i].startPos(0);
 		motor[i].stopPos(0);
 		motor[i].units(INCH);
@@ -464,6 +476,9 @@ void setup() {
 
 	// restore/store eeprom memory
 	eepromCheck();
+
+	// Start a background motor attach check, so the first attach query has a result
+	attachStart();
  
 	// enable limit switch handler
 	// limitSwitch(true);
@@ -483,85 +498,13 @@ void setup() {
 
 void loop() {
 
-	static unsigned long estop_time = 0; // Remembers last time eStop was NOT pressed
-	static unsigned long df_time = 0;
-	static unsigned long debug_time = 0;
-
-	// check to see if we have any commands waiting      
-	Node.check();
-	NodeBlue.check();
-	NodeUSB.check();
-
-	// Only do these things every 100ms so we don't waste cycles during every loop
-	if ((millis() - df_time) > 100) {		
-		// If eStop button has been held more than 3 sec, switch to DF mode
-		if (digitalRead(ESTOP_PIN) == HIGH)
-			estop_time = millis();
-		else if (!df_mode && millis() - estop_time > 3000) {
-			ledChase(2);
-			debug.funct("Entering DF mode");
-			// Change motors to 8th stepping before starting DF mode
-			for (byte i = 0; i < MOTOR_COUNT; i++){
-				motor[i].ms(8);
-			}
-			df_mode = true;
-			return;
-		}
-					
-		// If the the DB_STEPS debug flag is true, print diagnostic info
-		if (df_mode) {
-			df_setup();
-			df_loop();
-			return;
-		}
-		df_time = millis();
-	}	
-
-	// Print debug information if necessary
-	if ((millis() - debug_time) > 500) {
-		//USBSerial.print("Free memory: ");
-		//USBSerial.println(freeMemory());
-		//motorDebug();
-		debug_time = millis();
-	}		
-
-	//Stop the motors if they're running, watchdog is active, and time since last received command has exceeded timeout
-	if (watchdog_active && (millis() - commandTime > WATCHDOG_MAX_TIME)){
-		for (byte i = 0; i < MOTOR_COUNT; i++){
-			if (motor[i].running()){
-				stopAllMotors();
-				break;
-			}
-		}
-	}	
-   
-	// Update motor splines
-	for(int i = 0; i < MOTOR_COUNT; i++){
-		if(motor[i].running())
-			motor[i].updateSpline();
-	}	  
-	  
-	// If a classic-style program is running   
-   if( running ) {
-	   updateLegacyProgram();
-   }
-   // If a key frame program is running
-   else if (kf_running){
-	   kf_updateProgram();	   
-   }
-
-   // Check if any motors are being sent and restore their old microstep settings when they stop
-   for (int i = 0; i < MOTOR_COUNT; i++){
-	   if (motor[i].isSending() && !motor[i].running()){
-		   motor[i].setSending(false);
-		   motor[i].restoreLastMs();
-	   }
-   }
+	// All of the periodic work is in the task table, see OM_Scheduler
+	schedRun();
 }
 
 void updateLegacyProgram(){
-	// update program run time
-	unsigned long cur_time = millis();
+	// update program run time, on the clock shared with the other nodes
+	unsigned long cur_time = syncMillis();
 	static unsigned long last_blink;
 	const int BLINK_DELAY = 500;
 	if (run_time == 0){
@@ -627,6 +570,9 @@ void pauseProgram() {
 
 void stopProgram(uint8_t force_clear) {
 
+	// abandon any start still in progress
+	startCancel();
+
 	// stop/clear program
 	stopAllMotors();
 	if( force_clear == true ) {
@@ -650,7 +596,7 @@ void stopProgram(uint8_t force_clear) {
 
 void startProgram() {
   // start program
-  start_time = millis();
+  start_time = syncMillis();
 
   running = true;
 	for( int i = 0; i < MOTOR_COUNT; i++){
@@ -760,6 +706,7 @@ byte getRunStatus(){
 	const byte DELAY		= B00001000;
 	const byte KEEPALIVE	= B00010000;
 	const byte PINGPONG		= B00100000;
+	const byte STARTING		= B01000000;
 
 	if (running){
 		status |= RUNNING;
@@ -787,6 +734,9 @@ byte getRunStatus(){
 	if (pingPongMode()){
 		status |= PINGPONG;
 	}	
+	if (startPending()){
+		status |= STARTING;
+	}
 	return status;
 }
 
@@ -798,10 +748,27 @@ byte getRunStatus(){
 
 */
 
-uint8_t programPercent() {
+// Program geometry, cached by updateProgramGeometry() until a setting it depends on changes
+boolean program_geometry_dirty	= true;
+unsigned long program_longest_move	= 0;	// Longest enabled motor's lead-in + travel + lead-out (shots for SMS, otherwise ms)
+unsigned long program_total_time	= 0;	// Total program run time incl. start delay (ms)
 
-	unsigned long time = millis();
-	static uint8_t percent = 0;
+/** Mark Program Geometry Dirty
+
+ Call after changing anything the program length depends on: a motor's
+ leads, travel or enable state, the program type, the camera interval or
+ max shots, or the start delay.
+ */
+
+void programGeometryDirty() {
+	program_geometry_dirty = true;
+}
+
+ // Recomputes the cached program geometry if a setting has changed since the last time
+void updateProgramGeometry() {
+
+	if (!program_geometry_dirty)
+		return;
 
 	unsigned long longest_move = 0;
 
@@ -812,32 +779,52 @@ uint8_t programPercent() {
 		if (!motor[i].enable())
 			continue;
 
-		unsigned long current_move;
-
-		current_move = motor[i].planLeadIn() + motor[i].planTravelLength() + motor[i].planLeadIn();
+		unsigned long current_move = motor[i].planLeadIn() + motor[i].planTravelLength() + motor[i].planLeadOut();
 
 		// Update the longest move if necessary
 		if (current_move > longest_move)
 			longest_move = current_move;
-
 	}
 
-	uint8_t percent_new;
+	// SMS: Total the exposures for the program and multiply by the interval, or by the time each move really
+	// takes if the interval is too short for it
+	// CONT_TL AND CONT_VID: all segments are in milliseconds, no need to multiply anything
+	if (Motors::planType() == SMS)
+		program_total_time = max(Camera.intervalTime(), smsMinInterval()) * longest_move;
+	else
+		program_total_time = longest_move;
+
+	// Add the program delay
+	program_total_time += start_delay;
 
 	// If in SMS mode and the camera max shots is less than the longest motor move, use that value instead
 	if (Motors::planType() == SMS && Camera.getMaxShots() < longest_move)
 		longest_move = Camera.getMaxShots();
 
-	// Determine the program percent completion by dividing the current shots by the max shots.
-	// Multiply by 100 to give whole number percent.
+	program_longest_move = longest_move;
+	program_geometry_dirty = false;
+}
+
+uint8_t programPercent() {
+
+	static uint8_t percent = 0;
+
+	updateProgramGeometry();
+
+	unsigned long done;
 
 	// Determine the percent completion for SMS based on shots
 	if (Motors::planType() == SMS)
-		percent_new = round((float)camera_fired / (float)longest_move * 100.0);
-
+		done = camera_fired;
 	// Otherwise determine the percent completion based on run-time (don't include the start delay)
 	else
-		percent_new = round((float)(run_time - start_delay) / (float)longest_move * 100.0);
+		done = run_time > start_delay ? run_time - start_delay : 0;
+
+	uint8_t percent_new = 0;
+
+	// Rounded whole number percent, done in 64 bits as long programs overflow done * 100
+	if (program_longest_move > 0)
+		percent_new = min(((uint64_t)done * PERCENT_CONVERT + program_longest_move / 2) / program_longest_move, (uint64_t)PERCENT_CONVERT);
 
 	// If the newly calculated percent complete is 0 and the last percent complete was non-zero, then the program has finished and the program should report 100% completion
 	// Don't execute this behavior in Graffik mode
@@ -851,29 +838,8 @@ uint8_t programPercent() {
 // Returns the total run time of the currently set program in milliseconds
 unsigned long totalProgramTime() {
 
-	unsigned long longest_time = 0;
-	unsigned long motor_time = 0;
-
-	for (byte i = 0; i < MOTOR_COUNT; i++) {
-		// If the motor is enabled, check its program time
-		if (motor[i].enable()) {
-			// SMS: Total the exposures for the program and multiply by the interval
-			if (motor[i].planType() == SMS) {
-				motor_time = Camera.intervalTime() * (motor[i].planLeadIn() + motor[i].planTravelLength() + motor[i].planLeadOut());
-			}
-			// CONT_TL AND CONT_VID: all segments are in milliseconds, no need to multiply anything
-			else
-				motor_time = motor[i].planLeadIn() + motor[i].planTravelLength() + motor[i].planLeadOut();
-			// Overwrite longest_time if the last checked motor is longer
-			if (motor_time > longest_time)
-				longest_time = motor_time;
-		}
-	}
-
-	// Add the program delay
-	longest_time += start_delay;
-
-	return(longest_time);
+	updateProgramGeometry();
+	return(program_total_time);
 }
 
 
@@ -974,55 +940,6 @@ byte powerCycled() {
 }
 
 
-uint8_t checkMotorAttach() {
-
-	// If any of the motors is moving or a program is currently running return the error value
-	for (byte i = 0; i < MOTOR_COUNT; i++) {
-		if (motor[i].running() || running)
-			return(B1000); // B1000 = 8
-	}
-
-	bool current_sleep[MOTOR_COUNT];
-	uint8_t attached = B000;
-
-	
-	for (byte i = 0; i < MOTOR_COUNT; i++) {
-		// Save the current sleep state of all the motors so they can be restored when done with the attach check
-		current_sleep[i] = motor[i].sleep();
-		// Put them into sleep mode in case it isn't already
-		motor[i].sleep(true);
-	}
-
-	for (int i = 0; i < MOTOR_COUNT; i++) {
-		motor[i].sleep(false);
-		delay(100);
-		// Read the analog value from current sensing pin
-		int current = analogRead(CURRENT_PIN);
-		// Convert the value to current in millamps
-		float amps = (float)current / 1023 * 5;
-		// This is the threshold in amps above which a motor will register as being detected;
-		const float THRESHOLD = 0.15;
-		// If the draw is greater than <THRESHOLD> amps, then a motor is connected to the enabled channel
-		if (amps > THRESHOLD)
-			attached |= (1 << i);
-		// Put the motor back to sleep so it doesn't interfere with reading of the next motor
-		motor[i].sleep(true);
-		
-		debug.funct("Motor ");
-		debug.funct(i);
-		debug.funct(" current draw: ");
-		debug.functln(amps);
-	}
-
-	// Restore the saved sleep states
-	for (byte i = 0; i < MOTOR_COUNT; i++) {
-		motor[i].sleep(current_sleep[i]);
-	}
-
-	// The bits of the attached byte indicate each motor's attached status
-	return(attached);
-}
-
 /*
 
 =========================================
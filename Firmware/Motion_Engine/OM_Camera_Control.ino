@@ -67,6 +67,8 @@ void camCallBack(byte code) {
   // Do NOT attempt to use delay() here, or call another camera action directly, as this
   // function is called in an interrupt and can daisy-chain under certain configurations,
   // which can result in unexpected behavior
+
+  unsigned long prof_start = micros();
   
   if( code == OM_CAM_FFIN ) {
 	  debug.functln("camCallBack() - Start");
@@ -83,7 +85,7 @@ void camCallBack(byte code) {
     checkCameraRepeat();
   }
   
-
+  profRecordSince(PROF_CAMERA, prof_start);
 }
 
  // check for camera repeat cycle
@@ -144,6 +146,7 @@ void cameraTest(uint8_t p_start) {
 
 		// Set the max shots to an arbitrarily large value so the test mode doesn't stop
 		Camera.setMaxShots(10000);
+		programGeometryDirty();
 
 		// Starting the program will make the camera fire, but the motors won't move
 		startProgram();
@@ -167,6 +170,7 @@ void cameraTest(uint8_t p_start) {
 
 		// Restore old program type
 		Motors::planType(oldProgramMode);
+		programGeometryDirty();
 	}
 }
 
@@ -205,6 +209,7 @@ void cameraAutoMaxShots() {
 	}
 
 	Camera.setMaxShots(longest);
+	programGeometryDirty();
 }
 
 // Returns the total number of shots from the current program pass, plus any previous passes
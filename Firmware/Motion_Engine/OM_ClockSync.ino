@@ -0,0 +1,275 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Clock synchronization
+  ========================================
+
+  The bus master periodically broadcasts its clock (BCAST_CLOCK_SYNC, four
+  byte microsecond count). Every node on the bus receives the same packet
+  at the same moment, so each one steers its own clock toward the stamp and
+  they all end up on the same timebase, whatever the master's own latency.
+
+  Each sample's error is the stamp minus our corrected clock when the packet
+  was picked up. Serial handling only ever adds delay, so of every
+  SYNC_WINDOW samples the one with the largest error (the least delayed) is
+  fed to a PI loop that trims the offset and the rate of the clock.
+
+  Program timers (run_time, kf_run_time, camera_tm) read syncMillis()
+  instead of millis(). Until the first sample it is just millis(). The
+  clock is only stepped, rather than slewed, while no program is running.
+
+*/
+
+const byte BCAST_CLOCK_SYNC		= 35;			// Broadcast carrying the bus master's clock (us)
+
+const byte SYNC_WINDOW			= 4;			// Samples per loop update
+const long SYNC_STEP_US			= 20000;		// Larger errors step the clock rather than slew it
+const long SYNC_MAX_RATE		= 10737418;		// Rate limit, 10000 ppm in 2^-30 units
+const long SYNC_FOLD_US			= 100000000;	// Fold the rate into the offset at least this often
+
+// Stat selectors for general command 136
+const byte SYNC_STAT_ERROR		= 0;
+const byte SYNC_STAT_RATE		= 1;
+const byte SYNC_STAT_SAMPLES	= 2;
+const byte SYNC_STAT_LOCKED		= 3;
+const byte SYNC_STAT_REJECTED	= 4;
+
+long sync_offset_ms = 0;				// Shared clock minus local clock, whole ms...
+long sync_offset_rem = 0;				// ...plus this many us (0-999)
+unsigned long sync_anchor_us = 0;		// Local micros() the rate is applied from
+long sync_rate = 0;						// Rate correction in 2^-30 units (about 1 ppb)
+
+unsigned long sync_rx_us = 0;			// Local micros() at the start of the serial pass
+unsigned long sync_update_us = 0;		// Local micros() at the last loop update
+unsigned long sync_last_ms = 0;			// Last value returned by syncMillis()
+long sync_best = 0;						// Largest error in the current window
+byte sync_window = 0;					// Samples in the current window
+bool sync_locked = false;
+
+long sync_error = 0;					// Error fed to the loop at the last update (us)
+unsigned long sync_samples = 0;			// Samples received
+unsigned long sync_rejected = 0;		// Samples ignored as a step was needed mid-program
+
+
+ // Rate correction accumulated since the anchor (us)
+long syncRateUs(unsigned long p_local) {
+	return ((int64_t)(long)(p_local - sync_anchor_us) * sync_rate) >> 30;
+}
+
+
+ // Adds to the offset, keeping the us part in 0-999
+void syncAdjust(long p_us) {
+
+	long total = sync_offset_rem + p_us;
+	long ms = total / 1000;
+	long rem = total % 1000;
+
+	if (rem < 0) {
+		rem += 1000;
+		ms--;
+	}
+
+	sync_offset_ms += ms;
+	sync_offset_rem = rem;
+}
+
+
+ // Moves the rate correction so far into the offset
+void syncFold(unsigned long p_local) {
+	syncAdjust(syncRateUs(p_local));
+	sync_anchor_us = p_local;
+}
+
+
+ // Shared clock (us) at the given local micros(). Wraps like micros().
+unsigned long syncMicrosAt(unsigned long p_local) {
+	return p_local + sync_offset_ms * 1000 + sync_offset_rem + syncRateUs(p_local);
+}
+
+
+/** Mark Serial Receive Time
+
+ Called at the start of each serial pass, before any packets are handled,
+ so a sync broadcast can be matched with the time it came in. Also folds
+ the rate correction into the offset often enough that the time since the
+ anchor never overflows syncRateUs(), with or without broadcasts.
+ */
+
+void syncMarkRx() {
+
+	sync_rx_us = micros();
+
+	if ((long)(sync_rx_us - sync_anchor_us) > SYNC_FOLD_US)
+		syncFold(sync_rx_us);
+}
+
+
+/** Synchronized Micros
+
+ Returns the shared clock in microseconds. Like micros() it wraps.
+ */
+
+unsigned long syncMicros() {
+	return syncMicrosAt(micros());
+}
+
+
+/** Synchronized Millis
+
+ Returns the shared clock in milliseconds, for program timers. Never runs
+ backwards, even as the loop trims the offset.
+ */
+
+unsigned long syncMillis() {
+
+	unsigned long local = micros();
+
+	if ((long)(local - sync_anchor_us) > SYNC_FOLD_US)
+		syncFold(local);
+
+	long us = sync_offset_rem + syncRateUs(local);
+	long ms = us / 1000;
+	if (us < 0 && us % 1000)
+		ms--;
+
+	unsigned long now = millis() + sync_offset_ms + ms;
+
+	if ((long)(now - sync_last_ms) > 0)
+		sync_last_ms = now;
+
+	return sync_last_ms;
+}
+
+
+/** Clock Sync Sample
+
+ Handles a sync broadcast. p_master is the bus master's clock (us) when
+ the packet was sent.
+ */
+
+void syncSample(unsigned long p_master) {
+
+	unsigned long local = sync_rx_us;
+	long error = (long)(p_master - syncMicrosAt(local));
+
+	sync_samples++;
+
+	// Way off, or never set: step the clock, unless it would upset a running program
+	if (!sync_locked || abs(error) > SYNC_STEP_US) {
+
+		if (running || kf_running || startPending()) {
+			sync_rejected++;
+			return;
+		}
+
+		syncFold(local);
+		syncAdjust(error);
+		sync_last_ms = millis() + sync_offset_ms;
+		sync_update_us = local;
+		sync_error = error;
+		sync_window = 0;
+		sync_locked = true;
+		return;
+	}
+
+	// Keep the least delayed sample of the window
+	if (sync_window == 0 || error > sync_best)
+		sync_best = error;
+
+	if (++sync_window < SYNC_WINDOW)
+		return;
+
+	long interval = (long)(local - sync_update_us);
+
+	syncFold(local);
+
+	// Proportional: take out half the error now
+	syncAdjust(sync_best / 2);
+
+	// Integral: trim the rate by an eighth of the error over the interval
+	if (interval > 0)
+		sync_rate += (((int64_t)sync_best << 30) / interval) / 8;
+
+	sync_rate = constrain(sync_rate, -SYNC_MAX_RATE, SYNC_MAX_RATE);
+
+	sync_error = sync_best;
+	sync_update_us = local;
+	sync_window = 0;
+}
+
+
+/** Reset Clock Sync
+
+ Drops the shared clock, going back to the local one until the next sync
+ broadcast. Returns false while a program is running.
+ */
+
+bool syncReset() {
+
+	if (running || kf_running || startPending())
+		return false;
+
+	sync_offset_ms = 0;
+	sync_offset_rem = 0;
+	sync_rate = 0;
+	sync_anchor_us = micros();
+	sync_last_ms = 0;
+	sync_window = 0;
+	sync_error = 0;
+	sync_samples = 0;
+	sync_rejected = 0;
+	sync_locked = false;
+
+	return true;
+}
+
+
+/** Clock Sync Stat
+
+ Returns one statistic (SYNC_STAT_x) for general command 136.
+ */
+
+long syncStat(byte p_stat) {
+
+	switch (p_stat) {
+		case SYNC_STAT_ERROR:
+			return sync_error;
+		case SYNC_STAT_RATE:
+			// 2^-30 units to ppb
+			return ((int64_t)sync_rate * 1000000000LL) >> 30;
+		case SYNC_STAT_SAMPLES:
+			return sync_samples;
+		case SYNC_STAT_LOCKED:
+			return sync_locked;
+		case SYNC_STAT_REJECTED:
+			return sync_rejected;
+		default:
+			return 0;
+	}
+}
@@ -49,12 +49,11 @@ void setupControlCycle() {
 
 
 void cycleCamera() {
-	const String CYCLE_CAMERA = "cycleCamera() - ";
-	debug.functln(CYCLE_CAMERA + "Start");
+	logEvent(LOG_CYCLE_START);
 
 	// Check to see if a pause was requested. The program is paused here to avoid unexpected stops in the middle of a move or exposure.
 	if (pause_flag) {		
-		debug.functln(CYCLE_CAMERA + "Pausing");
+		logEvent(LOG_CYCLE_PAUSING);
 		pauseProgram();
 	}
 
@@ -89,14 +88,8 @@ void cycleCamera() {
 		  ready_to_stop = false;
 
 		  // Debug output
-		  debug.functln(CYCLE_CAMERA + "All mot done moving");
-		  if ((totalProgramTime() - last_run_time) > 0) {
-			  debug.funct(totalProgramTime());
-			  debug.funct(last_run_time);
-			  debug.funct(CYCLE_CAMERA + "There are ");
-			  debug.funct((long)totalProgramTime() - (long)last_run_time);
-			  debug.functln("ms of lead-out remaining");
-		  }	
+		  logEvent(LOG_CYCLE_MOT_DONE);
+		  logEvent(LOG_CYCLE_LEAD_OUT, (long)totalProgramTime() - (long)last_run_time);
 	  }
 
 		// stop program running w/o clearing variables
@@ -110,7 +103,7 @@ void cycleCamera() {
 				ping_pong_shots += camera_fired;
 				ping_pong_time += run_time;
 				stopProgram();
-				reverseStartStop();
+				swapStartStop();
 				ping_pong_flag = true;
 				startProgram();
 			}
@@ -120,7 +113,7 @@ void cycleCamera() {
 				program_complete = true;
 			}
 		}
-		debug.functln(CYCLE_CAMERA + "Bailing from camera cycle at point 1");
+		logEvent(LOG_CYCLE_BAIL_1);
 		return;
 	}
 	// If either the SMS or continuous move is complete and the camera is in "keep alive" mode
@@ -131,7 +124,7 @@ void cycleCamera() {
   
   // if in external interval mode, don't do anything if a force shot isn't registered
   if (altExtInt && !altForceShot) {
-	  debug.functln(CYCLE_CAMERA + "Skipping shot, waiting for external trigger");
+	  logEvent(LOG_CYCLE_EXT_WAIT);
 	  return;
   }
 		
@@ -139,7 +132,7 @@ void cycleCamera() {
 	if( (ALT_OUT_BEFORE == altInputs[0] || ALT_OUT_BEFORE == altInputs[1]) && cycleShotOK(true) ) {
 		altBlock = ALT_OUT_BEFORE;
 		altOutStart(ALT_OUT_BEFORE);		
-		debug.functln(CYCLE_CAMERA + "Bailing from camera cycle at point 2");
+		logEvent(LOG_CYCLE_BAIL_2);
 		return;
 	}
 	
@@ -147,26 +140,18 @@ void cycleCamera() {
     // if enough time has passed, and we're ok to take an exposure
     // note: for slaves, we only get here by a master signal, so we don't check interval timing
 
-  if( ComMgr.master() == false || ( millis() - camera_tm ) >= Camera.intervalTime() || !Camera.enable || external_intervalometer ) {
-
-	  debug.functln(CYCLE_CAMERA + "Shots: ");
-	  debug.funct(camera_fired);
-	  debug.funct(" ");
-	  for (byte i = 0; i < MOTOR_COUNT; i++){
-		  debug.funct("Motor ");
-		  debug.funct(i);
-		  debug.funct(": ");
-		  debug.funct(motor[i].currentPos());
-		  debug.funct(" ");
-	  }
-	  debug.functln("");	  
+  if( ComMgr.master() == false || ( syncMillis() - camera_tm ) >= Camera.intervalTime() || !Camera.enable || external_intervalometer ) {
+
+	  logEvent(LOG_CYCLE_SHOTS, camera_fired);
+	  for (byte i = 0; i < MOTOR_COUNT; i++)
+		  logEvent(LOG_CYCLE_MOT_POS_0 + i, motor[i].currentPos());
 
       // skip camera actions if camera disabled  
       if( ! Camera.enable ) {
         Engine.state(ST_MOVE);
-        camera_tm = millis();  
+        camera_tm = syncMillis();  
 		
-		debug.functln(CYCLE_CAMERA + "Bailing from camera cycle at point 3");
+		logEvent(LOG_CYCLE_BAIL_3);
         return;
       }
 	  
@@ -174,16 +159,15 @@ void cycleCamera() {
       // callback executions that will walk us through the complete exposure cycle.
       // -- if no focus is configured, nothing will happen but trigger
       // the callback that will trigger exposing the camera immediately
-	  debug.functln(CYCLE_CAMERA + "Camera busy: ");
-	debug.functln(Camera.busy());
+	  logEvent(LOG_CYCLE_CAM_BUSY, Camera.busy());
 	
     if( ! Camera.busy() ) {
-		debug.functln(CYCLE_CAMERA + "Starting exposure cycle");
+		logEvent(LOG_CYCLE_EXPOSE);
 		// only execute cycle if the camera is not currently busy
 		Engine.state(ST_BLOCK);
 		altBlock = ALT_OFF;
 		altForceShot = false;
-		camera_tm = millis();  
+		camera_tm = syncMillis();  
 		Camera.focus();
     } 
     
@@ -207,24 +191,22 @@ void cycleCamera() {
  
 uint8_t cycleShotOK(uint8_t p_prealt) {
 	
-	const String CYCLE_SHOT_OK = "cycleShotOK() - ";
-
-	debug.functln(CYCLE_SHOT_OK + "Enter function");
+	logEvent(LOG_SHOT_OK_ENTER);
 
     // if we're in alt i/o as external intervalometer mode...
 	  if( altExtInt ) {
-		  debug.functln(CYCLE_SHOT_OK + "Ext. interval mode active");
+		  logEvent(LOG_SHOT_OK_EXT);
 			// don't do a pre-output clearance if alt_block is true...
 		  if( p_prealt && altBlock )
 			return false;
         
 			// determine whether or not to fire based on alt_force_shot
 		  if (altForceShot == true) {			  
-			  debug.functln(CYCLE_SHOT_OK + "altForceShot detected ************");
+			  logEvent(LOG_SHOT_OK_FORCE);
 			  return true;
 		  }
 		  else {
-			  debug.functln(CYCLE_SHOT_OK + "altForceShot not detected");
+			  logEvent(LOG_SHOT_OK_NO_FORCE);
 			  return false;
 		  }
 	  }
@@ -233,7 +215,7 @@ uint8_t cycleShotOK(uint8_t p_prealt) {
 	if(altBeforeDelay >= Camera.intervalTime() && !altBlock){  //Camera.intervalTime() is less than the altBeforeDelay, go as fast as possible
 		return true;
 	} 
-	else if( (millis() - camera_tm) >= (Camera.intervalTime() - altBeforeDelay)  && ! altBlock )
+	else if( (syncMillis() - camera_tm) >= (Camera.intervalTime() - altBeforeDelay)  && ! altBlock )
 		return true;
 
   
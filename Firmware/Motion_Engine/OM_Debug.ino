@@ -102,9 +102,10 @@ void selfDiagnostic() {
 		motor[i].enable(true);
 		motor[i].sleep(true);
 	}
+	programGeometryDirty();
 
 	// Check the motor attachment
-	uint8_t motor_attach = checkMotorAttach();
+	uint8_t motor_attach = checkMotorAttachWait();
 	delay(250);
 
 	// Report via enable lights which motors were detected
@@ -38,7 +38,18 @@ See dynamicperception.com for more information
 
 
 // EEPROM Memory Layout Version, change this any time you modify what is stored
-const unsigned int MEMORY_VERSION = 4;
+const unsigned int MEMORY_VERSION = 5;
+
+// Position journal state, see journalUpdate() below
+long journal_pos[MOTOR_COUNT];						// Positions of the last good record, or the pending snapshot
+volatile uint8_t journal_dirty = false;				// A new snapshot is waiting to be written
+uint8_t journal_valid = false;						// journal_pos[] holds a restored record
+uint16_t journal_seq = 0;							// Sequence number of the newest record
+uint8_t journal_slot = EE_JOURNAL_SLOTS - 1;		// Slot holding the newest record
+
+uint8_t journal_buf[EE_JOURNAL_RECORD];				// Record currently being written
+uint8_t journal_idx = EE_JOURNAL_RECORD;			// Next byte of journal_buf to write, EE_JOURNAL_RECORD when idle
+int journal_addr = EE_POS_JOURNAL;					// EEPROM address of the record being written
 
 
 
@@ -80,7 +91,6 @@ void eepromWrite() {
 
 	byte tempMS = 0;
 	bool tempSleep = false;
-	long tempPos = 0;
 	long tempStart = 0;
 	long tempStop = 0;
 	long tempEnd = 0;
@@ -88,18 +98,18 @@ void eepromWrite() {
 	for (int i = 0; i < MOTOR_COUNT; i++){
 		tempMS		= motor[i].ms();
 		tempSleep	= motor[i].sleep();
-		tempPos		= motor[i].currentPos();
 		tempStart	= motor[i].startPos();
 		tempStop	= motor[i].stopPos();
 		tempEnd		= endPos[i];
 		
 		write(EE_MS_0		+ EE_MOTOR_MEMORY_SPACE * i, tempMS);
 		write(EE_SLEEP_0	+ EE_MOTOR_MEMORY_SPACE * i, tempSleep);
-		write(EE_POS_0		+ EE_MOTOR_MEMORY_SPACE * i, tempPos);
 		write(EE_START_0	+ EE_MOTOR_MEMORY_SPACE * i, tempStart);
 		write(EE_STOP_0		+ EE_MOTOR_MEMORY_SPACE * i, tempStop);
 		write(EE_END_0		+ EE_MOTOR_MEMORY_SPACE * i, tempEnd);		
 	} 
+
+	journalFormat();
 }
 
 
@@ -123,13 +133,15 @@ void eepromRestore() {
 	if (ee_load_endPos != 0 && ee_load_endPos != 1)
 		ee_load_endPos = 0;
 	
+	// Find the newest intact position record, this also sets where the next one goes
+	journalScan();
+
 	// There had been problems with reading the EEPROM values inside the motor setting functions,
 	// so as a work around, they are saved into these temporary variables which are then used to load
 	// the proper motor settings.
 	
 	byte tempMS		= 0;
 	bool tempSleep	= false;
-	long tempPos = 0;
 	long tempStart	= 0;
 	long tempStop	= 0;
 	long tempEnd	= 0;
@@ -139,15 +151,14 @@ void eepromRestore() {
 
 		read(EE_MS_0    + EE_MOTOR_MEMORY_SPACE * i, tempMS);
 		read(EE_SLEEP_0 + EE_MOTOR_MEMORY_SPACE * i, tempSleep);
-		read(EE_POS_0	+ EE_MOTOR_MEMORY_SPACE * i, tempPos);
 		read(EE_START_0 + EE_MOTOR_MEMORY_SPACE * i, tempStart);
 		read(EE_STOP_0	+ EE_MOTOR_MEMORY_SPACE * i, tempStop);
 		read(EE_END_0	+ EE_MOTOR_MEMORY_SPACE * i, tempEnd);
 		
 		motor[i].ms(tempMS);
 		motor[i].sleep(tempSleep);
-		if (ee_load_curPos)
-			motor[i].currentPos(tempPos);
+		if (ee_load_curPos && journal_valid)
+			motor[i].currentPos(journal_pos[i]);
 		if (ee_load_startStop){
 			motor[i].startPos(tempStart);
 			motor[i].stopPos(tempStop);
@@ -159,3 +170,179 @@ void eepromRestore() {
 }
 
 
+
+/*
+
+  ========================================
+  Position journal
+  ========================================
+
+  Motor positions change every time the motors stop, so rather than
+  rewriting the same four cells per motor, they are written as records
+  into a ring of EE_JOURNAL_SLOTS slots. Each record carries a sequence
+  number, and the checksum is written last, so a record that was cut off
+  by a power loss is simply ignored and the previous one is used instead.
+
+  stopAllMotors() only snapshots the positions into RAM. journalUpdate()
+  is called from loop() and writes the record out one byte at a time,
+  only when the EEPROM is ready, so it never waits on a write cycle.
+
+*/
+
+/** Record Checksum
+
+ XOR of the record body, seeded so that both a blank (0xFF) and a
+ zeroed record fail the check.
+ */
+
+uint8_t journalChecksum(uint8_t* p_rec) {
+
+	uint8_t sum = 0xA5;
+
+	for (byte i = 0; i < EE_JOURNAL_RECORD - 1; i++)
+		sum ^= p_rec[i];
+
+	return sum;
+}
+
+
+/** Build Record
+
+ Packs the sequence number and positions into journal_buf.
+ */
+
+void journalPack(uint16_t p_seq, long* p_pos) {
+
+	journal_buf[0] = p_seq & 0xFF;
+	journal_buf[1] = p_seq >> 8;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		unsigned long val = p_pos[i];
+		for (byte b = 0; b < 4; b++)
+			journal_buf[2 + i * 4 + b] = (val >> (8 * b)) & 0xFF;
+	}
+
+	journal_buf[EE_JOURNAL_RECORD - 1] = journalChecksum(journal_buf);
+}
+
+
+/** Find Newest Record
+
+ Reads every slot, and keeps the valid record with the highest sequence
+ number (allowing for wraparound). Sets journal_valid if one was found.
+ */
+
+void journalScan() {
+
+	uint8_t rec[EE_JOURNAL_RECORD];
+
+	journal_valid = false;
+	journal_slot = EE_JOURNAL_SLOTS - 1;
+	journal_seq = 0;
+
+	for (byte slot = 0; slot < EE_JOURNAL_SLOTS; slot++) {
+
+		for (byte i = 0; i < EE_JOURNAL_RECORD; i++)
+			OMEEPROM::read(EE_POS_JOURNAL + slot * EE_JOURNAL_RECORD + i, rec[i]);
+
+		if (rec[EE_JOURNAL_RECORD - 1] != journalChecksum(rec))
+			continue;
+
+		uint16_t seq = rec[0] | ((uint16_t)rec[1] << 8);
+
+		if (journal_valid && (int16_t)(seq - journal_seq) <= 0)
+			continue;
+
+		journal_valid = true;
+		journal_seq = seq;
+		journal_slot = slot;
+
+		for (byte i = 0; i < MOTOR_COUNT; i++) {
+			unsigned long val = 0;
+			for (byte b = 0; b < 4; b++)
+				val |= (unsigned long)rec[2 + i * 4 + b] << (8 * b);
+			journal_pos[i] = val;
+		}
+	}
+}
+
+
+/** Format Journal
+
+ Blanks every slot and writes the current positions as the first record.
+ This blocks for the whole write, so is only used along with eepromWrite().
+ */
+
+void journalFormat() {
+
+	for (int i = 0; i < EE_JOURNAL_SLOTS * EE_JOURNAL_RECORD; i++)
+		OMEEPROM::write(EE_POS_JOURNAL + i, (uint8_t) 0);
+
+	for (byte i = 0; i < MOTOR_COUNT; i++)
+		journal_pos[i] = motor[i].currentPos();
+
+	journal_seq = 0;
+	journal_slot = 0;
+	journalPack(journal_seq, journal_pos);
+
+	for (byte i = 0; i < EE_JOURNAL_RECORD; i++)
+		OMEEPROM::write(EE_POS_JOURNAL + i, journal_buf[i]);
+
+	journal_valid = true;
+	journal_idx = EE_JOURNAL_RECORD;
+	journal_dirty = false;
+}
+
+
+/** Snapshot Positions
+
+ Copies the motors' current positions into RAM and flags them to be
+ written to the journal. Cheap enough to call from anywhere.
+ */
+
+void eepromSavePositions() {
+
+	for (byte i = 0; i < MOTOR_COUNT; i++)
+		journal_pos[i] = motor[i].currentPos();
+
+	journal_dirty = true;
+}
+
+
+/** Journal Background Writer
+
+ Called from loop(). Starts a new record when a snapshot is pending, and
+ writes at most one byte per call, only if the previous EEPROM write
+ cycle has finished.
+ */
+
+void journalUpdate() {
+
+	// Idle: pick up a pending snapshot
+	if (journal_idx >= EE_JOURNAL_RECORD) {
+
+		if (!journal_dirty)
+			return;
+
+		uint8_t oldSREG = SREG;
+		cli();
+		journal_dirty = false;
+		journalPack(journal_seq + 1, journal_pos);
+		SREG = oldSREG;
+
+		journal_addr = EE_POS_JOURNAL + ((journal_slot + 1) % EE_JOURNAL_SLOTS) * EE_JOURNAL_RECORD;
+		journal_idx = 0;
+	}
+
+	if (!eeprom_is_ready())
+		return;
+
+	OMEEPROM::write(journal_addr + journal_idx, journal_buf[journal_idx]);
+	journal_idx++;
+
+	// Record complete (checksum is the last byte), it is now the newest one
+	if (journal_idx >= EE_JOURNAL_RECORD) {
+		journal_slot = (journal_slot + 1) % EE_JOURNAL_SLOTS;
+		journal_seq++;
+	}
+}
@@ -26,6 +26,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 boolean kf_okForSmsMove;
 int kf_curSmsFrame;
+boolean kf_smsReady = false;			// kf_smsNextPos holds the targets for frame kf_curSmsFrame + 1
+byte kf_smsNextMask = 0;				// Axes with a move in the ready slot
+long kf_smsNextPos[MOTOR_COUNT];		// Next SMS frame's target positions
 boolean kf_auxFired = false;
 boolean kf_auxDone = false;
 boolean kf_focusFired = false;
@@ -91,10 +94,6 @@ void kf_printKeyFrameData(){
 }
 
 void kf_startProgram(){
-	kf_startProgram(false);
-}
-
-void kf_startProgram(boolean isBouncePass){
 		
 	// If resuming
 	if (kf_paused){
@@ -110,38 +109,21 @@ void kf_startProgram(boolean isBouncePass){
 		// Reset completion flag
 		program_complete = false; 
 
-		// Reset the SMS vars
-		kf_okForSmsMove = false;
-		kf_curSmsFrame = 0;
-
-		// Reset the total pause time counter
-		kf_pause_time = 0;
+		// Reset the SMS, pause and camera vars
+		kf_resetPass();
 
 		// Make sure the pause flag is off
 		kf_paused = false;		
 
-		// Reset the camera vars
-		kf_last_shot_tm = 0;		
-		kf_auxFired = false;
-		kf_auxDone = false;
-		kf_focusFired = false;
-		kf_focusDone = false;
-		kf_shutterFired = false;
-		kf_shutterDone = false;
-		kf_forceShotInProgress = false;
-		camera_fired = 0;
-
-		// Reset ping pong vals, if necessary
-		if (!isBouncePass){
-			ping_pong_shots = 0;
-			ping_pong_time = 0;
-		}
+		// Reset ping pong vals and run the key frames forwards
+		ping_pong_shots = 0;
+		ping_pong_time = 0;
+		kf_reverseView(false);
 				
 		// Prep the movement and camera times
 		kf_getMaxMoveTime();
 		kf_getMaxCamTime();
-		if (!isBouncePass)
-			clearShotCounter();
+		clearShotCounter();
 
 		// SMS Moves
 		if (Motors::planType() == SMS){
@@ -157,24 +139,18 @@ void kf_startProgram(boolean isBouncePass){
 			// Turn on joystick mode
 			joystickSet(true);
 
+			// Build the fixed-point velocity table used by kf_updateContSpeed(). Streamed
+			// programs fill the table as points arrive instead.
+			if (!kf_streamMode())
+				kf_compileTable();
+
 			// Set the initial motor speeds			
-			for (byte i = 0; i < MOTOR_COUNT; i++){
-				// Don't touch motors that don't have any key frames
-				if (kf[i].getKFCount() > 0){					
-					// If the first key frame isn't at x == 0 (i.e. there is a lead-in), set velocity to 0
-					if (kf[i].getXN(0) == 0){
-						setJoystickSpeed(i, kf[i].vel(0) * MILLIS_PER_SECOND);
-					}
-					else{
-						setJoystickSpeed(i, 0);
-					}
-				}
-			}
+			kf_setInitialSpeeds();
 		}
 
 		// Initialize the run timers
 		kf_run_time = 0;
-		kf_start_time = millis();
+		kf_start_time = syncMillis();
 		kf_last_update = millis();		
 	}
 
@@ -184,6 +160,73 @@ void kf_startProgram(boolean isBouncePass){
 	kf_just_started = true;	
 }
 
+/*
+	Resets the SMS, pause and camera state at the start of each pass.
+*/
+void kf_resetPass(){
+
+	// Reset the SMS vars
+	kf_okForSmsMove = false;
+	kf_curSmsFrame = 0;
+	kf_smsReady = false;
+
+	// Reset the total pause time counter
+	kf_pause_time = 0;
+
+	// Reset the camera vars
+	kf_last_shot_tm = 0;		
+	kf_auxFired = false;
+	kf_auxDone = false;
+	kf_focusFired = false;
+	kf_focusDone = false;
+	kf_shutterFired = false;
+	kf_shutterDone = false;
+	kf_forceShotInProgress = false;
+	camera_fired = 0;
+}
+
+/*
+	Sets each continuous axis to its speed at the start of the pass.
+*/
+void kf_setInitialSpeeds(){
+	for (byte i = 0; i < MOTOR_COUNT; i++){
+		// Don't touch motors that don't have any key frames
+		if (kf[i].getKFCount() > 0){					
+			// If the first key frame isn't at x == 0 (i.e. there is a lead-in), set velocity to 0
+			if (kf_viewFirst(i) == 0){
+				setJoystickSpeed(i, kf_viewVel(i, 0) * MILLIS_PER_SECOND);
+			}
+			else{
+				setJoystickSpeed(i, 0);
+			}
+		}
+	}
+}
+
+/*
+	Starts the next ping-pong pass. The key frames are read through the reverse
+	view, so there's no need to stop the motors or rebuild the key frames; the
+	direction just flips and the pass timers start over.
+*/
+void kf_bounce(){
+
+	// The shot count and run time are reset for each pass, so add 
+	// them to separate counters for serial reporting
+	kf_ping_pong_time += kf_run_time;
+	ping_pong_shots += camera_fired;
+	ping_pong_flag = true;
+
+	kf_reverseView(!kf_reverseView());
+	kf_resetPass();
+
+	kf_run_time = 0;
+	kf_start_time = syncMillis();
+	kf_last_update = millis();
+
+	if (Motors::planType() != SMS)
+		kf_setInitialSpeeds();
+}
+
 void kf_pauseProgram(){
 
 	debug.funct("PAUSING KF PROGRAM");
@@ -202,14 +245,10 @@ void kf_pauseProgram(){
 	kf_this_pause = 0;
 
 	// Log the start time of the pause
-	kf_pause_start = millis();	
+	kf_pause_start = syncMillis();	
 }
 
 void kf_stopProgram(){
-	kf_stopProgram(false);
-}
-
-void kf_stopProgram(boolean savePingPongVals){
 
 	debug.funct("STOPPING KF PROGRAM");
 	
@@ -226,11 +265,10 @@ void kf_stopProgram(boolean savePingPongVals){
 	kf_paused = false;	
 	still_shooting_flag = false;
 
-	if (!savePingPongVals){
-		ping_pong_flag = false;
-		kf_ping_pong_time = 0;
-		ping_pong_shots = 0;
-	}
+	ping_pong_flag = false;
+	kf_ping_pong_time = 0;
+	ping_pong_shots = 0;
+	kf_reverseView(false);
 
 	// If it's a video move, trigger the camera once to stop the recording
 	if (Motors::planType() == CONT_VID)
@@ -247,25 +285,18 @@ void kf_updateProgram(){
 
 	// If the program is paused, just keep track of the pause time
 	if (kf_paused){
-		kf_this_pause = millis() - kf_pause_start;
+		kf_this_pause = syncMillis() - kf_pause_start;
 		debug.funct("Pause length: ");
 		debug.functln(kf_this_pause);		
 		return;
 	}
 
 	// Update run_time, don't include time spent paused
-	kf_run_time = millis() - kf_start_time - kf_pause_time;
+	kf_run_time = syncMillis() - kf_start_time - kf_pause_time;
 	
 	//debug.funct("Run time: ");
 	//debug.functln(kf_run_time);	
 
-	// Adding a small delay seems to keep the controller from randomly locking. I don't know why...
-	int time_delay = 500;
-	unsigned long  start_wait = micros();
-	while (micros() - start_wait < time_delay){
-		// Wait for the delay to finish
-	}
-
 	// Don't do anything else until the start delay is done (but skip if on a ping-pong pass)
 	if (kf_run_time < start_delay && !ping_pong_flag){
 		delay_flag = true;
@@ -299,6 +330,11 @@ void kf_updateProgram(){
 		kf_updateContSpeed();
 	}
 
+	// Work out the next SMS move while the camera is busy, so it can start as soon as the shutter is done
+	if (Motors::planType() == SMS && !still_shooting_flag){
+		kf_planSMS();
+	}
+
 	// Check whether the camera needs to fire (but not for video mode)
 	if (Motors::planType() != CONT_VID)
 		kf_CameraCheck();
@@ -329,20 +365,10 @@ void kf_updateProgram(){
 		}
 		else{
 			debug.serln("Stopping kf program");									
-			// If ping-pong mode is active, reverse and start a new program
+			// If ping-pong mode is active, run the key frames the other way
 			if (pingPongMode()){
-				// The shot count and run time are reset when starting a new program, 
-				// so add the shots and them to separate counters for serial reporting
-				// and indicate to the stop function that they should not be reset
-				kf_ping_pong_time += kf_run_time;
-				ping_pong_shots += camera_fired;
-				kf_stopProgram(true);
-				debug.serln("Starting ping-pong phase");
-				ping_pong_flag = true;
-				debug.serln("Reversing key points");
-				reverseStartStop();
-				debug.serln("Starting new kf bounce program");
-				kf_startProgram(true);			
+				debug.serln(F("Starting ping-pong phase"));
+				kf_bounce();
 			}
 			else{
 				kf_stopProgram();
@@ -357,11 +383,23 @@ void kf_updateContSpeed(){
 	// If the update time has elapsed, update the motor speed
 	if (millis() - kf_last_update > KeyFrames::updateRate()){
 		for (byte i = 0; i < MOTOR_COUNT; i++){
+			// Streamed axes are evaluated from their segment ring
+			if (kf_streamActive(i)){
+				setJoystickSpeed(i, kf_streamSpeed(i, (long)kf_run_time - (long)start_delay));
+				continue;
+			}
+
 			// Determine the maximum run time for this axis
-			float thisAxisMaxTime = kf[i].getXN(kf[i].getKFCount() - 1);
+			float thisAxisMaxTime = kf_viewLast(i);
 			if (Motors::planType() == SMS)
 				thisAxisMaxTime = thisAxisMaxTime * Camera.intervalTime();
 
+			// Axes compiled into the segment table skip the float spline evaluation
+			if (kf_tableValid(i)){
+				setJoystickSpeed(i, kf_tableSpeed(i, (long)kf_run_time - (long)start_delay));
+				continue;
+			}
+
 			// Set the approriate speed, but don't touch motors that don't have any key frames
 			if (kf[i].getKFCount() > 0){
 				float speed;
@@ -369,18 +407,53 @@ void kf_updateContSpeed(){
 					speed = 0;
 				else{
 					// If the time is before the first key frame or after the last, it's a lead-in/out and speed should be 0
-					if (kf_run_time < kf[i].getXN(0) + start_delay || kf_run_time > kf[i].getXN(kf[i].getKFCount() - 1) + start_delay)
+					if (kf_run_time < kf_viewFirst(i) + start_delay || kf_run_time > kf_viewLast(i) + start_delay)
 						speed = 0;
 					else
-						speed = kf[i].vel((float)kf_run_time - start_delay) * MILLIS_PER_SECOND; // Convert from steps/millisecond to steps/sec
+						speed = kf_viewVel(i, (float)kf_run_time - start_delay) * MILLIS_PER_SECOND; // Convert from steps/millisecond to steps/sec
 				}					
 				setJoystickSpeed(i, speed);
 			}
 		}
 		kf_last_update = millis();
+
+		// Hold the program if a streamed axis has run out of points, it can be resumed once the host catches up
+		if (kf_streamUnderrun())
+			kf_pauseProgram();
 	}
 }
 
+/*
+	Fills the ready slot with the target positions of the next SMS frame.
+	Does nothing once the slot is full, so it's cheap to call every pass.
+*/
+void kf_planSMS(){
+
+	if (kf_smsReady)
+		return;
+
+	kf_smsNextMask = 0;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++){
+
+		// Make sure there is a point to actually query
+		if (kf[i].getKFCount() < 2 || kf_curSmsFrame + 1 > kf_viewLast(i))
+			continue;
+
+		kf_smsNextPos[i] = (long)kf_viewPos(i, kf_curSmsFrame + 1);
+		kf_smsNextMask |= (1 << i);
+
+		debug.funct("Planned location #: ");
+		debug.funct(kf_curSmsFrame + 1);
+		debug.funct(" for motor ");
+		debug.funct(i);
+		debug.funct(": ");
+		debug.functln(kf_smsNextPos[i]);
+	}
+
+	kf_smsReady = true;
+}
+
 void kf_updateSMS(){
 	
 	// If we're not ready for a move (i.e. the camera is busy or we just finished one), don't do anything
@@ -388,32 +461,20 @@ void kf_updateSMS(){
 		return;
 	}
 
-	// Send the motors to their next locations
-	debug.functln("Sending motors to new locations");
-	for (int i = 0; i < MOTOR_COUNT; i++){		
+	// The slot is normally filled while the camera was busy, make sure of it
+	kf_planSMS();
 
-		// Make sure there is a point to actually query
-		if (kf[i].getKFCount() < 2 || kf_curSmsFrame + 1 > kf[i].getXN(kf[i].getKFCount() - 1))
-			continue;
+	// Send the motors to their next locations, arriving together when coordinated moves are on
+	sendToAll(kf_smsNextPos, kf_smsNextMask, false);
+	debug.functln("Sent motors to new locations");
 
-		float nextPos = kf[i].pos(kf_curSmsFrame + 1);
-	
-		debug.funct("About to send to location #: ");
-		debug.functln(kf_curSmsFrame + 1);
-		debug.funct("Sending to ");
-		debug.functln(nextPos);
-		debug.functln("");
-	
-		sendTo(i, (long)nextPos);				
-	}		
 	kf_curSmsFrame++;
 	kf_okForSmsMove = false;
+	kf_smsReady = false;
 }
 
 void kf_CameraCheck() {
 
-	const String KF_CAM_CHECK = "kf_CameraCheck() - ";
-
 	int auxPreShotTime = 0;
 
 	// If this is the last shot of a pass during ping-pong mode, skip it
@@ -423,7 +484,7 @@ void kf_CameraCheck() {
 
 	// If in external interval mode, don't do anything if a force shot isn't registered
 	if (altExtInt && !altForceShot && !kf_forceShotInProgress) {		
-		debug.functln(KF_CAM_CHECK + "Skipping shot, waiting for external trigger");		
+		logEvent(LOG_KF_EXT_WAIT);		
 		return;
 	}
 
@@ -458,7 +519,7 @@ void kf_CameraCheck() {
 		if (!kf_auxFired){
 			altBlock = ALT_OUT_BEFORE;
 			altOutStart(ALT_OUT_BEFORE);
-			debug.functln(KF_CAM_CHECK + "Bailing from camera cycle at point 2");
+			logEvent(LOG_KF_BAIL_2);
 			kf_auxFired = true;
 			return;
 		}
@@ -649,6 +710,9 @@ int kf_getRunState(){
 		ret = PAUSED;
 	}
 
+	// Streaming flow control bits
+	ret |= kf_streamFlags();
+
 	return ret;
 }
 
@@ -0,0 +1,560 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Key frame segment table
+  ========================================
+
+  Continuous key frame moves only need each axis' velocity at the current
+  run time. The spline between two key frames is a cubic, so its velocity
+  is a quadratic in the normalized segment time u (0.0 - 1.0):
+
+	v(u) = c0 + c1 * u + c2 * u^2
+
+  kf_compileTable() samples the library spline three times per segment when
+  a program starts and stores the coefficients in Q16.16 steps/sec, along
+  with the segment start time and 2^32 / segment length. kf_tableSpeed()
+  then needs one 32x32 multiply to get u and two multiply-adds for the
+  velocity, with no float math and no walk of the key frame list, since the
+  current segment is cached per axis.
+
+  If an axis has more segments than the table holds, or a segment's
+  coefficients could overflow Q16.16 while it is evaluated, that axis falls
+  back to KeyFrames::vel().
+
+*/
+
+const byte	KF_MAX_SEGMENTS	= KF_MAX_POINTS - 1;	// Segments per axis held in the table
+const long	KF_FIXED_ONE	= 65536;		// 1.0 in Q16.16
+const float	KF_FIXED_MAX	= 32000.0;		// Largest coefficient sum (steps/sec) we'll evaluate in Q16.16
+
+struct kf_segment {
+	long			x0;			// Segment start time (ms)
+	unsigned long	inv_len;	// 2^32 / segment length (ms)
+	long			c0;			// Velocity coefficients, Q16.16 steps/sec
+	long			c1;
+	long			c2;
+};
+
+kf_segment kf_table[MOTOR_COUNT][KF_MAX_SEGMENTS];
+byte kf_table_segs[MOTOR_COUNT];			// Number of valid segments for each axis, 0 if the axis uses the float path
+byte kf_table_cur[MOTOR_COUNT];				// Cached current segment for each axis
+long kf_table_start[MOTOR_COUNT];			// First key frame time (ms)
+long kf_table_end[MOTOR_COUNT];				// Last key frame time (ms)
+boolean kf_reversed = false;				// Key frames are read through the reverse view (see below)
+
+
+/** Fixed Point Multiply
+
+ Multiplies two Q16.16 values.
+ */
+
+long kf_fixedMul(long p_a, long p_b) {
+	return (long)(((int64_t)p_a * p_b) >> 16);
+}
+
+
+/** Compile Key Frame Table
+
+ Builds the segment table for every axis from the current key frames.
+ Called when a continuous key frame program starts.
+ */
+
+void kf_compileTable() {
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+		int count = kf[i].getKFCount();
+
+		kf_table_segs[i] = 0;
+		kf_table_cur[i] = 0;
+
+		if (count < 2 || count - 1 > KF_MAX_SEGMENTS)
+			continue;
+
+		kf_table_start[i] = kf[i].getXN(0);
+		kf_table_end[i] = kf[i].getXN(count - 1);
+
+		boolean ok = true;
+
+		for (byte s = 0; s < count - 1; s++) {
+
+			float x0 = kf[i].getXN(s);
+			float len = kf[i].getXN(s + 1) - x0;
+
+			if (len < 2.0) {
+				ok = false;
+				break;
+			}
+
+			// Sample inside the segment so the key frames themselves are never
+			// evaluated on the boundary between two polynomials
+			float va = kf[i].vel(x0 + len * 0.25) * MILLIS_PER_SECOND;
+			float vm = kf[i].vel(x0 + len * 0.5)  * MILLIS_PER_SECOND;
+			float vb = kf[i].vel(x0 + len * 0.75) * MILLIS_PER_SECOND;
+
+			float c2 = 8.0 * (va - 2.0 * vm + vb);
+			float c1 = 2.0 * (vb - va) - c2;
+			float c0 = vm - 0.5 * c1 - 0.25 * c2;
+
+			// kf_segmentSpeed() sums c1 + u * c2 and then c0 + u * (...) with u
+			// up to 1.0, so the sums have to fit in Q16.16 as well as the terms
+			float inner = abs(c1) + abs(c2);
+
+			if (inner > KF_FIXED_MAX || abs(c0) + inner > KF_FIXED_MAX) {
+				ok = false;
+				break;
+			}
+
+			kf_segment& seg = kf_table[i][s];
+			seg.x0 = x0;
+			seg.inv_len = 4294967296.0 / len;
+			seg.c0 = c0 * KF_FIXED_ONE;
+			seg.c1 = c1 * KF_FIXED_ONE;
+			seg.c2 = c2 * KF_FIXED_ONE;
+		}
+
+		if (ok)
+			kf_table_segs[i] = count - 1;
+	}
+}
+
+
+/** Table Valid
+
+ Returns true if the given axis is evaluated from the segment table.
+ */
+
+boolean kf_tableValid(byte p_axis) {
+	return kf_table_segs[p_axis] > 0;
+}
+
+
+/** Table Speed
+
+ Returns the axis' velocity (steps/sec) at p_time (ms since the end of
+ the start delay), or 0 before the first or after the last key frame.
+ Honours the reverse view. Only valid for axes where kf_tableValid() is
+ true.
+ */
+
+float kf_tableSpeed(byte p_axis, long p_time) {
+
+	// A reversed pass reads the table backwards
+	if (kf_reversed)
+		p_time = kf_table_end[p_axis] - p_time;
+
+	if (p_time < kf_table_start[p_axis] || p_time > kf_table_end[p_axis])
+		return 0;
+
+	byte cur = kf_table_cur[p_axis];
+	byte last = kf_table_segs[p_axis] - 1;
+
+	if (cur > last)
+		cur = 0;
+
+	// Usually this is the same segment as last time, or the next one along
+	while (cur > 0 && p_time < kf_table[p_axis][cur].x0)
+		cur--;
+
+	while (cur < last && p_time >= kf_table[p_axis][cur + 1].x0)
+		cur++;
+
+	kf_table_cur[p_axis] = cur;
+
+	float speed = kf_segmentSpeed(p_axis, cur, p_time);
+	return kf_reversed ? -speed : speed;
+}
+
+
+/** Segment Speed
+
+ Evaluates one segment of the table at p_time (ms), returning steps/sec.
+ */
+
+float kf_segmentSpeed(byte p_axis, byte p_seg, long p_time) {
+
+	kf_segment& seg = kf_table[p_axis][p_seg];
+
+	// u in Q16.16
+	unsigned long dt = p_time - seg.x0;
+	long u = ((uint64_t)dt * seg.inv_len) >> 16;
+
+	if (u > KF_FIXED_ONE)
+		u = KF_FIXED_ONE;
+
+	long v = seg.c0 + kf_fixedMul(u, seg.c1 + kf_fixedMul(u, seg.c2));
+
+	return (float)v / KF_FIXED_ONE;
+}
+
+
+/*
+
+  ========================================
+  Reverse view
+  ========================================
+
+  Ping-pong programs run their key frames backwards on every other pass.
+  Instead of rebuilding the key frame arrays at each bounce, a reversed
+  pass reads them through a mirrored view: program time x maps to
+  xmax - x in the axis' key frames, where xmax is its last key frame, and
+  velocities change sign. A bounce only has to flip kf_reversed.
+
+  Anything that evaluates a running key frame program goes through
+  kf_tableSpeed() or the kf_view functions. Streamed axes are not
+  affected.
+
+*/
+
+
+/** Set Reverse View
+
+ Turns the reverse view on or off.
+ */
+
+void kf_reverseView(boolean p_reversed) {
+	kf_reversed = p_reversed;
+}
+
+
+/** Get Reverse View */
+
+boolean kf_reverseView() {
+	return kf_reversed;
+}
+
+
+ // Key frame time that program time p_x reads from
+float kf_viewX(byte p_axis, float p_x) {
+
+	if (!kf_reversed)
+		return p_x;
+
+	return kf[p_axis].getXN(kf[p_axis].getKFCount() - 1) - p_x;
+}
+
+
+/** View First Key Frame
+
+ Returns the time of the first key frame as seen through the view.
+ */
+
+float kf_viewFirst(byte p_axis) {
+
+	// The last key frame mirrors to 0
+	if (kf_reversed)
+		return 0;
+
+	return kf[p_axis].getXN(0);
+}
+
+
+/** View Last Key Frame
+
+ Returns the time of the last key frame as seen through the view.
+ */
+
+float kf_viewLast(byte p_axis) {
+
+	float last = kf[p_axis].getXN(kf[p_axis].getKFCount() - 1);
+
+	if (kf_reversed)
+		return last - kf[p_axis].getXN(0);
+
+	return last;
+}
+
+
+/** View Position
+
+ Returns the axis' position at program time p_x.
+ */
+
+float kf_viewPos(byte p_axis, float p_x) {
+	return kf[p_axis].pos(kf_viewX(p_axis, p_x));
+}
+
+
+/** View Velocity
+
+ Returns the axis' velocity (steps/ms) at program time p_x.
+ */
+
+float kf_viewVel(byte p_axis, float p_x) {
+
+	float vel = kf[p_axis].vel(kf_viewX(p_axis, p_x));
+	return kf_reversed ? -vel : vel;
+}
+
+
+/*
+
+  ========================================
+  Streamed key frames
+  ========================================
+
+  For programs with more points than fit in memory, the host can stream
+  key points instead of loading them all up front (key frame commands
+  24 - 26). Each point is a time (ms), position (steps) and velocity
+  (steps/sec). As each point arrives, the cubic Hermite segment from the
+  previous point is built straight into the axis' row of the segment
+  table, which is then used as a ring.
+
+  The ring holds the running segment plus two windows of KF_STREAM_WINDOW
+  segments. Whenever a full window is free the program run state asks the
+  host for more (KF_STREAM_REQUEST). If the run time gets past the last
+  point before the host has ended the stream, the axis has underrun: the
+  program is paused and KF_STREAM_UNDERRUN is reported until more points
+  arrive, after which the host can resume the program.
+
+  Streaming is used for continuous TL and video moves only.
+
+*/
+
+const byte KF_STREAM_WINDOW		= 4;			// Segments per window
+const int  KF_STREAM_REQUEST	= 0x10;			// Run state bit: a streaming axis has room for another window
+const int  KF_STREAM_UNDERRUN	= 0x20;			// Run state bit: a streaming axis ran out of points
+
+boolean kf_streaming = false;					// Streaming mode is on
+byte kf_stream_axes = 0;						// Bit per axis that has received streamed points
+byte kf_stream_ended = 0;						// Bit per axis whose stream the host has ended
+byte kf_stream_underrun = 0;					// Bit per axis that has run out of points
+byte kf_stream_tail[MOTOR_COUNT];				// Ring slot of the running segment
+byte kf_stream_count[MOTOR_COUNT];				// Segments queued, including the running one
+long kf_stream_last_x[MOTOR_COUNT];				// Last point received (ms, steps, steps/sec)
+float kf_stream_last_p[MOTOR_COUNT];
+float kf_stream_last_v[MOTOR_COUNT];
+
+
+/** Set Streaming Mode
+
+ Turns key frame streaming on or off. Either way, any streamed points are
+ discarded.
+ */
+
+void kf_streamMode(boolean p_on) {
+
+	kf_streaming = p_on;
+	kf_stream_axes = 0;
+	kf_stream_ended = 0;
+	kf_stream_underrun = 0;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		kf_stream_tail[i] = 0;
+		kf_stream_count[i] = 0;
+		kf_table_segs[i] = 0;
+	}
+}
+
+
+/** Streaming Mode
+
+ Returns true if key frame streaming is on.
+ */
+
+boolean kf_streamMode() {
+	return kf_streaming;
+}
+
+
+/** Axis Streaming
+
+ Returns true if the given axis is driven by streamed points.
+ */
+
+boolean kf_streamActive(byte p_axis) {
+	return kf_streaming && (kf_stream_axes & (1 << p_axis));
+}
+
+
+/** Free Segments
+
+ Returns the number of ring slots free for the given axis.
+ */
+
+byte kf_streamFree(byte p_axis) {
+	if (p_axis >= MOTOR_COUNT)
+		return 0;
+	return KF_MAX_SEGMENTS - kf_stream_count[p_axis];
+}
+
+
+/** Push Point
+
+ Adds a key point to the end of the given axis' stream. Returns false if
+ the ring is full, the point isn't after the previous one, or the stream
+ has been ended.
+ */
+
+boolean kf_streamPush(byte p_axis, long p_x, float p_pos, float p_vel) {
+
+	if (p_axis >= MOTOR_COUNT)
+		return false;
+
+	byte bit = 1 << p_axis;
+
+	if (!kf_streaming || (kf_stream_ended & bit))
+		return false;
+
+	// The first point only starts the stream
+	if (!(kf_stream_axes & bit)) {
+		kf_stream_axes |= bit;
+		kf_stream_last_x[p_axis] = p_x;
+		kf_stream_last_p[p_axis] = p_pos;
+		kf_stream_last_v[p_axis] = p_vel;
+		return true;
+	}
+
+	long len = p_x - kf_stream_last_x[p_axis];
+
+	if (len < 2 || kf_streamFree(p_axis) == 0)
+		return false;
+
+	// Velocity of the Hermite segment, as a quadratic in u
+	float v0 = kf_stream_last_v[p_axis];
+	float v1 = p_vel;
+	float d = (p_pos - kf_stream_last_p[p_axis]) * MILLIS_PER_SECOND / len;
+	float c1 = 6.0 * d - 4.0 * v0 - 2.0 * v1;
+	float c2 = -6.0 * d + 3.0 * v0 + 3.0 * v1;
+
+	// Same bound as kf_compileTable(): the sums kf_segmentSpeed() makes have to fit too
+	float inner = abs(c1) + abs(c2);
+
+	if (inner > KF_FIXED_MAX || abs(v0) + inner > KF_FIXED_MAX)
+		return false;
+
+	byte slot = (kf_stream_tail[p_axis] + kf_stream_count[p_axis]) % KF_MAX_SEGMENTS;
+	kf_segment& seg = kf_table[p_axis][slot];
+
+	seg.x0 = kf_stream_last_x[p_axis];
+	seg.inv_len = 4294967296.0 / len;
+	seg.c0 = v0 * KF_FIXED_ONE;
+	seg.c1 = c1 * KF_FIXED_ONE;
+	seg.c2 = c2 * KF_FIXED_ONE;
+
+	kf_stream_count[p_axis]++;
+	kf_stream_last_x[p_axis] = p_x;
+	kf_stream_last_p[p_axis] = p_pos;
+	kf_stream_last_v[p_axis] = p_vel;
+
+	// New data clears an underrun
+	kf_stream_underrun &= ~bit;
+
+	return true;
+}
+
+
+/** End Stream
+
+ Marks the last point of the given axis' stream as received, so running
+ past it finishes the axis instead of counting as an underrun.
+ */
+
+void kf_streamEnd(byte p_axis) {
+	if (p_axis < MOTOR_COUNT)
+		kf_stream_ended |= (1 << p_axis);
+}
+
+
+/** Stream Speed
+
+ Returns the velocity (steps/sec) of a streaming axis at p_time (ms since
+ the end of the start delay), retiring segments that have finished.
+ */
+
+float kf_streamSpeed(byte p_axis, long p_time) {
+
+	byte bit = 1 << p_axis;
+
+	if (kf_stream_count[p_axis] == 0) {
+		if (!(kf_stream_ended & bit))
+			kf_stream_underrun |= bit;
+		return 0;
+	}
+
+	byte tail = kf_stream_tail[p_axis];
+
+	if (p_time < kf_table[p_axis][tail].x0)
+		return 0;
+
+	// Retire finished segments. The running one ends where the next one
+	// starts, or at the last point received if it's the only one queued.
+	while (kf_stream_count[p_axis] > 1) {
+		byte next = (tail + 1) % KF_MAX_SEGMENTS;
+		if (p_time < kf_table[p_axis][next].x0)
+			break;
+		tail = next;
+		kf_stream_count[p_axis]--;
+	}
+
+	kf_stream_tail[p_axis] = tail;
+
+	if (kf_stream_count[p_axis] == 1 && p_time >= kf_stream_last_x[p_axis]) {
+		if (!(kf_stream_ended & bit))
+			kf_stream_underrun |= bit;
+		return 0;
+	}
+
+	return kf_segmentSpeed(p_axis, tail, p_time);
+}
+
+
+/** Stream Underrun
+
+ Returns true if any streaming axis has run out of points.
+ */
+
+boolean kf_streamUnderrun() {
+	return kf_stream_underrun != 0;
+}
+
+
+/** Stream Flags
+
+ Returns the KF_STREAM_x bits for the program run state.
+ */
+
+int kf_streamFlags() {
+
+	int flags = 0;
+
+	if (!kf_streaming)
+		return 0;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		byte bit = 1 << i;
+		if ((kf_stream_axes & bit) && !(kf_stream_ended & bit) && kf_streamFree(i) >= KF_STREAM_WINDOW)
+			flags |= KF_STREAM_REQUEST;
+	}
+
+	if (kf_stream_underrun)
+		flags |= KF_STREAM_UNDERRUN;
+
+	return flags;
+}
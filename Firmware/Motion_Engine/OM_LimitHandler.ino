@@ -273,6 +273,8 @@ void altOutStart(byte p_mode) {
  
 void altOutStop() {
  
+  unsigned long prof_start = micros();
+
   MsTimer2::stop();
   
    
@@ -296,6 +298,7 @@ void altOutStop() {
   {
     Engine.state(ST_MOVE);
   }
-    
+
+  profRecordSince(PROF_ALT_OUT, prof_start);
 }
 
@@ -0,0 +1,60 @@
+// OM_Log.h
+
+#ifndef _OM_LOG_h
+#define _OM_LOG_h
+
+/*
+
+  Binary log tokens
+
+  Each log site is identified by one of these tokens instead of carrying
+  its own text. The text for each token lives in flash (log_strings[] in
+  OM_Log.ino) and is only printed when DB_FUNCT output is on. With
+  DB_BINLOG on, a fixed size binary record is queued instead and sent
+  to the USB host in the background, packed into MoCoBus packets (see
+  OM_Log.ino); Firmware/Tools/log_decode.py turns the records back into
+  text.
+
+  Record layout (LOG_RECORD_LEN bytes, multi-byte values little endian):
+
+	Byte0    = LOG_SYNC
+	Byte1    = Token
+	Byte2    = Subaddress (LOG_CMD only, otherwise 0)
+	Byte3    = Command (LOG_CMD only, otherwise 0)
+	Byte4-7  = millis()
+	Byte8-11 = Value (long, or the raw bits of a float for LOG_CMD)
+
+  Tokens are only ever appended, so old logs still decode.
+
+*/
+
+#define LOG_SYNC		0xA5
+#define LOG_RECORD_LEN	12
+
+enum {
+	LOG_CMD = 0,				// A serial command, logged by debugMessage()
+	LOG_DROPPED,				// Records lost to a full ring, value is the count
+	LOG_CYCLE_START,
+	LOG_CYCLE_PAUSING,
+	LOG_CYCLE_MOT_DONE,
+	LOG_CYCLE_LEAD_OUT,
+	LOG_CYCLE_BAIL_1,
+	LOG_CYCLE_EXT_WAIT,
+	LOG_CYCLE_BAIL_2,
+	LOG_CYCLE_SHOTS,
+	LOG_CYCLE_BAIL_3,
+	LOG_CYCLE_CAM_BUSY,
+	LOG_CYCLE_EXPOSE,
+	LOG_SHOT_OK_ENTER,
+	LOG_SHOT_OK_EXT,
+	LOG_SHOT_OK_FORCE,
+	LOG_SHOT_OK_NO_FORCE,
+	LOG_KF_EXT_WAIT,
+	LOG_KF_BAIL_2,
+	LOG_CYCLE_MOT_POS_0,		// Motor positions at each shot, one token per motor
+	LOG_CYCLE_MOT_POS_1,
+	LOG_CYCLE_MOT_POS_2,
+	LOG_TOKEN_COUNT
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Tokenized logging
+  ========================================
+
+  See OM_Log.h for the tokens and the record layout. Records are queued in
+  a small ring and drained by a scheduler task, so logging never waits on
+  the serial port. The task only drains while no motor is moving, so log
+  traffic never competes with a move; records that arrive while the ring
+  is full are counted and reported with a LOG_DROPPED record.
+
+  Records are sent to the USB host inside MoCoBus packets, up to
+  LOG_PACKET_RECORDS at a time, addressed to the master with subaddress 0
+  and command LOG_PUSH_CMD. The USB stream is shared with NodeUSB, so raw
+  bytes would be taken for packet traffic by the host. Nothing is sent on
+  MoCoBus or Bluetooth.
+
+*/
+
+const byte LOG_RING_SIZE		= 120;			// Ring size in bytes (10 records)
+const byte LOG_PACKET_RECORDS	= 4;			// Records sent per packet
+const byte LOG_ADDR				= 1;			// Bus master address
+const byte LOG_PUSH_CMD			= 241;			// Command code of a log packet
+
+uint8_t log_ring[LOG_RING_SIZE];
+byte log_head = 0;							// Next byte to write
+byte log_tail = 0;							// Next byte to send
+byte log_used = 0;							// Bytes queued
+unsigned int log_dropped = 0;				// Records lost since the last LOG_DROPPED record
+
+// Text for each token, in token order. log_decode.py reads this table, keep one entry per line.
+const char LOG_S_CMD[]				PROGMEM = "Command";
+const char LOG_S_DROPPED[]			PROGMEM = "Log records dropped: ";
+const char LOG_S_CYCLE_START[]		PROGMEM = "cycleCamera() - Start";
+const char LOG_S_CYCLE_PAUSING[]	PROGMEM = "cycleCamera() - Pausing";
+const char LOG_S_CYCLE_MOT_DONE[]	PROGMEM = "cycleCamera() - All mot done moving";
+const char LOG_S_CYCLE_LEAD_OUT[]	PROGMEM = "cycleCamera() - ms of lead-out remaining: ";
+const char LOG_S_CYCLE_BAIL_1[]		PROGMEM = "cycleCamera() - Bailing from camera cycle at point 1";
+const char LOG_S_CYCLE_EXT_WAIT[]	PROGMEM = "cycleCamera() - Skipping shot, waiting for external trigger";
+const char LOG_S_CYCLE_BAIL_2[]		PROGMEM = "cycleCamera() - Bailing from camera cycle at point 2";
+const char LOG_S_CYCLE_SHOTS[]		PROGMEM = "cycleCamera() - Shots: ";
+const char LOG_S_CYCLE_BAIL_3[]		PROGMEM = "cycleCamera() - Bailing from camera cycle at point 3";
+const char LOG_S_CYCLE_CAM_BUSY[]	PROGMEM = "cycleCamera() - Camera busy: ";
+const char LOG_S_CYCLE_EXPOSE[]		PROGMEM = "cycleCamera() - Starting exposure cycle";
+const char LOG_S_SHOT_OK_ENTER[]	PROGMEM = "cycleShotOK() - Enter function";
+const char LOG_S_SHOT_OK_EXT[]		PROGMEM = "cycleShotOK() - Ext. interval mode active";
+const char LOG_S_SHOT_OK_FORCE[]	PROGMEM = "cycleShotOK() - altForceShot detected ************";
+const char LOG_S_SHOT_OK_NO_FORCE[]	PROGMEM = "cycleShotOK() - altForceShot not detected";
+const char LOG_S_KF_EXT_WAIT[]		PROGMEM = "kf_CameraCheck() - Skipping shot, waiting for external trigger";
+const char LOG_S_KF_BAIL_2[]		PROGMEM = "kf_CameraCheck() - Bailing from camera cycle at point 2";
+const char LOG_S_CYCLE_MOT_POS_0[]	PROGMEM = "cycleCamera() - Motor 0 position: ";
+const char LOG_S_CYCLE_MOT_POS_1[]	PROGMEM = "cycleCamera() - Motor 1 position: ";
+const char LOG_S_CYCLE_MOT_POS_2[]	PROGMEM = "cycleCamera() - Motor 2 position: ";
+
+const char* const log_strings[LOG_TOKEN_COUNT] PROGMEM = {
+	LOG_S_CMD,
+	LOG_S_DROPPED,
+	LOG_S_CYCLE_START,
+	LOG_S_CYCLE_PAUSING,
+	LOG_S_CYCLE_MOT_DONE,
+	LOG_S_CYCLE_LEAD_OUT,
+	LOG_S_CYCLE_BAIL_1,
+	LOG_S_CYCLE_EXT_WAIT,
+	LOG_S_CYCLE_BAIL_2,
+	LOG_S_CYCLE_SHOTS,
+	LOG_S_CYCLE_BAIL_3,
+	LOG_S_CYCLE_CAM_BUSY,
+	LOG_S_CYCLE_EXPOSE,
+	LOG_S_SHOT_OK_ENTER,
+	LOG_S_SHOT_OK_EXT,
+	LOG_S_SHOT_OK_FORCE,
+	LOG_S_SHOT_OK_NO_FORCE,
+	LOG_S_KF_EXT_WAIT,
+	LOG_S_KF_BAIL_2,
+	LOG_S_CYCLE_MOT_POS_0,
+	LOG_S_CYCLE_MOT_POS_1,
+	LOG_S_CYCLE_MOT_POS_2,
+};
+
+
+ // Queues one record, counting it as dropped if the ring is full
+void logRecord(byte p_token, byte p_a, byte p_b, unsigned long p_value) {
+
+	if (LOG_RING_SIZE - log_used < LOG_RECORD_LEN) {
+		log_dropped++;
+		return;
+	}
+
+	unsigned long time = millis();
+	uint8_t rec[LOG_RECORD_LEN] = {
+		LOG_SYNC, p_token, p_a, p_b,
+		(uint8_t)time, (uint8_t)(time >> 8), (uint8_t)(time >> 16), (uint8_t)(time >> 24),
+		(uint8_t)p_value, (uint8_t)(p_value >> 8), (uint8_t)(p_value >> 16), (uint8_t)(p_value >> 24)
+	};
+
+	for (byte i = 0; i < LOG_RECORD_LEN; i++) {
+		log_ring[log_head] = rec[i];
+		log_head = (log_head + 1) % LOG_RING_SIZE;
+	}
+
+	log_used += LOG_RECORD_LEN;
+}
+
+
+ // Prints a token's text, if DB_FUNCT output is on
+void logText(byte p_token) {
+	debug.funct((const __FlashStringHelper*)pgm_read_word(&log_strings[p_token]));
+}
+
+
+/** Log Event
+
+ Logs a token with no value.
+ */
+
+void logEvent(byte p_token) {
+
+	if (debug.getState() & DebugClass::DB_BINLOG)
+		logRecord(p_token, 0, 0, 0);
+
+	logText(p_token);
+	debug.functln("");
+}
+
+
+/** Log Event With Value
+
+ Logs a token followed by a value.
+ */
+
+void logEvent(byte p_token, long p_value) {
+
+	if (debug.getState() & DebugClass::DB_BINLOG)
+		logRecord(p_token, 0, 0, p_value);
+
+	logText(p_token);
+	debug.functln(p_value);
+}
+
+
+/** Log Command
+
+ Queues a binary record for a serial command. Called from debugMessage().
+ */
+
+void logCommand(byte p_subaddr, byte p_command, float p_data) {
+
+	uint32_t bits;
+	memcpy(&bits, &p_data, sizeof(p_data));
+	logRecord(LOG_CMD, p_subaddr, p_command, bits);
+}
+
+
+/** Log Idle
+
+ Returns true when no motor is moving, so log packets can be sent without
+ holding up a move.
+ */
+
+boolean logIdle() {
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (motor[i].running())
+			return false;
+	}
+
+	return true;
+}
+
+
+/** Log Drain Task
+
+ Called from the scheduler. While idle, sends up to LOG_PACKET_RECORDS
+ queued records to the USB host in one packet, or throws them away if USB
+ debug output is off.
+ */
+
+void taskLog() {
+
+	// Note any losses once there's room to say so
+	if (log_dropped && LOG_RING_SIZE - log_used >= LOG_RECORD_LEN) {
+		unsigned int dropped = log_dropped;
+		log_dropped = 0;
+		logRecord(LOG_DROPPED, 0, 0, dropped);
+	}
+
+	if (log_used == 0 || !logIdle())
+		return;
+
+	uint8_t packet[LOG_PACKET_RECORDS * LOG_RECORD_LEN];
+	byte len = 0;
+
+	while (log_used > 0 && len < sizeof(packet)) {
+		packet[len++] = log_ring[log_tail];
+		log_tail = (log_tail + 1) % LOG_RING_SIZE;
+		log_used--;
+	}
+
+	if (debug.getUSB())
+		NodeUSB.sendPacket(LOG_ADDR, 0, LOG_PUSH_CMD, len, packet);
+}
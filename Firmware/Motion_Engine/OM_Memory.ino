@@ -0,0 +1,156 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Memory instrumentation
+  ========================================
+
+  Before the C runtime initialises .data and .bss, memPaint() fills all
+  RAM between the end of .bss and the top of the stack with MEM_CANARY.
+  Whatever the stack or heap have ever written no longer holds that
+  value, so the untouched gap between them shows how close they have
+  come to meeting. General command 202 reports the results.
+
+*/
+
+const uint8_t MEM_CANARY		= 0xC5;
+
+// Stat selectors for general command 202
+const byte MEM_STAT_FREE		= 0;	// Bytes between the heap and the stack right now
+const byte MEM_STAT_STACK_HIGH	= 1;	// Most stack ever used
+const byte MEM_STAT_HEAP_HIGH	= 2;	// Most heap ever used
+const byte MEM_STAT_UNTOUCHED	= 3;	// Bytes neither the heap nor the stack has ever reached
+const byte MEM_STAT_FREE_LIST	= 4;	// Bytes held in malloc's free list
+const byte MEM_STAT_FRAGMENT	= 5;	// Fragmentation of free heap memory (%)
+
+// Layout of a free block in avr-libc's malloc
+struct mem_freelist {
+	size_t sz;
+	mem_freelist* nx;
+};
+
+extern char _end;
+extern char* __brkval;
+extern mem_freelist* __flp;
+
+void memPaint() __attribute__((naked, used, section(".init3")));
+
+
+/** Paint RAM
+
+ Runs from .init3, after the stack pointer is set up and before any
+ variables are initialised, so nothing in the painted area is live yet.
+ Never call it directly.
+ */
+
+void memPaint() {
+
+	uint8_t* p = (uint8_t*) &_end;
+
+	while (p <= (uint8_t*) RAMEND)
+		*p++ = MEM_CANARY;
+}
+
+
+ // Lowest address the stack has reached
+uint8_t* memStackLow() {
+
+	uint8_t* p = (uint8_t*) (__brkval ? __brkval : &_end);
+
+	while (p <= (uint8_t*) RAMEND && *p == MEM_CANARY)
+		p++;
+
+	return p;
+}
+
+
+ // Highest address the heap has reached, plus one
+uint8_t* memHeapHigh(uint8_t* p_stack_low) {
+
+	uint8_t* p = p_stack_low;
+	uint8_t* heap_start = (uint8_t*) &_end;
+
+	while (p > heap_start && *(p - 1) == MEM_CANARY)
+		p--;
+
+	return p;
+}
+
+
+/** Memory Stat
+
+ Returns one memory statistic (MEM_STAT_x).
+ */
+
+unsigned int memStat(byte p_stat) {
+
+	uint8_t* stack_low = memStackLow();
+	uint8_t* heap_high = memHeapHigh(stack_low);
+
+	switch (p_stat) {
+
+		case MEM_STAT_FREE:
+			return freeMemory();
+
+		case MEM_STAT_STACK_HIGH:
+			return (uint8_t*) RAMEND - stack_low + 1;
+
+		case MEM_STAT_HEAP_HIGH:
+			return heap_high - (uint8_t*) &_end;
+
+		case MEM_STAT_UNTOUCHED:
+			return stack_low - heap_high;
+
+		case MEM_STAT_FREE_LIST:
+		case MEM_STAT_FRAGMENT:
+		{
+			unsigned int total = 0;
+			unsigned int largest = 0;
+
+			for (mem_freelist* f = __flp; f; f = f->nx) {
+				total += f->sz;
+				if (f->sz > largest)
+					largest = f->sz;
+			}
+
+			if (p_stat == MEM_STAT_FREE_LIST)
+				return total;
+
+			// The gap above the heap can be handed out whole, so it counts as one block
+			unsigned int gap = freeMemory() - total;
+			if (gap > largest)
+				largest = gap;
+			total += gap;
+
+			return total ? 100 - (unsigned long) largest * 100 / total : 0;
+		}
+
+		default:
+			return 0;
+	}
+}
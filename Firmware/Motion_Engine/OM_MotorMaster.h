@@ -104,3 +104,4 @@
 #define OM_MOT_LINEAR 	4
 #define OM_MOT_QUAD	5
 #define OM_MOT_QUADINV	6
+#define OM_MOT_SCURVE	7
@@ -179,19 +179,22 @@ void stopAllMotors() {
         // set motors not moving in async mode
 
       for (int i = 0; i < MOTOR_COUNT; i++) {
-		motor[i].stop();		  
-		//update current position to EEPROM
-		long tempPosition= motor[i].currentPos();
-		OMEEPROM::write(EE_POS_0 + (i) * EE_MOTOR_MEMORY_SPACE, tempPosition);
+		stepMoveCancel(i);
+		motor[i].stop();
       }
+
+	  // queue the stopped positions for the EEPROM journal, written from loop()
+	  eepromSavePositions();
+
+	  // drop any S-curve profiles and put back any accelerations a coordinated move scaled
+	  scurveCancel();
+	  coordRestore();
 	  
-      
-      ISR_On = false;
+      // let go of interrupt cycle
+      stepCoreStop();
 
       // signal completion
       _fireCallback(OM_MOT_DONE);
-      // let go of interrupt cycle
-      Timer1.detachInterrupt();
 
 }
 
@@ -222,58 +225,61 @@ void clearAll() {
 
  // execute an async move, when specifying a direction
 void startISR() {
-	
-	if ((motor[0].running() || motor[1].running() || motor[2].running())){
-
-		// is async control not already running?
-		if( !ISR_On ) {
-           
-			_fireCallback(OM_MOT_MOVING);
-			Timer1.initialize(motor[0].curSamplePeriod());
-			Timer1.attachInterrupt(_runISR);
-			ISR_On = true;
-		} // end if not running
+
+	byte run_mask = 0;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (motor[i].running())
+			run_mask |= (1 << i);
 	}
 
-}
+	if (!run_mask)
+		return;
+
+	// A background attach check may have the drivers asleep
+	attachAbort();
+
+	// The ISR may be tearing itself down while we look at ISR_On, so the
+	// check and the re-attach have to happen with interrupts held off
+	noInterrupts();
+
+	bool started = false;
 
+	// is async control not already running?
+	if( !ISR_On ) {
 
- // our ISR that is run every time Timer1 triggers, controls stepping
- // of the motor
-
-void _runISR() {
-	//PORTF |= (1 << motor[2].stpflg);
-	//delayMicroseconds(1);
-	
-	
-    //steps all motors at once   
-	for(int i = 0; i < MOTOR_COUNT; i++){
-		if(motor[i].running()){				    
-			motor[i].checkRefresh();					// Reset motor steps, cycles, error, etc for the new ISR run
-			if (motor[i].checkStep()){					// 
-				byteFired |= (1 << motor[i].stpflg);
-			}
-		} // end if( motor[i].m_isRun
-
-	} // end for loop	
-		
-	
-	
-    PORTF |= byteFired;
-    delayMicroseconds(1);
-    PORTF &= ~byteFired;
-	
-
-	
-	//resets the byteFired flag
-	byteFired = 0;
-	
-    if (!(motor[0].running() || motor[1].running() || motor[2].running())){
-        stopAllMotors();
-    }
-
-	//PORTF &= ~(1 << motor[2].stpflg);
+		// motionDone is left alone: if the last move's completion hasn't been
+		// handled yet, motionDoneCheck() still fires it
+		stepCoreStartPlan(motor[0].curSamplePeriod());
+		ISR_On = true;
+		started = true;
+	} // end if not running
+
+	interrupts();
+
+	if (started)
+		_fireCallback(OM_MOT_MOVING);
 }
 
 
+/** Finish Motion
+
+ Called from loop(). When the step ISR runs out of work it only detaches
+ itself and raises motionDone; the rest of the stop handling (callbacks,
+ position bookkeeping) is done here so it never runs inside the interrupt.
+ */
+
+void motionDoneCheck() {
 
+	if (!motionDone)
+		return;
+
+	motionDone = false;
+
+	// A new move may have been started since the ISR went idle. Leave it
+	// running, but still signal that the last one finished.
+	if (!ISR_On)
+		stopAllMotors();
+	else
+		_fireCallback(OM_MOT_DONE);
+}
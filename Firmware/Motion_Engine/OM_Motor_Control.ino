@@ -36,6 +36,9 @@ See dynamicperception.com for more information
 const byte MT_COM_DIR1 = 50;
 const byte MT_COM_DIR2 = 100;
 
+const unsigned int SMS_SETTLE_MS	= 100;	// Time allowed for the rig to settle after each SMS move
+const unsigned int SMS_MAX_MOVE_MS	= 500;	// Longest a short SMS move is stretched out to, to save battery
+
 void move_motor() {
 
     // do we revert back to "ready" or "waiting" if there
@@ -54,6 +57,7 @@ void move_motor() {
 	   if( motor[i].enable()){
 		   //check to see if there's a shot delay for the motor
 		   if (!(motor[i].planLeadIn() > 0 && ((camera_fired <= motor[i].planLeadIn() && motor[i].planType() == SMS) || (motor[i].planType() != SMS && run_time <= motor[i].planLeadIn())))){
+				stepMoveCancel(i);
 				motor[i].programMove();
 				if( motor[i].planType()  == SMS ) {
 					// planned SMS move
@@ -139,18 +143,43 @@ byte motorSleep(byte p_motor) {
 
 
 /*
-	void takeUpBackLash()
 
-	This function checks which motors have backlash and take it up.
+  Program start sequence
+
+  Starting a program can involve waiting for backlash to be taken up and,
+  for video moves, for the camera to start recording. Rather than spinning
+  inside the serial command handler, startProgramCom() sets up the first
+  stage and returns, and startUpdate() moves through the stages from the
+  scheduler. The start command is answered right away; getRunStatus()
+  reports STARTING until the program is actually running.
+
+*/
+
+const byte START_IDLE		= 0;		// No start in progress
+const byte START_BACKLASH	= 1;		// Waiting for backlash takeup to finish
+const byte START_PREROLL	= 2;		// Waiting for the video camera to start recording
+
+const unsigned int BACKLASH_WAIT	= 300;	// Time (ms) allowed for backlash takeup
+const unsigned int PREROLL_WAIT		= 1500;	// Time (ms) allowed for a video camera to start
+
+byte start_stage			= START_IDLE;
+boolean start_program		= false;	// Start the program once the current stage is done
+unsigned long start_time_stage	= 0;	// millis() when the current stage began
+
+
+/*
+	boolean takeUpBacklashStart()
+
+	This function checks which motors have backlash and starts taking it up.
 	This is determined by comparing their last direction to the direction
 	they will need to move to get to their program stop position.
 
+	Returns true if any motor is moving, in which case takeUpBacklashFinish()
+	must be called once the takeup is done.
+
 */
-void takeUpBacklash(){
-	takeUpBacklash(false);
-}
 
-void takeUpBacklash(boolean kf_move){
+boolean takeUpBacklashStart(){
 	uint8_t wait_required = false;
 	// Check each motor to see if it needs backlash compensation
 	for (byte i = 0; i < MOTOR_COUNT; i++) {		
@@ -173,24 +202,52 @@ void takeUpBacklash(boolean kf_move){
 		}
 	}
 
-	// Can't wait when it's a keyframe move. For some reason this causes the controller to lock	
-	if (wait_required && !kf_move) {
-		unsigned long time = millis();
-		const int BACKLASH_WAIT = 300;
-		while (millis() - time < BACKLASH_WAIT){
-			// Wait for backlash takeup to finish
-		}
-	}
+	return wait_required;
+}
 
-	// Re-set all the motors to their proper microstep settings
+/*
+	void takeUpBacklashFinish()
+
+	Re-sets all the motors to their proper microstep settings after backlash takeup.
+
+*/
+
+void takeUpBacklashFinish(){
 	for (byte i = 0; i < MOTOR_COUNT; i++) {
 		motor[i].restoreLastMs();
 
 		// Print debug info if proper flag is set
-		debug.funct("Microsteps: ");
+		debug.funct(F("Microsteps: "));
 		debug.functln(motor[i].ms());		
 	}
-	debug.functln("Out of loop and moving on!");
+	debug.functln(F("Out of loop and moving on!"));
+}
+
+/*
+	void takeUpBacklash()
+
+	Takes up backlash without starting a program. The microstep settings are
+	restored by startUpdate() once the takeup is done.
+
+*/
+
+void takeUpBacklash(){
+	if (start_stage != START_IDLE)
+		return;
+
+	if (takeUpBacklashStart()) {
+		start_program = false;
+		startStage(START_BACKLASH);
+	}
+	else
+		takeUpBacklashFinish();
+}
+
+
+ // Enters a start sequence stage
+void startStage(byte p_stage) {
+	start_stage = p_stage;
+	start_time_stage = millis();
 }
 
 
@@ -198,10 +255,15 @@ void takeUpBacklash(boolean kf_move){
 	void startProgramCom()
 
 	Runs all pre-program checks after a start program command is received from a master device. 
-	Actual motor movement is started by calling startProgram() at the end of this function.
+	Anything that has to wait is left to startUpdate(), which calls startProgram() at the end
+	of the sequence.
 */
 
 void startProgramCom() {
+
+	// A start is already under way
+	if (startPending())
+		return;
 	
 	bool was_pause = pause_flag;
 	pause_flag = false;
@@ -212,78 +274,120 @@ void startProgramCom() {
 		// Reset the shot counter to 0. If the user presses the "Fire Camera" button in the joystick screen of the app, it may be a non-zero number.
 		clearShotCounter();
 
+		// Recompute the program length up front, so the control cycle only reads the cached values
+		programGeometryDirty();
+		updateProgramGeometry();
+
 		// Reset the program completion flag
 		program_complete = false;
 		ping_pong_time = 0;
 		
-		takeUpBacklash();		
+		start_program = true;
 
-		// Re-set all the motors to their proper microstep settings
-		for (byte i = 0; i < MOTOR_COUNT; i++) {
-			if (!graffikMode())
-				msAutoSet(i);
+		// If backlash is already being taken up, startUpdate() carries on from there
+		if (start_stage == START_BACKLASH)
+			return;
 
-			// Print debug info if proper flag is set
-			debug.funct("Microsteps: ");
-			debug.functln(motor[i].ms());
-			
+		if (takeUpBacklashStart()) {
+			startStage(START_BACKLASH);
+			return;
 		}
 
-		// When starting an SMS move, if we're only making small moves, set each motor's speed no faster than necessary to produce the smoothest motion possible
-		if (Motors::planType() == SMS) {
-			
-			// Determine the max time in seconds allowed for moving the motors
-			float max_move_time = (Camera.intervalTime() - Camera.triggerTime() - Camera.delayTime() - Camera.focusTime()) / MILLIS_PER_SECOND;
-			// If there's lots of time for moving, only use 1 second so we don't waste battery life getting to the destination
-			if (max_move_time > 0.5)
-				max_move_time = 0.5;
-			// Determine the maximum number of steps each motor needs to move. For short move, throttle the speed to avoid jerking of the rig.
-			for (byte i = 0; i < MOTOR_COUNT; i++) {
-				int steps_per_move = motor[i].getTopSpeed();
-				if (steps_per_move < 500) {
-					// Only use 50% of the maximum move time to allow for accel and decel phases
-					motor[i].contSpeed((float)steps_per_move / (max_move_time * 0.5));
-				}
-			}
-		}
+		takeUpBacklashFinish();
+		startPrepare();
+		return;
+	}//end if (!running && !was_pause)
 
-		// If we're starting a video move, fire the camera trigger pin to start the video camera
-		if (Motors::planType() == CONT_VID) {
-			Camera.expose();
-			unsigned long time = millis();
-			while (millis() - time < (MILLIS_PER_SECOND * 1.5))
-			{
-				// Wait a second and a half for the video to start before starting the move.
-			}
+	startLaunch(was_pause);
+}
+
+
+/*
+	void startPrepare()
+
+	Sets up the motors for the program once any backlash is taken up, then either
+	starts the video camera or starts the program.
+*/
+
+void startPrepare() {
+
+	// Re-set all the motors to their proper microstep settings
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (!graffikMode())
+			msAutoSet(i);
+
+		// Print debug info if proper flag is set
+		debug.funct(F("Microsteps: "));
+		debug.functln(motor[i].ms());
+		
+	}
+
+	// When starting an SMS move, set each motor's speed no faster than necessary to finish its move in the
+	// time the camera leaves, to produce the smoothest motion possible
+	if (Motors::planType() == SMS) {
+
+		float move_time = smsMoveWindow() / MILLIS_PER_SECOND;
+
+		for (byte i = 0; i < MOTOR_COUNT; i++) {
+			float top_speed = smsTopSpeed(i);
+			float speed = trapezoidSpeed(motor[i].getTopSpeed(), move_time, motor[i].contAccel());
+
+			// Can't make it in time, so go flat out and let the camera wait for the move
+			if (speed <= 0 || speed > top_speed)
+				speed = top_speed;
+
+			motor[i].contSpeed(speed);
 		}
-	}//end if (!running && !was_pause)
+	}
+
+	// If we're starting a video move, fire the camera trigger pin to start the video camera,
+	// then give it a second and a half to start before starting the move
+	if (Motors::planType() == CONT_VID) {
+		Camera.expose();
+		startStage(START_PREROLL);
+		return;
+	}
+
+	startLaunch(false);
+}
+
+
+/*
+	void startLaunch(bool p_was_pause)
+
+	Final step of the start sequence. Starts or resumes the program.
+*/
+
+void startLaunch(bool p_was_pause) {
+
+	start_stage = START_IDLE;
+	start_program = false;
 
 	// Don't start a new program if one is already running
 	if (!running) {
-		const String MOTOR = "Motor ";
-		debug.functln(MOTOR + "dist: ");
+		debug.functln(F("Motor dist: "));
 		for (byte i = 0; i < MOTOR_COUNT; i++){
 			debug.functln(motor[i].stopPos() - motor[i].currentPos());
 		}
-		debug.functln(MOTOR + "start:");
+		debug.functln(F("Motor start:"));
 		for (byte i = 0; i < MOTOR_COUNT; i++){
 			debug.functln(motor[i].startPos());
 		}
-		debug.functln(MOTOR + "stop:");
+		debug.functln(F("Motor stop:"));
 		for (byte i = 0; i < MOTOR_COUNT; i++){
 			debug.functln(motor[i].stopPos());
 		}
-		debug.functln(MOTOR + "current:");
+		debug.functln(F("Motor current:"));
 		for (byte i = 0; i < MOTOR_COUNT; i++){
 			debug.functln(motor[i].currentPos());
 		}
-		debug.functln(MOTOR + "travel:");
+		debug.functln(F("Motor travel:"));
 		for (byte i = 0; i < MOTOR_COUNT; i++){
 			debug.functln(motor[i].planTravelLength());
 		}		
 
 		//if it was paused and not SMS then recalculate move from pause time
-		if (was_pause && Motors::planType() != SMS){
+		if (p_was_pause && Motors::planType() != SMS){
 			for (byte i = 0; i < MOTOR_COUNT; i++){
 				if (motor[i].enable())
 					motor[i].resumeMove();
@@ -294,6 +398,63 @@ void startProgramCom() {
 	}
 }
 
+/*
+	void startUpdate()
+
+	Advances the program start sequence. Called from the scheduler.
+*/
+
+void startUpdate() {
+
+	switch (start_stage) {
+
+		case START_BACKLASH:
+			if (millis() - start_time_stage < BACKLASH_WAIT)
+				return;
+			takeUpBacklashFinish();
+			start_stage = START_IDLE;
+			if (start_program)
+				startPrepare();
+			break;
+
+		case START_PREROLL:
+			if (millis() - start_time_stage < PREROLL_WAIT)
+				return;
+			startLaunch(false);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+/*
+	void startCancel()
+
+	Abandons a start sequence in progress. Called when the program is stopped.
+*/
+
+void startCancel() {
+
+	if (start_stage == START_BACKLASH)
+		takeUpBacklashFinish();
+
+	start_stage = START_IDLE;
+	start_program = false;
+}
+
+
+/*
+	boolean startPending()
+
+	Returns true while a program start is in progress.
+*/
+
+boolean startPending() {
+	return start_stage != START_IDLE && start_program;
+}
+
 /*
 byte validateProgram()
 
@@ -356,6 +517,7 @@ byte validateProgram(byte p_motor, bool p_autosteps) {
 		max_time_per_move = (steps_per_move / comparison_speed) * MILLIS_PER_SECOND;									// Max time in milliseconds
 		unsigned long new_interval = max_time_per_move - (float)(Camera.delayTime() + Camera.triggerTime() + Camera.focusTime());	// Minimum camera interval
 		Camera.intervalTime(new_interval);
+		programGeometryDirty();
 		
 		// Always run in eight steps for external intervalometer mode
 		if (p_autosteps)
@@ -367,14 +529,19 @@ byte validateProgram(byte p_motor, bool p_autosteps) {
 	// For time lapse SMS mode
 	if (motor[p_motor].planType() == SMS) {
 
-		// Max time in seconds
-		float max_time_per_move = (float)(Camera.intervalTime() - Camera.delayTime() - Camera.triggerTime() - Camera.focusTime()) / MILLIS_PER_SECOND;
+		// Max time in seconds, the same window startPrepare() plans the move in
+		float max_time_per_move = smsMoveWindow() / MILLIS_PER_SECOND;
 
 
 		// The "topSpeed" variable in SMS mode is actually the number of steps per move during the constant speed segment
 		steps_per_move = motor[p_motor].getTopSpeed();
 
-		comparison_speed = steps_per_move / (float)max_time_per_move;
+		// Cruise speed needed to cover the move in time, accelerating and decelerating at the motor's rate
+		comparison_speed = trapezoidSpeed(steps_per_move, max_time_per_move, motor[p_motor].contAccel());
+
+		// The move can't be made in time at any speed
+		if (comparison_speed < 0)
+			comparison_speed = MAX_CUTOFF;
 
 	}
 
@@ -409,6 +576,140 @@ byte validateProgram(byte p_motor, bool p_autosteps) {
 
 }
 
+/*
+float trapezoidTime(float p_steps, float p_speed, float p_accel)
+
+Returns the shortest time in seconds to move p_steps from rest to rest, cruising no faster than p_speed
+(steps/sec) and accelerating and decelerating at p_accel (steps/sec^2).
+
+*/
+
+float trapezoidTime(float p_steps, float p_speed, float p_accel) {
+
+	if (p_steps <= 0 || p_speed <= 0)
+		return 0;
+
+	if (p_accel <= 0)
+		return p_steps / p_speed;
+
+	// Too short to reach the top speed: accelerate halfway, then decelerate
+	if (p_steps * p_accel <= p_speed * p_speed)
+		return 2.0 * sqrt(p_steps / p_accel);
+
+	return p_steps / p_speed + p_speed / p_accel;
+}
+
+/*
+float trapezoidSpeed(float p_steps, float p_time, float p_accel)
+
+Returns the slowest cruise speed (steps/sec) that still moves p_steps from rest to rest in p_time seconds,
+accelerating and decelerating at p_accel (steps/sec^2). Returns -1 if it can't be done at any speed.
+
+*/
+
+float trapezoidSpeed(float p_steps, float p_time, float p_accel) {
+
+	if (p_steps <= 0)
+		return 0;
+
+	if (p_time <= 0)
+		return -1;
+
+	if (p_accel <= 0)
+		return p_steps / p_time;
+
+	// p_steps = v * (p_time - v / p_accel), the smaller root is the slower profile
+	float disc = p_accel * p_accel * p_time * p_time - 4.0 * p_accel * p_steps;
+
+	if (disc < 0)
+		return -1;
+
+	return (p_accel * p_time - sqrt(disc)) / 2.0;
+}
+
+/*
+float smsTopSpeed(byte p_motor)
+
+Returns the fastest the motor can be driven in steps/sec, limited by its own max speed and the controller's
+max step rate.
+
+*/
+
+float smsTopSpeed(byte p_motor) {
+	return min(motor[p_motor].maxSpeed(), maxStepRate());
+}
+
+/*
+unsigned long smsCameraTime()
+
+Returns the part of each SMS cycle used by the camera and for settling after the move, in milliseconds.
+
+*/
+
+unsigned long smsCameraTime() {
+	return Camera.focusTime() + Camera.triggerTime() + Camera.delayTime() + SMS_SETTLE_MS;
+}
+
+/*
+float smsLongestMove()
+
+Returns the slowest enabled motor's minimum SMS move time in seconds, at its top speed and acceleration.
+
+*/
+
+float smsLongestMove() {
+
+	float longest = 0;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+		if (!motor[i].enable())
+			continue;
+
+		float move_time = trapezoidTime(motor[i].getTopSpeed(), smsTopSpeed(i), motor[i].contAccel());
+
+		if (move_time > longest)
+			longest = move_time;
+	}
+
+	return longest;
+}
+
+/*
+unsigned long smsMoveWindow()
+
+Returns the time each SMS move is planned to take in milliseconds: what the camera interval leaves. To save
+battery the window is held to SMS_MAX_MOVE_MS, but only when every enabled motor can still make its move in
+that time; otherwise the whole window is used.
+
+*/
+
+unsigned long smsMoveWindow() {
+
+	long window = (long)Camera.intervalTime() - (long)smsCameraTime();
+
+	if (window < 0)
+		return 0;
+
+	if (window > (long)SMS_MAX_MOVE_MS && smsLongestMove() * MILLIS_PER_SECOND <= SMS_MAX_MOVE_MS)
+		return SMS_MAX_MOVE_MS;
+
+	return window;
+}
+
+/*
+unsigned long smsMinInterval()
+
+Returns the shortest camera interval in milliseconds SMS moves allow: the slowest enabled motor's
+minimum move time at its top speed and acceleration, plus the camera and settle time.
+
+*/
+
+unsigned long smsMinInterval() {
+
+	return (unsigned long)(smsLongestMove() * MILLIS_PER_SECOND + 0.5) + smsCameraTime();
+}
+
 /*
 byte msAutoSet(uint8_t p_motor_number)
 
@@ -478,7 +779,7 @@ void joystickSet(byte p_input) {
 	joystick_mode = p_input;
 	
 	debug.ser("Joystick: ");
-	debug.serln(String(joystick_mode));	
+	debug.serln(joystick_mode);	
 
 	// Set the speed of all motors to zero when turning on joystick mode to prevent runaway motors
 	if (joystick_mode){
@@ -561,6 +862,7 @@ void setJoystickSpeed(int p_motor, float p_speed){
 		else if (new_speed < 1)
 			dir = 0;
 
+		stepMoveCancel(p_motor);
 		motor[p_motor].continuous(true);
 		motor[p_motor].move(dir, 0);
 		startISR();
@@ -587,15 +889,13 @@ void setJoystickSpeed(int p_motor, float p_speed){
 	}
 }
 
-/** Reverse Move
+/** Swap Start and Stop
 
-Stops the motors, switches the start and stop positions, then restarts the motors.
-Moves only if ping_pong_mode is enabled.
+Switches every motor's start and stop positions. Used between ping-pong passes
+of a classic program.
 */
 
-void reverseStartStop(){
-	debug.serln("reverseStartStop()");
-
+void swapStartStop(){
 	for (int i = 0; i < MOTOR_COUNT; i++){
 		//Switches start and stop positions
 		long curStart = motor[i].startPos();
@@ -603,6 +903,24 @@ void reverseStartStop(){
 		motor[i].startPos(curStop);
 		motor[i].stopPos(curStart);
 	}
+}
+
+// Scratch space for reverseStartStop(), so reversing never touches the heap
+float reverse_abscissa[KF_MAX_POINTS];
+float reverse_pos[KF_MAX_POINTS];
+float reverse_vel[KF_MAX_POINTS];
+
+
+/** Reverse Move
+
+Switches the start and stop positions and rewrites the key frames in reverse order.
+Ping-pong passes use swapStartStop() and the key frame reverse view instead.
+*/
+
+void reverseStartStop(){
+	debug.serln(F("reverseStartStop()"));
+
+	swapStartStop();
 
 	// Swap key point order		
 	for (int i = 0; i < MOTOR_COUNT; i++){
@@ -610,23 +928,18 @@ void reverseStartStop(){
 		int count = kf[i].getKFCount();
 
 		// Don't try to reverse if there's nothing to reverse
-		if (count == 0){	
+		if (count == 0 || count > KF_MAX_POINTS){	
 			continue;
 		}
 
-		// Allocate space for temporary array
-		float* tempAbscissa = (float*)malloc(count * sizeof(float));
-		float* tempPos		= (float*)malloc(count * sizeof(float));
-		float* tempVel		= (float*)malloc(count * sizeof(float));
-	
 		// Copy existing array to temporary arr. Don't reverse abscissa order.
 		float maxAbscissa = kf[i].getXN(count-1);
 		for (int j = 0; j < count; j++){
 			// Need to mirror abscissas rather than simply reversing them
-			tempAbscissa[j] = maxAbscissa - kf[i].getXN((count - 1) - j);			
-			tempPos[j]		= kf[i].getFN((count - 1) - j);
+			reverse_abscissa[j] = maxAbscissa - kf[i].getXN((count - 1) - j);			
+			reverse_pos[j]		= kf[i].getFN((count - 1) - j);
 			// Invert velocities
-			tempVel[j]		= -kf[i].getDN((count - 1) - j);
+			reverse_vel[j]		= -kf[i].getDN((count - 1) - j);
 		}
 
 		// Clear existing key frames
@@ -637,15 +950,10 @@ void reverseStartStop(){
 
 		// Repopulate in reverse order
 		for (int j = 0; j < count; j++){
-			kf[i].setXN(tempAbscissa[j]);
-			kf[i].setFN(tempPos[j]);
-			kf[i].setDN(tempVel[j]);
+			kf[i].setXN(reverse_abscissa[j]);
+			kf[i].setFN(reverse_pos[j]);
+			kf[i].setDN(reverse_vel[j]);
 		}
-
-		// Free memory used in tempoary arrays
-		free(tempAbscissa);
-		free(tempPos);
-		free(tempVel);
 	}
 }
       
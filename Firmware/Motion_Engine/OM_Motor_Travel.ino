@@ -34,6 +34,9 @@ See dynamicperception.com for more information
  
  */
  
+bool coordinated_moves = true;				// Multi-axis sends finish together (sendToAll)
+float coord_accel[MOTOR_COUNT];				// User accelerations while a coordinated move has scaled them
+byte coord_saved = 0;						// Motors with an acceleration saved in coord_accel
  
 void sendAllToStart() {
 
@@ -65,7 +68,7 @@ void sendToStart(uint8_t p_motor) {
     motor[p_motor].contSpeed(motor[p_motor].maxSpeed());
 
 	// Start the move
-	motor[p_motor].moveToStart();
+	stepMoveTo(p_motor, motor[p_motor].startPos());
 	startISR();
 	motor[p_motor].setSending(true);
 }
@@ -74,7 +77,7 @@ void sendToStop(uint8_t p_motor){
 	// Move at the maximum motor speed		
 	motor[p_motor].ms(4);
     motor[p_motor].contSpeed(motor[p_motor].maxSpeed());
-	motor[p_motor].moveToStop();
+	stepMoveTo(p_motor, motor[p_motor].stopPos());
 	startISR();
 	motor[p_motor].setSending(true);
 }
@@ -97,8 +100,19 @@ void sendTo(uint8_t p_motor, long p_pos, boolean kf_move){
 	debug.funct(p_motor);
 	debug.funct(" to position ");
 	debug.functln(p_pos);
+
+	// S-curve motors follow their own profile, unless the move is too long for one
+	if (scurveEasing(p_motor)) {
+		float steps = abs(p_pos - motor[p_motor].currentPos());
+		if (scurveStart(p_motor, p_pos, scurveTime(steps, smsTopSpeed(p_motor), motor[p_motor].contAccel()))) {
+			if (!kf_move)
+				motor[p_motor].setSending(true);
+			return;
+		}
+	}
+
     motor[p_motor].contSpeed(motor[p_motor].maxSpeed());
-	motor[p_motor].moveTo(p_pos, true);
+	stepMoveTo(p_motor, p_pos);
 	debug.funct("Speed: ");
 	debug.functln(motor[p_motor].contSpeed());
 	debug.funct("Continuous: ");
@@ -106,4 +120,164 @@ void sendTo(uint8_t p_motor, long p_pos, boolean kf_move){
 	startISR();
 	if (!kf_move)
 		motor[p_motor].setSending(true);
-}
\ No newline at end of file
+}
+
+
+/** Coordinated Send
+
+ Sends every motor set in p_mask to its position in p_pos so that they all
+ start and arrive together, moving along a straight line in joint space.
+
+ Every axis is given the same normalized profile: its speed and
+ acceleration are both scaled by its distance, and the moves are cut into
+ the same step queue segments. Whichever axis would take
+ longest at its own limits sets the pace for the rest. The scaled
+ accelerations are put back by coordRestore() once the motors stop.
+
+ If any of the motors uses the S-curve easing mode, they all follow the
+ S-curve instead, over the time the slowest of them needs for it.
+
+ Falls back to separate sendTo() calls when coordinated moves are off.
+ */
+
+void sendToAll(long* p_pos, byte p_mask, boolean kf_move){
+
+	if (!coordinated_moves) {
+		for (byte i = 0; i < MOTOR_COUNT; i++) {
+			if (p_mask & (1 << i))
+				sendTo(i, p_pos[i], kf_move);
+		}
+		return;
+	}
+
+	long target[MOTOR_COUNT];
+	float dist[MOTOR_COUNT];
+	float pace = -1;			// Shared speed, in move lengths per second
+	float pace_accel = -1;		// Shared acceleration, in move lengths per second^2
+	float scurve_time = 0;		// Shared S-curve move time (s)
+	bool scurve = false;		// One of the motors uses the S-curve easing mode
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+		dist[i] = 0;
+
+		if (!(p_mask & (1 << i)))
+			continue;
+
+		target[i] = p_pos[i];
+
+		if (!kf_move) {
+			motor[i].ms(4);
+			// Adjust the send location to match new microsteps
+			target[i] *= ((float)motor[i].ms() / (float)motor[i].lastMs());
+		}
+
+		dist[i] = abs(target[i] - motor[i].currentPos());
+		if (dist[i] == 0)
+			continue;
+
+		// Leave the user's acceleration aside if an earlier move hasn't already
+		if (!(coord_saved & (1 << i))) {
+			coord_accel[i] = motor[i].contAccel();
+			coord_saved |= (1 << i);
+		}
+
+		float speed = smsTopSpeed(i) / dist[i];
+		if (pace < 0 || speed < pace)
+			pace = speed;
+
+		// No acceleration limit means the motor can match any ramp
+		if (coord_accel[i] > 0) {
+			float accel = coord_accel[i] / dist[i];
+			if (pace_accel < 0 || accel < pace_accel)
+				pace_accel = accel;
+		}
+
+		if (scurveEasing(i))
+			scurve = true;
+		scurve_time = max(scurve_time, scurveTime(dist[i], smsTopSpeed(i), coord_accel[i]));
+	}
+
+	// Every profile has the same length, so they either all start or none does
+	if (scurve) {
+		for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+			if (!(p_mask & (1 << i)) || dist[i] == 0)
+				continue;
+
+			if (!scurveStart(i, target[i], scurve_time)) {
+				scurve = false;
+				break;
+			}
+
+			if (!kf_move)
+				motor[i].setSending(true);
+		}
+
+		if (scurve)
+			return;
+	}
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+		if (!(p_mask & (1 << i)) || dist[i] == 0)
+			continue;
+
+		motor[i].contSpeed(pace * dist[i]);
+		if (pace_accel > 0)
+			motor[i].contAccel(pace_accel * dist[i]);
+
+		debug.funct("Coordinated send, motor ");
+		debug.funct(i);
+		debug.funct(" to position ");
+		debug.functln(target[i]);
+
+		stepMoveTo(i, target[i]);
+		if (!kf_move)
+			motor[i].setSending(true);
+	}
+
+	startISR();
+}
+
+
+/** Restore Coordinated Accelerations
+
+ Puts back the accelerations a coordinated move scaled. Called when the
+ motors stop.
+ */
+
+void coordRestore(){
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (coord_saved & (1 << i))
+			motor[i].contAccel(coord_accel[i]);
+	}
+
+	coord_saved = 0;
+}
+
+
+/** Drop Saved Acceleration
+
+ Forgets a motor's saved acceleration, so a new one set while a coordinated
+ move is running isn't overwritten when it stops.
+ */
+
+void coordForget(byte p_motor){
+	coord_saved &= ~(1 << p_motor);
+}
+
+
+/** Coordinated Moves
+
+ Turns coordinated multi-axis sends on or off, or returns the setting.
+ */
+
+void coordinatedMoves(bool p_setting){
+	coordinated_moves = p_setting;
+}
+
+bool coordinatedMoves(){
+	return coordinated_moves;
+}
@@ -0,0 +1,27 @@
+// OM_Profile.h
+
+#ifndef _OM_PROFILE_h
+#define _OM_PROFILE_h
+
+/*
+
+  Profiling sites
+
+  Each instrumented site keeps its own run time statistics (OM_Profile.ino),
+  read back with general commands 203 and 204. Times are in microseconds.
+  The histogram is log scale: bucket 0 counts runs under 2us, bucket n
+  counts runs of 2^n - 2^(n+1)-1 us and the last bucket everything longer.
+
+*/
+
+#define PROF_BUCKETS	12
+
+enum {
+	PROF_STEP_ISR = 0,			// Step ISR, from the Timer1 event to the end of the ISR
+	PROF_CAMERA,				// Camera callback, run from the MsTimer2 interrupt
+	PROF_ALT_OUT,				// Aux output stop, run from the MsTimer2 interrupt
+	PROF_LOOP,					// One pass of the task scheduler
+	PROF_SITE_COUNT
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Run time profiling
+  ========================================
+
+  Each site in OM_Profile.h calls profRecord() with how long it took, as
+  timed by a hardware timer: the step ISR reads Timer1's count, which is
+  the time since its own interrupt fired, the others take micros() (Timer0)
+  on entry and exit. Recording is a handful of adds and a short shift loop,
+  so it is left on all the time, in the ISRs too.
+
+  Per site we keep the run count, the shortest, longest and mean run, and a
+  log-scale histogram of run times, so a step rate or program can be
+  checked against its CPU budget in the field. Histogram counts stop at
+  65535.
+
+*/
+
+// Stat selectors for general command 203
+const byte PROF_STAT_COUNT		= 0;
+const byte PROF_STAT_MIN_US		= 1;
+const byte PROF_STAT_MAX_US		= 2;
+const byte PROF_STAT_MEAN_US	= 3;
+
+struct prof_site {
+	unsigned long	count;					// Runs recorded
+	unsigned int	min_us;					// Shortest run
+	unsigned int	max_us;					// Longest run
+	uint64_t		total_us;				// Total run time, for the mean
+	unsigned int	hist[PROF_BUCKETS];		// Runs per log2 time bucket
+};
+
+prof_site prof_sites[PROF_SITE_COUNT];
+
+
+/** Record Run Time
+
+ Adds one run of p_us microseconds to a site's statistics. Safe to call
+ from an ISR.
+ */
+
+void profRecord(byte p_site, unsigned int p_us) {
+
+	prof_site& site = prof_sites[p_site];
+
+	if (site.count == 0 || p_us < site.min_us)
+		site.min_us = p_us;
+	if (p_us > site.max_us)
+		site.max_us = p_us;
+
+	site.count++;
+	site.total_us += p_us;
+
+	byte bucket = 0;
+	while ((p_us >>= 1) && bucket < PROF_BUCKETS - 1)
+		bucket++;
+
+	if (site.hist[bucket] < 65535)
+		site.hist[bucket]++;
+}
+
+
+/** Record Run Since
+
+ Records a run that started at p_start, a micros() value.
+ */
+
+void profRecordSince(byte p_site, unsigned long p_start) {
+
+	unsigned long took = micros() - p_start;
+	profRecord(p_site, took > 65535 ? 65535 : took);
+}
+
+
+/** Profile Stat
+
+ Returns one statistic (PROF_STAT_x) for the given site.
+ */
+
+unsigned long profStat(byte p_site, byte p_stat) {
+
+	// The ISR sites can record while we read
+	noInterrupts();
+	prof_site site = prof_sites[p_site];
+	interrupts();
+
+	switch (p_stat) {
+		case PROF_STAT_COUNT:
+			return site.count;
+		case PROF_STAT_MIN_US:
+			return site.min_us;
+		case PROF_STAT_MAX_US:
+			return site.max_us;
+		case PROF_STAT_MEAN_US:
+			return site.count ? (unsigned long)(site.total_us / site.count) : 0;
+		default:
+			return 0;
+	}
+}
+
+
+/** Profile Histogram
+
+ Returns the run count in one histogram bucket of the given site.
+ */
+
+unsigned int profBucket(byte p_site, byte p_bucket) {
+
+	noInterrupts();
+	unsigned int count = prof_sites[p_site].hist[p_bucket];
+	interrupts();
+
+	return count;
+}
+
+
+/** Clear Profile
+
+ Resets the statistics of every site.
+ */
+
+void profClear() {
+
+	noInterrupts();
+	memset(prof_sites, 0, sizeof(prof_sites));
+	interrupts();
+}
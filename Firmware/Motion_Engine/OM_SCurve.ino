@@ -0,0 +1,284 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  S-curve moves
+  ========================================
+
+  Motors with the S-curve easing mode (motor command 18, value 4) make their
+  send moves, including key frame SMS moves, along a minimum-jerk profile:
+
+	s(u) = 10u^3 - 15u^4 + 6u^5		u = t / T, 0.0 - 1.0
+
+  Its acceleration is zero at both ends, so the move starts and finishes
+  without the jolt of a trapezoid's acceleration step, and a light rig has
+  little left to ring out once the motor stops.
+
+  The motor library only plans trapezoids, so the profile is followed in
+  continuous mode instead: every pass scurveUpdate() reads s(u) and its
+  velocity from two normalized PROGMEM tables, interpolating between entries
+  in fixed point, and sets the motor speed to the table velocity plus a
+  correction for any position error. Once T is up the last few steps, if
+  any, are made with an ordinary move to the target. The time from the end
+  of the profile until that move finishes is kept per motor as the settle
+  time (motor command 125), along with the steps it had to make (motor
+  command 126).
+
+  The move time T is the shortest that keeps the peak speed (1.875 times
+  the mean) and peak acceleration (5.77 * distance / T^2) inside the
+  motor's limits.
+
+*/
+
+const byte SCURVE_SEGMENTS		= 32;			// Table intervals over u
+const byte SCURVE_SEG_SHIFT		= 11;			// log2(65536 / SCURVE_SEGMENTS)
+const float SCURVE_PEAK_VEL		= 1.875;		// Peak velocity, in distance / T
+const float SCURVE_PEAK_ACCEL	= 5.7735;		// Peak acceleration, in distance / T^2
+const float SCURVE_GAIN			= 20.0;			// Position correction, steps/sec per step of error
+const float SCURVE_MIN_SPEED	= 1.0;			// Slowest speed while following, keeps the motor running (steps/sec)
+const float SCURVE_TRIM_SPEED	= 200.0;		// Speed for the steps left at the end (steps/sec)
+const unsigned long SCURVE_MAX_MS = 65535;		// Longest profile, longer moves are made as ordinary sends
+
+// s(u) * 65535, at u = 0, 1/32 ... 1
+const unsigned int scurve_pos[SCURVE_SEGMENTS + 1] PROGMEM = {
+	0, 19, 145, 467, 1052, 1951, 3196, 4806, 6784, 9121, 11797,
+	14781, 18036, 21515, 25167, 28938, 32768, 36597, 40368, 44020, 47499,
+	50754, 53738, 56414, 58751, 60729, 62339, 63584, 64483, 65068, 65390,
+	65516, 65535
+};
+
+// s'(u) / SCURVE_PEAK_VEL * 65535, at u = 0, 1/32 ... 1
+const unsigned int scurve_vel[SCURVE_SEGMENTS + 1] PROGMEM = {
+	0, 961, 3600, 7569, 12544, 18225, 24336, 30625, 36863, 42848, 48399,
+	53360, 57599, 61008, 63503, 65024, 65535, 65024, 63503, 61008, 57599,
+	53360, 48399, 42848, 36863, 30625, 24336, 18225, 12544, 7569, 3600,
+	961, 0
+};
+
+byte scurve_easing = 0;						// Motors using the S-curve easing mode
+byte scurve_active = 0;						// Motors following a profile
+unsigned long scurve_start[MOTOR_COUNT];	// millis() at the start of the move
+unsigned int scurve_len[MOTOR_COUNT];		// Move time T (ms)
+long scurve_from[MOTOR_COUNT];				// Start position
+long scurve_dist[MOTOR_COUNT];				// Signed distance to the target
+float scurve_peak[MOTOR_COUNT];				// Peak speed (steps/sec)
+long scurve_landing[MOTOR_COUNT];			// Steps left to make after the last move's profile
+byte scurve_settling = 0;					// Motors making the steps left after their profile
+unsigned long scurve_end[MOTOR_COUNT];		// millis() when the profile ended
+unsigned long scurve_settle[MOTOR_COUNT];	// Time (ms) from the end of the last profile until the motor stopped
+
+
+/** S-curve Easing
+
+ Sets whether a motor uses the S-curve easing mode, or returns whether it
+ does. The library's own easing is left as it was, for the moves it plans.
+ */
+
+void scurveEasing(byte p_motor, bool p_setting) {
+
+	if (p_setting)
+		scurve_easing |= (1 << p_motor);
+	else
+		scurve_easing &= ~(1 << p_motor);
+}
+
+bool scurveEasing(byte p_motor) {
+	return scurve_easing & (1 << p_motor);
+}
+
+
+/** S-curve Move Time
+
+ Returns the shortest time in seconds for an S-curve move of p_steps from
+ rest to rest, peaking no faster than p_speed (steps/sec) and accelerating
+ no harder than p_accel (steps/sec^2). An accel of 0 is no limit.
+ */
+
+float scurveTime(float p_steps, float p_speed, float p_accel) {
+
+	if (p_steps <= 0 || p_speed <= 0)
+		return 0;
+
+	float time = SCURVE_PEAK_VEL * p_steps / p_speed;
+
+	if (p_accel > 0)
+		time = max(time, (float)sqrt(SCURVE_PEAK_ACCEL * p_steps / p_accel));
+
+	return time;
+}
+
+
+/** Start S-curve Move
+
+ Starts the motor following an S-curve to p_pos over p_time seconds.
+ Returns false, without moving, if the move is too long for a profile.
+ */
+
+bool scurveStart(byte p_motor, long p_pos, float p_time) {
+
+	unsigned long len = (unsigned long)(p_time * MILLIS_PER_SECOND + 0.5);
+
+	if (len > SCURVE_MAX_MS)
+		return false;
+
+	long from = motor[p_motor].currentPos();
+	long dist = p_pos - from;
+
+	scurve_landing[p_motor] = 0;
+	scurve_settle[p_motor] = 0;
+	scurve_settling &= ~(1 << p_motor);
+
+	if (dist == 0)
+		return true;
+
+	if (len == 0)
+		len = 1;
+
+	scurve_start[p_motor] = millis();
+	scurve_len[p_motor] = len;
+	scurve_from[p_motor] = from;
+	scurve_dist[p_motor] = dist;
+	scurve_peak[p_motor] = SCURVE_PEAK_VEL * abs(dist) * MILLIS_PER_SECOND / len;
+	scurve_active |= (1 << p_motor);
+
+	// Set off creeping in the right direction, scurveUpdate() takes it from there
+	stepMoveCancel(p_motor);
+	motor[p_motor].contSpeed(dist > 0 ? SCURVE_MIN_SPEED : -SCURVE_MIN_SPEED);
+	motor[p_motor].continuous(true);
+	motor[p_motor].move(dist > 0 ? 1 : 0, 0);
+	startISR();
+
+	return true;
+}
+
+
+ // Reads a normalized table at u (0 - 65535), interpolating between entries
+unsigned int scurveLookup(const unsigned int* p_table, unsigned int p_u) {
+
+	byte seg = p_u >> SCURVE_SEG_SHIFT;
+	unsigned int frac = p_u & ((1 << SCURVE_SEG_SHIFT) - 1);
+
+	long a = pgm_read_word(&p_table[seg]);
+	long b = pgm_read_word(&p_table[seg + 1]);
+
+	return a + (((b - a) * frac) >> SCURVE_SEG_SHIFT);
+}
+
+
+/** Update S-curve Moves
+
+ Sets the speed of every motor following a profile. Called every pass.
+ */
+
+void scurveUpdate() {
+
+	if (!scurve_active && !scurve_settling)
+		return;
+
+	unsigned long now = millis();
+
+	// Note when the moves that finish each profile are done
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if ((scurve_settling & (1 << i)) && !motor[i].running()) {
+			scurve_settle[i] = now - scurve_end[i];
+			scurve_settling &= ~(1 << i);
+		}
+	}
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+		if (!(scurve_active & (1 << i)))
+			continue;
+
+		unsigned long elapsed = now - scurve_start[i];
+		long target = scurve_from[i] + scurve_dist[i];
+
+		// Profile done, make whatever steps are left at a crawl
+		if (elapsed >= scurve_len[i]) {
+			scurve_active &= ~(1 << i);
+			scurve_landing[i] = target - motor[i].currentPos();
+			scurve_end[i] = now;
+			scurve_settling |= (1 << i);
+
+			motor[i].stop();
+			motor[i].continuous(false);
+			motor[i].contSpeed(min(SCURVE_TRIM_SPEED, smsTopSpeed(i)));
+			stepMoveTo(i, target);
+			startISR();
+			continue;
+		}
+
+		unsigned int u = (elapsed << 16) / scurve_len[i];
+
+		long want = scurve_from[i] + (long)(((int64_t)scurve_dist[i] * scurveLookup(scurve_pos, u)) >> 16);
+		float speed = scurve_peak[i] * scurveLookup(scurve_vel, u) / 65535.0;
+
+		// Steer toward the profile position, without ever turning back
+		if (scurve_dist[i] > 0)
+			speed += SCURVE_GAIN * (want - motor[i].currentPos());
+		else
+			speed += SCURVE_GAIN * (motor[i].currentPos() - want);
+
+		speed = constrain(speed, SCURVE_MIN_SPEED, smsTopSpeed(i));
+
+		motor[i].contSpeed(scurve_dist[i] > 0 ? speed : -speed);
+	}
+}
+
+
+/** Cancel S-curve Moves
+
+ Drops every profile being followed. Called when the motors are stopped.
+ */
+
+void scurveCancel() {
+	scurve_active = 0;
+	scurve_settling = 0;
+}
+
+
+/** S-curve Settle Time
+
+ Returns the time in milliseconds from the end of the motor's last S-curve
+ profile until it stopped at the target.
+ */
+
+unsigned long scurveSettle(byte p_motor) {
+	return scurve_settle[p_motor];
+}
+
+
+/** S-curve Landing Error
+
+ Returns the steps the motor's last S-curve move still had to make when
+ its profile ended.
+ */
+
+long scurveLanding(byte p_motor) {
+	return scurve_landing[p_motor];
+}
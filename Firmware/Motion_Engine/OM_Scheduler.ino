@@ -0,0 +1,273 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Cooperative task scheduler
+  ========================================
+
+  loop() just calls schedRun(), which walks the task table below and runs
+  every task whose period has elapsed. A period of 0 runs the task on every
+  pass. Tasks must never block; anything that needs to wait keeps its own
+  state and returns.
+
+  Each task also has a deadline: the longest gap (ms) between two runs
+  before it counts as late. Run counts, run time and late counts are kept
+  per task and can be read with general command 201.
+
+*/
+
+// Task IDs, in the order they appear in sched_tasks[]
+const byte TASK_SERIAL		= 0;
+const byte TASK_ESTOP		= 1;
+const byte TASK_WATCHDOG	= 2;
+const byte TASK_SPLINE		= 3;
+const byte TASK_PROGRAM		= 4;
+const byte TASK_MOTION		= 5;
+const byte TASK_TELEMETRY	= 6;
+const byte TASK_SENSORS		= 7;
+const byte TASK_LOG			= 8;
+const byte TASK_STEPS		= 9;
+const byte TASK_COUNT		= 10;
+
+// Stat selectors for general command 201
+const byte SCHED_STAT_PERIOD	= 0;
+const byte SCHED_STAT_RUNS		= 1;
+const byte SCHED_STAT_AVG_US	= 2;
+const byte SCHED_STAT_MAX_US	= 3;
+const byte SCHED_STAT_LATE		= 4;
+const byte SCHED_STAT_TOTAL_US	= 5;
+
+struct sched_task {
+	void			(*fn)();		// Task function
+	unsigned int	period;			// Minimum time between runs (ms), 0 runs every pass
+	unsigned int	deadline;		// Maximum time between runs (ms) before the run is counted as late
+	unsigned long	last_run;		// millis() at the last run
+	unsigned long	runs;			// Number of runs
+	unsigned long	total_us;		// Total time spent in the task
+	unsigned long	max_us;			// Longest single run
+	unsigned long	late;			// Runs that started after the deadline
+};
+
+sched_task sched_tasks[TASK_COUNT] = {
+	{ taskSerial,	0,		5,		0, 0, 0, 0, 0 },
+	{ taskEStop,	100,	150,	0, 0, 0, 0, 0 },
+	{ taskWatchdog,	10,		50,		0, 0, 0, 0, 0 },
+	{ taskSpline,	0,		5,		0, 0, 0, 0, 0 },
+	{ taskProgram,	0,		10,		0, 0, 0, 0, 0 },
+	{ taskMotion,	0,		10,		0, 0, 0, 0, 0 },
+	{ taskTelemetry,10,		50,		0, 0, 0, 0, 0 },
+	{ taskSensors,	5,		50,		0, 0, 0, 0, 0 },
+	{ taskLog,		10,		50,		0, 0, 0, 0, 0 },
+	{ taskSteps,	0,		10,		0, 0, 0, 0, 0 },
+};
+
+
+/** Run Scheduler
+
+ Runs one pass over the task table. Called from loop().
+ */
+
+void schedRun() {
+
+	unsigned long pass_start = micros();
+
+	for (byte i = 0; i < TASK_COUNT; i++) {
+
+		sched_task& task = sched_tasks[i];
+		unsigned long now = millis();
+		unsigned long since = now - task.last_run;
+
+		if (task.period > 0 && since < task.period)
+			continue;
+
+		if (task.runs > 0 && since > task.deadline)
+			task.late++;
+
+		task.last_run = now;
+
+		unsigned long start = micros();
+		task.fn();
+		unsigned long took = micros() - start;
+
+		task.runs++;
+		task.total_us += took;
+		if (took > task.max_us)
+			task.max_us = took;
+	}
+
+	profRecordSince(PROF_LOOP, pass_start);
+}
+
+
+/** Task Stat
+
+ Returns one statistic (SCHED_STAT_x) for the given task.
+ */
+
+unsigned long schedStat(byte p_task, byte p_stat) {
+
+	sched_task& task = sched_tasks[p_task];
+
+	switch (p_stat) {
+		case SCHED_STAT_PERIOD:
+			return task.period;
+		case SCHED_STAT_RUNS:
+			return task.runs;
+		case SCHED_STAT_AVG_US:
+			return task.runs ? task.total_us / task.runs : 0;
+		case SCHED_STAT_MAX_US:
+			return task.max_us;
+		case SCHED_STAT_LATE:
+			return task.late;
+		case SCHED_STAT_TOTAL_US:
+			return task.total_us;
+		default:
+			return 0;
+	}
+}
+
+
+/** Clear Task Stats
+
+ Resets the run statistics of every task.
+ */
+
+void schedClearStats() {
+
+	for (byte i = 0; i < TASK_COUNT; i++) {
+		sched_tasks[i].runs = 0;
+		sched_tasks[i].total_us = 0;
+		sched_tasks[i].max_us = 0;
+		sched_tasks[i].late = 0;
+	}
+}
+
+
+/*
+
+  ========================================
+  Tasks
+  ========================================
+
+*/
+
+ // check to see if we have any commands waiting
+void taskSerial() {
+	// Note when this pass started, for clock sync broadcasts
+	syncMarkRx();
+
+	Node.check();
+	NodeBlue.check();
+	NodeUSB.check();
+}
+
+
+ // If the eStop button has been held more than 3 sec, switch to DF mode
+void taskEStop() {
+
+	static unsigned long estop_time = 0; // Remembers last time eStop was NOT pressed
+
+	if (digitalRead(ESTOP_PIN) == HIGH)
+		estop_time = millis();
+	else if (!df_mode && millis() - estop_time > 3000) {
+		ledChase(2);
+		debug.funct("Entering DF mode");
+		// Change motors to 8th stepping before starting DF mode
+		for (byte i = 0; i < MOTOR_COUNT; i++){
+			motor[i].ms(8);
+		}
+		df_mode = true;
+	}
+
+	// DF mode takes over the controller and never returns
+	if (df_mode) {
+		df_setup();
+		df_loop();
+	}
+}
+
+
+ //Stop the motors if they're running, watchdog is active, and time since last received command has exceeded timeout
+void taskWatchdog() {
+
+	if (watchdog_active && (millis() - commandTime > WATCHDOG_MAX_TIME)){
+		for (byte i = 0; i < MOTOR_COUNT; i++){
+			if (motor[i].running()){
+				stopAllMotors();
+				break;
+			}
+		}
+	}
+}
+
+
+ // Update motor splines
+void taskSpline() {
+
+	// Steer any motors following an S-curve
+	scurveUpdate();
+
+	for (byte i = 0; i < MOTOR_COUNT; i++){
+		if (motor[i].running())
+			motor[i].updateSpline();
+	}
+}
+
+
+ // Update whichever program type is running
+void taskProgram() {
+
+	// Advance a program start that's waiting on backlash or the video camera
+	startUpdate();
+
+	// If a classic-style program is running
+	if (running)
+		updateLegacyProgram();
+	// If a key frame program is running
+	else if (kf_running)
+		kf_updateProgram();
+}
+
+
+ // Housekeeping after motion stops
+void taskMotion() {
+
+	// Finish up after the step ISR has gone idle
+	motionDoneCheck();
+
+	// Commit any stopped positions to the EEPROM journal
+	journalUpdate();
+
+	// Check if any motors are being sent and restore their old microstep settings when they stop
+	for (byte i = 0; i < MOTOR_COUNT; i++){
+		if (motor[i].isSending() && !motor[i].running()){
+			motor[i].setSending(false);
+			motor[i].restoreLastMs();
+		}
+	}
+}
@@ -0,0 +1,276 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Supply sensing and motor attach detection
+  ========================================
+
+  The supply voltage and current are sampled in the background by a
+  scheduler task, alternating between VOLTAGE_PIN and CURRENT_PIN, and
+  smoothed with an exponential average kept in fixed point (ADC counts
+  << SENSE_SHIFT). Queries read the cached values instead of doing a
+  conversion of their own.
+
+  Motor attach detection wakes one driver at a time, waits for its
+  current draw to settle and reads CURRENT_PIN. That used to be done
+  with delay() and stalled the controller for over 300 ms; now it is a
+  state machine stepped by the same task, and general command 124
+  returns the last result.
+
+*/
+
+const byte SENSE_SHIFT			= 4;		// Fractional bits of the filtered ADC values
+const byte SENSE_FILTER			= 2;		// Filter weight, each sample moves the average 1/2^SENSE_FILTER of the way
+const unsigned int ATTACH_SETTLE	= 100;	// Time (ms) for a woken driver's current draw to settle
+const int ATTACH_THRESHOLD		= 30;		// ADC counts above which a motor is attached (0.15A at 5A / 1023 counts)
+const uint8_t ATTACH_ERROR		= B1000;	// Attach result when no check could be run
+
+unsigned int sense_voltage	= 0;			// Filtered VOLTAGE_PIN reading, ADC counts << SENSE_SHIFT
+unsigned int sense_current	= 0;			// Filtered CURRENT_PIN reading, ADC counts << SENSE_SHIFT
+boolean sense_primed		= false;		// The filters have been seeded with a first reading
+boolean sense_which			= false;		// Pin for the next sample, false = voltage
+
+uint8_t attach_result		= ATTACH_ERROR;	// Bits of the last completed attach check
+boolean attach_busy			= false;		// An attach check is in progress
+byte attach_motor			= 0;			// Motor currently being checked
+unsigned long attach_time	= 0;			// millis() when the current motor was woken
+bool attach_sleep[MOTOR_COUNT];				// Sleep states to restore after the check
+uint8_t attach_bits			= 0;			// Bits found so far in the current check
+
+
+ // Moves a filtered value toward a new reading
+unsigned int senseFilter(unsigned int p_filt, int p_raw) {
+
+	int diff = ((unsigned int)p_raw << SENSE_SHIFT) - p_filt;
+	return p_filt + (diff >> SENSE_FILTER);
+}
+
+
+/** Sensor Task
+
+ Called from the scheduler. Takes one ADC reading, alternating between
+ the supply voltage and current, and steps any attach check in progress.
+ */
+
+void taskSensors() {
+
+	// While an attach check is running CURRENT_PIN belongs to it
+	if (attach_busy) {
+		attachUpdate();
+		return;
+	}
+
+	if (!sense_primed) {
+		sense_voltage = (unsigned int)analogRead(VOLTAGE_PIN) << SENSE_SHIFT;
+		sense_current = (unsigned int)analogRead(CURRENT_PIN) << SENSE_SHIFT;
+		sense_primed = true;
+		return;
+	}
+
+	if (sense_which)
+		sense_current = senseFilter(sense_current, analogRead(CURRENT_PIN));
+	else
+		sense_voltage = senseFilter(sense_voltage, analogRead(VOLTAGE_PIN));
+
+	sense_which = !sense_which;
+}
+
+
+/** Supply Voltage
+
+ Returns the filtered supply voltage, multiplied by FLOAT_TO_FIXED.
+ */
+
+unsigned long supplyVoltage() {
+	// 25V full scale
+	return ((unsigned long)sense_voltage * 25 * FLOAT_TO_FIXED + (1023UL << (SENSE_SHIFT - 1))) / (1023UL << SENSE_SHIFT);
+}
+
+
+/** Supply Current
+
+ Returns the filtered motor supply current, multiplied by FLOAT_TO_FIXED.
+ */
+
+unsigned long supplyCurrent() {
+	// 5A full scale
+	return ((unsigned long)sense_current * 5 * FLOAT_TO_FIXED + (1023UL << (SENSE_SHIFT - 1))) / (1023UL << SENSE_SHIFT);
+}
+
+
+ // True while anything is moving or about to, which an attach check can't overlap
+boolean attachBlocked() {
+
+	if (running || kf_running || startPending())
+		return true;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (motor[i].running())
+			return true;
+	}
+
+	return false;
+}
+
+
+/** Start Attach Check
+
+ Starts a background motor attach check, unless one is already running
+ or a motor, program, key frame program or program start is running.
+ Returns true if a check is in progress.
+ */
+
+boolean attachStart() {
+
+	if (attach_busy)
+		return true;
+
+	// The check sleeps and wakes the drivers, so it can't run during a move,
+	// a key frame program or a program start
+	if (attachBlocked())
+		return false;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		// Save the current sleep state of all the motors so they can be restored when done with the attach check
+		attach_sleep[i] = motor[i].sleep();
+		// Put them into sleep mode in case it isn't already
+		motor[i].sleep(true);
+	}
+
+	attach_bits = 0;
+	attach_motor = 0;
+	attach_busy = true;
+	motor[0].sleep(false);
+	attach_time = millis();
+
+	return true;
+}
+
+
+ // Ends an attach check, restoring the saved sleep states
+void attachFinish(uint8_t p_result) {
+
+	for (byte i = 0; i < MOTOR_COUNT; i++)
+		motor[i].sleep(attach_sleep[i]);
+
+	attach_result = p_result;
+	attach_busy = false;
+}
+
+
+/** Abort Attach Check
+
+ Cancels an attach check in progress, restoring the drivers' sleep states
+ and keeping the previous result. Called before motion starts, so a motor
+ never starts moving while the check has its driver asleep.
+ */
+
+void attachAbort() {
+
+	if (attach_busy)
+		attachFinish(attach_result);
+}
+
+
+/** Step Attach Check
+
+ Reads the current of the woken motor once it has settled, then moves on
+ to the next one.
+ */
+
+void attachUpdate() {
+
+	if (!attach_busy)
+		return;
+
+	// Give up if something started moving in the meantime
+	if (attachBlocked()) {
+		attachFinish(ATTACH_ERROR);
+		return;
+	}
+
+	if (millis() - attach_time < ATTACH_SETTLE)
+		return;
+
+	// Read the analog value from current sensing pin
+	int current = analogRead(CURRENT_PIN);
+
+	// If the draw is greater than the threshold, then a motor is connected to the enabled channel
+	if (current > ATTACH_THRESHOLD)
+		attach_bits |= (1 << attach_motor);
+
+	debug.funct("Motor ");
+	debug.funct(attach_motor);
+	debug.funct(" current draw: ");
+	debug.functln(current);
+
+	// Put the motor back to sleep so it doesn't interfere with reading of the next motor
+	motor[attach_motor].sleep(true);
+
+	attach_motor++;
+
+	if (attach_motor >= MOTOR_COUNT) {
+		attachFinish(attach_bits);
+		return;
+	}
+
+	motor[attach_motor].sleep(false);
+	attach_time = millis();
+}
+
+
+/** Check Motor Attach
+
+ Returns the result of the last attach check: a bit per attached motor,
+ or B1000 if no check has completed. Also starts a new check in the
+ background when possible, so the next call sees fresh results.
+ */
+
+uint8_t checkMotorAttach() {
+
+	attachStart();
+	return attach_result;
+}
+
+
+/** Check Motor Attach And Wait
+
+ Runs a complete attach check before returning its result. This blocks
+ for over 300 ms, so it is only for the self diagnostic.
+ */
+
+uint8_t checkMotorAttachWait() {
+
+	if (!attachStart())
+		return ATTACH_ERROR;
+
+	while (attach_busy)
+		attachUpdate();
+
+	return attach_result;
+}
@@ -117,6 +117,84 @@ char* getMsgFromFlash(const char* message) {
 }
 
 
+/*
+
+  Joystick command whitelist
+
+  The set commands that are still accepted while joystick mode is on, kept
+  in flash. Entries must stay sorted by group, then command, as
+  joystickAllowed() does a binary search.
+
+  Groups are the same as the subaddress, except all three motors share
+  group 1.
+
+*/
+
+struct joystick_cmd {
+	byte group;
+	byte command;
+};
+
+const joystick_cmd joystick_cmds[] PROGMEM = {
+	// General
+	{ GEN,	14 },		// Joystick watchdog
+	{ GEN,	23 },		// Joystick mode
+	{ GEN,	50 },		// Graffik mode
+	{ GEN,	51 },		// App mode
+
+	// Motor
+	{ 1,	3 },		// Enable
+	{ 1,	4 },		// Stop now
+	{ 1,	6 },		// Microsteps
+	{ 1,	13 },		// Continuous speed
+};
+
+const byte JOYSTICK_CMD_COUNT = sizeof(joystick_cmds) / sizeof(joystick_cmd);
+
+
+/** Joystick Command Allowed
+
+ Returns true if a command is listed in joystick_cmds.
+ */
+
+boolean joystickAllowed(byte p_group, byte p_command) {
+
+	unsigned int key = ((unsigned int)p_group << 8) | p_command;
+	int lo = 0;
+	int hi = JOYSTICK_CMD_COUNT - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) >> 1;
+		unsigned int mid_key = ((unsigned int)pgm_read_byte(&joystick_cmds[mid].group) << 8) | pgm_read_byte(&joystick_cmds[mid].command);
+
+		if (mid_key == key)
+			return true;
+		else if (mid_key < key)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return false;
+}
+
+
+/** Joystick Blocked
+
+ Returns true if a command must be refused because joystick mode is on.
+ Queries are always allowed, as is everything in Graffik mode. The table
+ is only searched while joystick mode is on.
+ */
+
+boolean joystickBlocked(byte p_group, byte p_command) {
+
+	if (graffikMode() || !joystick_mode || p_command >= 100)
+		return false;
+
+	return !joystickAllowed(p_group, p_command);
+}
+
+
 void printInputBuffer(byte subaddr, byte command, byte* buf){
 	debug.com(getMsg(SUBADDR));
 	debug.com(subaddr);
@@ -231,16 +309,10 @@ void serCommandHandler(byte subaddr, byte command, byte* buf) {
  switch(subaddr) {   
    case 0:
 
-	   // Check for joystick mode and return on non-valid commands if true, but not when in Graffik mode
-	   if (!graffikMode()){
-		   // If this is not a query command
-		   if (joystick_mode == true && command < 100){
-			   // Disallow any motor commands that aren't joystick related during joystick mode
-			   if (!(command == 14 || command == 23 || command == 50 || command == 51)){
-				   response(false);
-				   return;
-			   }
-		   }
+	   // Disallow any commands that aren't joystick related during joystick mode
+	   if (joystickBlocked(GEN, command)){
+		   response(false);
+		   return;
 	   }
 
          // program control
@@ -250,16 +322,10 @@ void serCommandHandler(byte subaddr, byte command, byte* buf) {
    case 2:
    case 3:
 
-	   // Check for joystick mode and return on non-valid commands if true
-	   if (!graffikMode()){
-		   // If this is not a query command
-		   if (joystick_mode == true && command < 100){
-			   // Disallow any motor commands that aren't joystick related during joystick mode
-			   if (!(command == 3 || command == 4 || command == 6 || command ==13)){
-				   response(false);
-				   return;
-			   }
-		   }
+	   // Disallow any motor commands that aren't joystick related during joystick mode
+	   if (joystickBlocked(1, command)){
+		   response(false);
+		   return;
 	   }
 
          //serial motor commands
@@ -336,6 +402,10 @@ void serBroadcastHandler(byte subaddr, byte command, byte* buf) {
 		response(true, Node.address());
 		break;
 
+	case BCAST_CLOCK_SYNC:
+		syncSample(Node.ntoul(buf));
+		break;
+
     default:
       break;
   }
@@ -343,6 +413,119 @@ void serBroadcastHandler(byte subaddr, byte command, byte* buf) {
 }
 
 
+/*=========================================
+              Batch Commands
+=========================================== */
+
+/*
+
+  A batch packet (general command 60) carries several commands:
+
+	Byte0   = Number of commands (1-32)
+	Byte1   = Total length of the command tuples that follow
+	Byte2-x = Tuples of: subaddress, command, data length, <data length bytes>
+
+  Every tuple is checked before any of them run, so a malformed packet
+  changes nothing. The length can't exceed what fits in a packet, and every
+  tuple's data has to end inside it.
+
+  A well-formed batch is not all-or-nothing: the commands run in order and
+  none is undone, so if one fails, the ones before it stay applied and the
+  ones after it still run. The reply's status bits say which succeeded.
+
+  Batches can't be nested. While a batch runs, response() only records each
+  command's success bit instead of sending it, so any values returned by
+  queries inside a batch are dropped.
+
+*/
+
+const byte BATCH_MAX_CMDS	= 32;
+const byte BATCH_MAX_LEN	= OM_SER_BUFLEN - 2;	// Tuple bytes that fit in a packet after the count and length
+const byte BATCH_CMD		= 60;
+
+boolean batch_active = false;		// A batch is running, responses are captured
+unsigned long batch_status = 0;		// Success bits of the commands run so far
+byte batch_index = 0;				// Index of the command currently running
+
+
+/** Capture Batch Response
+
+ Called at the top of every response() overload. While a batch is running,
+ records the status of the current command and returns true so the
+ response isn't sent.
+ */
+
+boolean batchCapture(uint8_t p_stat) {
+
+	if (!batch_active)
+		return false;
+
+	if (p_stat)
+		batch_status |= (1UL << batch_index);
+
+	return true;
+}
+
+
+/** Run Batch
+
+ Validates and runs every command in a batch packet. p_status is set to
+ the success bits of the commands. Returns false, running nothing, if the
+ packet is malformed, and false with the bits of the commands that did
+ succeed if any command failed.
+ */
+
+boolean batchRun(byte* p_buf, unsigned long& p_status) {
+
+	byte count = p_buf[0];
+	byte len = p_buf[1];
+	byte* tuples = p_buf + 2;
+
+	p_status = 0;
+
+	if (count == 0 || count > BATCH_MAX_CMDS || len > BATCH_MAX_LEN)
+		return false;
+
+	// Check the whole packet first
+	unsigned int pos = 0;
+	for (byte i = 0; i < count; i++){
+		if (pos + 3 > len)
+			return false;
+
+		byte subaddr = tuples[pos];
+		byte command = tuples[pos + 1];
+		byte datalen = tuples[pos + 2];
+
+		if (pos + 3 + datalen > len)
+			return false;
+
+		if (subaddr > KF || (subaddr == GEN && command == BATCH_CMD))
+			return false;
+
+		pos += 3 + datalen;
+	}
+
+	if (pos != len)
+		return false;
+
+	// Run each command, capturing its response
+	batch_active = true;
+	batch_status = 0;
+	pos = 0;
+
+	for (batch_index = 0; batch_index < count; batch_index++){
+		serCommandHandler(tuples[pos], tuples[pos + 1], tuples + pos + 3);
+		pos += 3 + tuples[pos + 2];
+	}
+
+	batch_active = false;
+	p_status = batch_status;
+
+	unsigned long all = (count == BATCH_MAX_CMDS) ? 0xFFFFFFFFUL : ((1UL << count) - 1);
+	return p_status == all;
+}
+
+
 /*=========================================
               Main Functions
 =========================================== */
@@ -471,7 +654,7 @@ void serMain(byte command, byte* input_serial_buffer) {
 		for (byte i = 0; i < MOTOR_COUNT; i++){
             motor[i].contSpeed(motor[i].maxSpeed());
 			motor[i].ms(4);			
-			motor[i].home();
+			stepMoveTo(i, 0);
 			motor[i].setSending(true);
 		}
 		startISR();
@@ -579,6 +762,7 @@ void serMain(byte command, byte* input_serial_buffer) {
 	case 21:
 	{		   
 		start_delay = Node.ntoul(input_serial_buffer);
+		programGeometryDirty();
 		msg = "Setting start delay: ";
 		debugMessage(GEN, command, MSG, start_delay);
 		response(true);
@@ -589,6 +773,7 @@ void serMain(byte command, byte* input_serial_buffer) {
 	case 22:
 	{
 		Motors::planType(input_serial_buffer[0]);
+		programGeometryDirty();
 		msg = "Setting program mode: ";
 		debugMessage(GEN, command, MSG, Motors::planType());
 		// For modes other than SMS, max shots should be set to 0 (unlimited), since program stopping will be controlled by run time
@@ -599,9 +784,8 @@ void serMain(byte command, byte* input_serial_buffer) {
 	}
 
 	//Command 23 set joystick mode
-	// This will cause the controller to ignore all commands except general commands 23 (set joystick mode) and 120 (query joystick mode),
-	// and motor commands 3 (enable motor), 4 (stop now), 6 (set microsteps), 13 (set continuous speed), 15 (execute simple move), and 
-	// This is to avoid incorrect commands due to corrupt communications causing runaway motors or controller lockup.
+	// This will cause the controller to ignore all general and motor set commands except those listed in joystick_cmds.
+	// Queries are still answered. This is to avoid incorrect commands due to corrupt communications causing runaway motors or controller lockup.
 	case 23:
 	{
 		byte mode = input_serial_buffer[0];			   
@@ -730,6 +914,40 @@ void serMain(byte command, byte* input_serial_buffer) {
 		break;
 	}
 
+	//Command 34 subscribes the sending node to status telemetry frames every n milliseconds, 0 unsubscribes.
+	// USB and Bluetooth only, fails on MoCoBus, where the master polls with command 135 instead.
+	case 34:
+	{
+		unsigned int requested = Node.ntoui(input_serial_buffer);
+		unsigned int period = telemetryPeriod(requested);
+		msg = "Setting telemetry period: ";
+		debugMessage(GEN, command, MSG, period);
+		response(period > 0 || requested == 0, period);
+		break;
+	}
+
+	//Command 35 drops the clock shared with the other nodes, falling back to the local clock until the next
+	// sync broadcast. Fails while a program is running.
+	case 35:
+	{
+		boolean ok = syncReset();
+		msg = "Resetting clock sync: ";
+		debugMessage(GEN, command, MSG, ok);
+		response(ok);
+		break;
+	}
+
+	//Command 36 turns coordinated multi-axis moves on or off. When on, SMS moves bring every motor to its
+	// next position at the same moment.
+	case 36:
+	{
+		coordinatedMoves(input_serial_buffer[0]);
+		msg = "Setting coordinated moves: ";
+		debugMessage(GEN, command, MSG, coordinatedMoves());
+		response(true);
+		break;
+	}
+
 	//Command 50 sets Graffik Mode on or off
 	case 50:
 	{
@@ -751,6 +969,23 @@ void serMain(byte command, byte* input_serial_buffer) {
 		break;
 	}
 
+	//Command 60 runs a batch of commands from a single packet, see batchRun() for the format.
+	// Responds with a bit per command (bit 0 = first command) that is set if that command succeeded.
+	// Commands that succeeded before a failing one stay applied, nothing is rolled back.
+	case 60:
+	{
+		if (batch_active){
+			response(false);
+			break;
+		}
+		unsigned long status = 0;
+		boolean ok = batchRun(input_serial_buffer, status);
+		msg = "Batch status: ";
+		debugMessage(GEN, command, MSG, status);
+		response(ok, status);
+		break;
+	}
+
     
     //*****************MAIN READ COMMANDS********************
     
@@ -825,11 +1060,9 @@ void serMain(byte command, byte* input_serial_buffer) {
 	//Command 107 reads voltage in
 	case 107:
 	{
-		int voltage = analogRead(VOLTAGE_PIN);
-		float floatVolts = ((float)voltage / 1023 * 25);
-		unsigned long converted = (unsigned long) (floatVolts * FLOAT_TO_FIXED);
+		unsigned long converted = supplyVoltage();
 		msg = "Supply voltage: ";
-		debugMessage(GEN, command, MSG, floatVolts);
+		debugMessage(GEN, command, MSG, converted);
 		response(true, converted);
 		break;
 	}
@@ -837,11 +1070,9 @@ void serMain(byte command, byte* input_serial_buffer) {
 	//Command 108 reads current to the motors
 	case 108:
 	{
-		int current = analogRead(CURRENT_PIN);
-		float floatCurrent = ((float)current / 1023 * 5);
-		unsigned long converted = (unsigned long) (floatCurrent * FLOAT_TO_FIXED);
+		unsigned long converted = supplyCurrent();
 		msg = "Supply current: ";
-		debugMessage(GEN, command, MSG, floatCurrent);
+		debugMessage(GEN, command, MSG, converted);
 		response(true, converted);
 		break;
 	}
@@ -959,7 +1190,8 @@ void serMain(byte command, byte* input_serial_buffer) {
 		break;
 	}
 
-	//Command 124 returns a byte where the three least significant bits indicate each motor's attachment state
+	//Command 124 returns a byte where the three least significant bits indicate each motor's attachment state, from the last
+	// attach check (B1000 if none has completed). Each query also starts a new check in the background if no motors are running
 	case 124:
 	{
 		byte ret = checkMotorAttach();
@@ -1071,6 +1303,54 @@ void serMain(byte command, byte* input_serial_buffer) {
 		break;
 	}
 
+	//Command 135 returns the current status telemetry frame, see OM_Telemetry for the layout
+	case 135:
+	{
+		msg = "Telemetry frame";
+		debugMessage(GEN, command, MSG);
+		response(true, (char*)telemetryFrame(), telemetryLength());
+		break;
+	}
+
+	//Command 136 returns a clock sync statistic selected by byte 0: 0 = error at the last loop update (us),
+	// 1 = clock rate correction (ppb), 2 = sync samples received, 3 = locked, 4 = samples rejected mid-program
+	case 136:
+	{
+		long value = syncStat(input_serial_buffer[0]);
+		msg = "Clock sync stat: ";
+		debugMessage(GEN, command, MSG, value);
+		response(true, value);
+		break;
+	}
+
+	//Command 137 returns the shortest camera interval (ms) that leaves time for every SMS move at full speed
+	case 137:
+	{
+		unsigned long min_interval = smsMinInterval();
+		msg = "Minimum SMS interval: ";
+		debugMessage(GEN, command, MSG, min_interval);
+		response(true, min_interval);
+		break;
+	}
+
+	//Command 138 returns whether coordinated multi-axis moves are on
+	case 138:
+	{
+		msg = "Coordinated moves: ";
+		debugMessage(GEN, command, MSG, coordinatedMoves());
+		response(true, coordinatedMoves());
+		break;
+	}
+
+	//Command 139 returns the status telemetry period in milliseconds, 0 if off
+	case 139:
+	{
+		msg = "Telemetry period: ";
+		debugMessage(GEN, command, MSG, telemetryPeriod());
+		response(true, telemetryPeriod());
+		break;
+	}
+
 	//Command 140 returns the full run status as a single byte. Prefer this command over 0.101 and 
 	// 5.120, as they will be depreciated in future versions
 	case 140:
@@ -1101,6 +1381,88 @@ void serMain(byte command, byte* input_serial_buffer) {
 		break;
 	}
 
+	//Command 201 returns a loop task statistic. Byte 0 is the task ID (0-8), byte 1 is the statistic:
+	// 0 = period (ms), 1 = run count, 2 = average run time (us), 3 = max run time (us), 4 = late runs, 5 = total run time (us)
+	// Task ID 255 clears the statistics of all tasks
+	case 201:
+	{
+		byte task = input_serial_buffer[0];
+		byte stat = input_serial_buffer[1];
+
+		if (task == 255) {
+			schedClearStats();
+			msg = "Clearing task stats";
+			debugMessage(GEN, command, MSG);
+			response(true);
+		}
+		else if (task >= TASK_COUNT) {
+			response(false);
+		}
+		else {
+			unsigned long value = schedStat(task, stat);
+			msg = "Task stat: ";
+			debugMessage(GEN, command, MSG, value);
+			response(true, value);
+		}
+		break;
+	}
+
+	//Command 202 returns a memory statistic selected by byte 0:
+	// 0 = free now, 1 = stack high-water, 2 = heap high-water, 3 = never used, 4 = free list bytes (all in bytes), 5 = heap fragmentation (%)
+	case 202:
+	{
+		unsigned int value = memStat(input_serial_buffer[0]);
+		msg = "Memory stat: ";
+		debugMessage(GEN, command, MSG, value);
+		response(true, value);
+		break;
+	}
+
+	//Command 203 returns a run time profile statistic. Byte 0 is the site: 0 = step ISR, 1 = camera callback,
+	// 2 = aux output stop, 3 = loop pass. Byte 1 is the statistic: 0 = run count, 1 = min (us), 2 = max (us),
+	// 3 = mean (us). Site 255 clears the statistics of all sites
+	case 203:
+	{
+		byte site = input_serial_buffer[0];
+		byte stat = input_serial_buffer[1];
+
+		if (site == 255) {
+			profClear();
+			msg = "Clearing profile stats";
+			debugMessage(GEN, command, MSG);
+			response(true);
+		}
+		else if (site >= PROF_SITE_COUNT) {
+			response(false);
+		}
+		else {
+			unsigned long value = profStat(site, stat);
+			msg = "Profile stat: ";
+			debugMessage(GEN, command, MSG, value);
+			response(true, value);
+		}
+		break;
+	}
+
+	//Command 204 returns one bucket of a site's run time histogram. Byte 0 is the site (as command 203), byte 1
+	// the bucket: 0 counts runs under 2us, n runs of 2^n to 2^(n+1)-1 us, 11 everything from 2048us up
+	case 204:
+	{
+		byte site = input_serial_buffer[0];
+		byte bucket = input_serial_buffer[1];
+
+		if (site >= PROF_SITE_COUNT || bucket >= PROF_BUCKETS) {
+			response(false);
+		}
+		else {
+			unsigned int count = profBucket(site, bucket);
+			msg = "Profile bucket: ";
+			debugMessage(GEN, command, MSG, count);
+			response(true, count);
+		}
+		break;
+	}
+
 	//*****************DEBUG COMMANDS********************
 
 	//Command 252 sets the MoCoBus debug enable state
@@ -1170,6 +1532,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 	case 3:
 	{
 		thisMotor.enable(input_serial_buffer[0]);
+		programGeometryDirty();
 		msg = "Setting enable: ";
 		debugMessage(subaddr, command, MSG, thisMotor.enable());
 		response(true);
@@ -1182,6 +1545,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		msg = "Stopping motor";
 		debugMessage(subaddr, command, MSG);
 		// stop motor now
+		stepMoveCancel(subaddr - 1);
 		thisMotor.stop();
 		kf_running = false;
 		debugOff();
@@ -1207,6 +1571,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		byte in_val = input_serial_buffer[0];
 		thisMotor.ms(in_val);
 		OMEEPROM::write(EE_MS_0 + (subaddr - 1) * EE_MOTOR_MEMORY_SPACE, in_val);		
+		programGeometryDirty();
 		msg = "Setting microsteps: ";
 		debugMessage(subaddr, command, MSG, in_val);
 		response(true);
@@ -1218,6 +1583,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 	{
 		unsigned int in_val = Node.ntoui(input_serial_buffer);
 		thisMotor.maxSpeed(in_val);
+		programGeometryDirty();
 		msg = "Setting max speed: ";
 		debugMessage(subaddr, command, MSG, in_val);		
 		response(true);
@@ -1271,7 +1637,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 
 		// send a motor home
 		thisMotor.ms(4);		
-		thisMotor.home();
+		stepMoveTo(subaddr - 1, 0);
 		startISR();
 		thisMotor.setSending(true);
 		response(true);
@@ -1289,7 +1655,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		debugMessage(subaddr, command, MSG);
         thisMotor.contSpeed(thisMotor.maxSpeed());
 
-		thisMotor.moveToEnd();
+		stepMoveTo(subaddr - 1, thisMotor.endPos());
 		startISR();
 		response(true);
 		break;
@@ -1332,6 +1698,8 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		msg = "Setting acceleration: ";
 		debugMessage(subaddr, command, MSG, in_val);		
 		thisMotor.contAccel(in_val);		
+		coordForget(subaddr - 1);
+		programGeometryDirty();
 		response(true);
 		break;
 	}
@@ -1360,7 +1728,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		if (steps == 0)
 			thisMotor.continuous(true);
 				
-		thisMotor.move(dir, steps);
+		stepMove(subaddr - 1, dir, steps);
 		startISR();
 
 		response(true);
@@ -1389,19 +1757,26 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		break;
 	}
    
-    //Command 18 set motor's easing mode  
+    //Command 18 set motor's easing mode: 1 = linear, 2 = quadratic, 3 = inverse quadratic, 4 = S-curve.
+	// S-curve applies to send moves, including key frame SMS moves
 	case 18:
 	{
-		if (input_serial_buffer[0] == 1)
+		byte mode = input_serial_buffer[0];
+
+		if (mode < 1 || mode > 4) {
+			response(false);
+			break;
+		}
+
+		scurveEasing(subaddr - 1, mode == 4);
+		if (mode == 1)
 			thisMotor.easing(OM_MOT_LINEAR);
-		else if (input_serial_buffer[0] == 2)
+		else if (mode == 2)
 			thisMotor.easing(OM_MOT_QUAD);
-		else if (input_serial_buffer[0] == 3)
+		else if (mode == 3)
 			thisMotor.easing(OM_MOT_QUADINV);
-		else
-			response(false);
 		msg = "Setting easing mode: ";
-		debugMessage(subaddr, command, MSG, thisMotor.easing());
+		debugMessage(subaddr, command, MSG, scurveEasing(subaddr - 1) ? OM_MOT_SCURVE : thisMotor.easing());
 		response(true);
 		break;
 	}
@@ -1414,6 +1789,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 	case 19:
 	{
 		thisMotor.planLeadIn(Node.ntoul(input_serial_buffer));
+		programGeometryDirty();
 		msg = "Setting lead-in: ";
 		debugMessage(subaddr, command, MSG, thisMotor.planLeadIn());		
 		if (!graffik_mode)
@@ -1427,6 +1803,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 	case 20:
 	{
 		thisMotor.planTravelLength(Node.ntoul(input_serial_buffer));
+		programGeometryDirty();
 		msg = "Setting travel length: ";
 		debugMessage(subaddr, command, MSG, thisMotor.planTravelLength());
 		cameraAutoMaxShots(); // If current mode is SMS, this will set the max shots value based upon the leads and travel settings
@@ -1477,6 +1854,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 	case 25:
 	{
 		thisMotor.planLeadOut(Node.ntoul(input_serial_buffer));
+		programGeometryDirty();
 		cameraAutoMaxShots(); // If current mode is SMS, this will set the max shots value based upon the leads and travel settings
 		msg = "Setting lead out: ";
 		debugMessage(subaddr, command, MSG, thisMotor.planLeadOut());
@@ -1625,7 +2003,7 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 			// rather than forcing them to run both commands.
 
 			// go ahead and make sure we fire immediately
-			camera_tm = millis() - Camera.intervalTime();
+			camera_tm = syncMillis() - Camera.intervalTime();
 
 			thisMotor.autoPause = true;
 			startProgram();
@@ -1772,9 +2150,10 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 	//Command 110 reads the easing algorithm
 	case 110:
 	{
+		byte easing = scurveEasing(subaddr - 1) ? OM_MOT_SCURVE : thisMotor.easing();
 		msg = "Easing: ";
-		debugMessage(subaddr, command, MSG, thisMotor.easing());
-		response(true, thisMotor.easing());
+		debugMessage(subaddr, command, MSG, easing);
+		response(true, easing);
 		break;
 	}
 
@@ -1901,6 +2280,25 @@ void serMotor(byte subaddr, byte command, byte* input_serial_buffer) {
 		msg = "Is sending?: ";
 		debugMessage(subaddr, command, MSG, sending);
 		response(true, sending);
+		break;
+	}
+	//Command 125 returns the time (ms) the motor's last S-curve move took to settle on its target after the profile ended
+	case 125:
+	{
+		unsigned long settle = scurveSettle(subaddr - 1);
+		msg = "S-curve settle time: ";
+		debugMessage(subaddr, command, MSG, settle);
+		response(true, settle);
+		break;
+	}
+	//Command 126 returns the steps the motor's last S-curve move was off its target when the profile ended
+	case 126:
+	{
+		long landing = scurveLanding(subaddr - 1);
+		msg = "S-curve landing error: ";
+		debugMessage(subaddr, command, MSG, landing);
+		response(true, landing);
+		break;
 	}
 
     //Error    
@@ -1965,6 +2363,7 @@ void serCamera(byte subaddr, byte command, byte* input_serial_buffer) {
 	{
 		unsigned int in_val = Node.ntoui(input_serial_buffer);
 		Camera.setMaxShots(in_val);
+		programGeometryDirty();
 		msg = "Setting max shots: ";
 		debugMessage(subaddr, command, MSG, Camera.getMaxShots());
 		response(true);
@@ -2005,6 +2404,7 @@ void serCamera(byte subaddr, byte command, byte* input_serial_buffer) {
 	case 10:
 	{
 		Camera.intervalTime(Node.ntoul(input_serial_buffer));
+		programGeometryDirty();
 		msg = "Setting interval time: ";
 		debugMessage(subaddr, command, MSG, Camera.intervalTime());
 		response(true);
@@ -2201,7 +2601,7 @@ void serialComplexMove(byte subaddr, byte* buf) {
    
    unsigned long decel  = Node.ntoul(buf);
 
-   thisMotor.move(dir, dist, arrive, accel, decel); 
+   stepMoveTimed(subaddr - 1, dir, dist, arrive, accel, decel);
 }
 
 
@@ -2235,6 +2635,12 @@ void serKeyFrame(byte command, byte* input_serial_buffer){
 	{
 		int in_val = Node.ntoi(input_serial_buffer);		
 
+		// Only KF_MAX_POINTS frames fit in the program tables
+		if (in_val > KF_MAX_POINTS) {
+			response(false);
+			break;
+		}
+
 		// If this is the start of a new transmission, set the count and the receive flag
 		if (in_val >= 0){				   		
 			int axis = KeyFrames::getAxis();
@@ -2402,6 +2808,44 @@ void serKeyFrame(byte command, byte* input_serial_buffer){
 		break;
 	}
 
+	// Command 24 turns key frame streaming on or off. Either way, any streamed points are discarded
+	case 24:
+	{
+		byte in_val = input_serial_buffer[0];
+		kf_streamMode(in_val);
+		msg = "Setting streaming mode: ";
+		debugMessage(KF, command, MSG, in_val);
+		response(true, in_val);
+		break;
+	}
+
+	// Command 25 streams the next key point for the current axis: time (ms, long), position (steps, float), 
+	// velocity (steps/sec, float). Responds with the number of free segment slots, or failure if the point wasn't accepted
+	case 25:
+	{
+		int axis = KeyFrames::getAxis();
+		long x = Node.ntol(input_serial_buffer);
+		float pos = Node.ntof(input_serial_buffer + 4);
+		float vel = Node.ntof(input_serial_buffer + 8);
+
+		boolean ok = kf_streamPush(axis, x, pos, vel);
+		byte free_slots = kf_streamFree(axis);
+		msg = "Streaming point, free slots: ";
+		debugMessage(KF, command, MSG, free_slots);
+		response(ok, free_slots);
+		break;
+	}
+
+	// Command 26 ends the key point stream for the current axis
+	case 26:
+	{
+		kf_streamEnd(KeyFrames::getAxis());
+		msg = "Ending key point stream";
+		debugMessage(KF, command, MSG);
+		response(true);
+		break;
+	}
+
 
 
 	//*****************KEY FRAME READ COMMANDS********************
@@ -2495,6 +2939,7 @@ void serKeyFrame(byte command, byte* input_serial_buffer){
 	}
 
 	// Command 120 returns run state of a key frame program: 0 = STOPPED, 1 = RUNNING, 2 = PAUSED
+	// When streaming, 0x10 is set if the host should send another window of points and 0x20 if an axis ran out of points
 	case 120:
 	{
 		msg = "Run state: ";
@@ -2531,6 +2976,16 @@ void serKeyFrame(byte command, byte* input_serial_buffer){
 		break;
 	}
 
+	// Command 124 returns the number of free streaming segment slots for the current axis
+	case 124:
+	{
+		byte free_slots = kf_streamFree(KeyFrames::getAxis());
+		msg = "Free stream slots: ";
+		debugMessage(KF, command, MSG, free_slots);
+		response(true, free_slots);
+		break;
+	}
+
 	// Command 130 returns the time position of the requested key frame for the current axis
 	case 130:
 	{
@@ -2565,35 +3020,50 @@ void serKeyFrame(byte command, byte* input_serial_buffer){
 	}// End switch case
 }
 
-String floatToString(float input){
-	String data = String((long)input * FLOAT_TO_FIXED);
-	data = data.substring(0, data.length() - 2) + "." + data.substring(data.length() - 2, data.length());
-	return data;
-}
-
 void debugMessage(byte subaddr, int command, const char* message){
 	debugMessage(subaddr, command, message, -1e9);
 }
 
 void debugMessage(byte subaddr, int command, const char* message, float data){
 
-	debug.ser("Time: " + String(millis()) + " - ");
+	byte state = debug.getState();
+
+	if (state & DebugClass::DB_BINLOG)
+		logCommand(subaddr, command, data);
+
+	// Nothing else to do unless text output is on
+	if (!(state & DebugClass::DB_GEN_SER))
+		return;
+
+	debug.ser(F("Time: "));
+	debug.ser(millis());
+	debug.ser(F(" - "));
 	switch (subaddr){
 	case 0:
-		debug.ser(getMsgFromFlash(GEN_STR) + String(command) + " - " + getMsgFromFlash(message));
+		debug.ser(getMsgFromFlash(GEN_STR));
+		debug.ser(command);
 		break;
 	case 1:
 	case 2:
 	case 3:
-		debug.ser(getMsgFromFlash(MOT_STR) + String(command) + " - motor " + String(subaddr - 1) + " - " + getMsgFromFlash(message));
+		debug.ser(getMsgFromFlash(MOT_STR));
+		debug.ser(command);
+		debug.ser(F(" - motor "));
+		debug.ser(subaddr - 1);
 		break;
 	case 4:
-		debug.ser(getMsgFromFlash(CAM_STR) + String(command) + " - " + getMsgFromFlash(message));
+		debug.ser(getMsgFromFlash(CAM_STR));
+		debug.ser(command);
 		break;
 	case 5:
-		debug.ser(getMsgFromFlash(KF_STR) + String(command) + " - axis " + String(KeyFrames::getAxis()) + " - " + getMsgFromFlash(message));
+		debug.ser(getMsgFromFlash(KF_STR));
+		debug.ser(command);
+		debug.ser(F(" - axis "));
+		debug.ser(KeyFrames::getAxis());
 		break;
 	}
+	debug.ser(F(" - "));
+	debug.ser(getMsgFromFlash(message));
 	if (data == -1e9)
 		debug.serln("");
 	else
@@ -2615,6 +3085,8 @@ void response_check(uint8_t p_stat) {
 }
 
 void response(uint8_t p_stat){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2634,6 +3106,8 @@ void response(uint8_t p_stat){
 } 
 
 void response(uint8_t p_stat, uint8_t p_resp){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2652,6 +3126,8 @@ void response(uint8_t p_stat, uint8_t p_resp){
 }
 
 void response(uint8_t p_stat, unsigned int p_resp){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2670,6 +3146,8 @@ void response(uint8_t p_stat, unsigned int p_resp){
 }
 
 void response(uint8_t p_stat, int p_resp){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2688,6 +3166,8 @@ void response(uint8_t p_stat, int p_resp){
 }
 
 void response(uint8_t p_stat, unsigned long p_resp){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2706,6 +3186,8 @@ void response(uint8_t p_stat, unsigned long p_resp){
 }
 
 void response(uint8_t p_stat, long p_resp){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2724,6 +3206,8 @@ void response(uint8_t p_stat, long p_resp){
 }
 
 void response(uint8_t p_stat, float p_resp){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 
 	switch(node){
@@ -2742,6 +3226,8 @@ void response(uint8_t p_stat, float p_resp){
 }
 
 void response(uint8_t p_stat, char* p_resp, int p_len){
+	if (batchCapture(p_stat))
+		return;
 	response_check(p_stat);
 	
 	switch(node){
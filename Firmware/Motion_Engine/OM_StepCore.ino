@@ -0,0 +1,416 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Step generation core
+  ========================================
+
+  A single Timer1 ISR steps the motors in every mode. Work comes from one
+  of two sources:
+
+	Plan	- each motor's OMMotorFunctions plan, which is asked every tick
+			  whether it is due a step. MoCoBus programs, joystick and
+			  continuous moves run this way (startISR()).
+
+	Queue	- a short queue of segments. Each segment gives every motor a step
+			  count, a rate and a direction for a fixed number of ticks, and
+			  the steps are spread over it with a 16 bit phase accumulator.
+			  DFMoco point-to-point, go-motion and jog moves feed this.
+
+  The two can be mixed: motors in step_queue_mask are stepped from the queue
+  while the rest follow their plans. MoCoBus point moves are precomputed into
+  segments this way (OM_StepMoves).
+
+  Either way the due step bits are raised together with one write to the
+  step port, so both modes share the same pulse timing and cycle budget.
+  The worst-case ISR time is kept for the DFMoco "pf" command.
+
+*/
+
+const byte STEP_SRC_PLAN	= 0;
+const byte STEP_SRC_QUEUE	= 1;
+
+const byte STEP_QUEUE_SIZE	= 2;			// Segments, including the one being stepped
+
+struct step_segment {
+	unsigned int	ticks;					// Length in ISR ticks
+	unsigned int	steps[MOTOR_COUNT];		// Steps left to take
+	unsigned int	rate[MOTOR_COUNT];		// Accumulator increment per tick, 65535 steps every tick
+	byte			dir;					// Direction bits, set is forward
+};
+
+volatile byte step_source = STEP_SRC_PLAN;
+volatile byte step_queue_mask = 0;			// Motors stepped from the queue rather than their plans
+
+step_segment step_queue[STEP_QUEUE_SIZE];
+volatile byte step_head = 0;				// Segment being stepped, moved on by the ISR
+byte step_tail = 0;							// Segment being built, moved on by stepQueuePush()
+volatile byte step_count = 0;				// Segments queued, including the one being stepped
+bool step_loaded = false;					// The head segment is being stepped
+unsigned int step_ticks = 0;				// Ticks left in the head segment
+uint16_t step_acc[MOTOR_COUNT];				// Phase accumulators, a step each time one wraps
+
+// Direction pins, resolved to port and bit when the ISR is attached
+const uint8_t step_dir_pins[MOTOR_COUNT] = { OM_MOT1_DDIR, OM_MOT2_DDIR, OM_MOT3_DDIR };
+volatile uint8_t* step_dir_port[MOTOR_COUNT];
+uint8_t step_dir_mask[MOTOR_COUNT];
+
+volatile unsigned int step_max_cycles = 0;	// Worst-case ISR time in CPU cycles
+
+
+/** Start Stepping From Motor Plans
+
+ Attaches the step ISR to run each motor's OMMotorFunctions plan every
+ p_period microseconds. The ISR detaches itself and raises motionDone when
+ no motor is left running.
+ */
+
+void stepCoreStartPlan(unsigned long p_period) {
+
+	stepCoreAttach(STEP_SRC_PLAN, p_period);
+}
+
+
+/** Start Stepping From The Segment Queue
+
+ Attaches the step ISR to step queued segments every p_period microseconds.
+ The ISR keeps running while the queue is empty, so callers can pace their
+ segments off it.
+ */
+
+void stepCoreStartQueue(unsigned long p_period) {
+
+	stepQueueClear();
+	step_queue_mask = (1 << MOTOR_COUNT) - 1;
+	stepCoreAttach(STEP_SRC_QUEUE, p_period);
+}
+
+
+ // Resolves each motor's step bit and direction pin and attaches the ISR
+void stepCoreAttach(byte p_source, unsigned long p_period) {
+
+	// Resolve each motor's pins once, rather than on every tick
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		stepMask[i] = (1 << motor[i].stpflg);
+		step_dir_port[i] = portOutputRegister(digitalPinToPort(step_dir_pins[i]));
+		step_dir_mask[i] = digitalPinToBitMask(step_dir_pins[i]);
+	}
+
+	step_source = p_source;
+	Timer1.initialize(p_period);
+	Timer1.attachInterrupt(stepCoreISR);
+}
+
+
+/** Stop Stepping
+
+ Detaches the step ISR. Safe to call from the ISR itself.
+ */
+
+void stepCoreStop() {
+
+	Timer1.detachInterrupt();
+	ISR_On = false;
+}
+
+
+/** Queue Full
+
+ Returns true when there is no room for another segment.
+ */
+
+bool stepQueueFull() {
+	return step_count >= STEP_QUEUE_SIZE;
+}
+
+
+/** Set Segment Motor
+
+ Fills in one motor of the segment being built. Every motor must be set
+ before the segment is pushed with stepQueuePush().
+
+ @param p_rate
+ Accumulator increment per tick: steps per tick * 65536, capped at 65535
+ */
+
+void stepQueueSet(byte p_motor, unsigned int p_steps, unsigned int p_rate, bool p_dir) {
+
+	// Only the loop moves the tail, so the slot can't shift under us while
+	// the ISR drops segments from the head
+	step_segment& seg = step_queue[step_tail];
+
+	seg.steps[p_motor] = p_steps;
+	seg.rate[p_motor] = p_rate;
+
+	if (p_dir)
+		seg.dir |= (1 << p_motor);
+	else
+		seg.dir &= ~(1 << p_motor);
+}
+
+
+/** Push Segment
+
+ Queues the segment built with stepQueueSet(), to run for p_ticks ticks.
+ */
+
+void stepQueuePush(unsigned int p_ticks) {
+
+	step_queue[step_tail].ticks = p_ticks;
+	step_tail = (step_tail + 1) % STEP_QUEUE_SIZE;
+
+	noInterrupts();
+	step_count++;
+	interrupts();
+}
+
+
+/** Clear Queue
+
+ Drops every queued segment, including the one being stepped.
+ */
+
+void stepQueueClear() {
+
+	noInterrupts();
+	step_count = 0;
+	step_tail = step_head;
+	step_loaded = false;
+	step_ticks = 0;
+	interrupts();
+}
+
+
+/** Queued Steps
+
+ Returns the steps p_motor has left in the queue, including the segment
+ being stepped.
+ */
+
+unsigned long stepQueueSteps(byte p_motor) {
+
+	noInterrupts();
+	unsigned long steps = stepQueueTally(p_motor);
+	interrupts();
+
+	return steps;
+}
+
+
+/** Step Motor From The Queue
+
+ Hands p_motor over to the queue while the ISR runs its plan source. Its
+ entries in segments already queued are taken as they stand, so they should
+ be empty (stepQueueClear() or stepQueueDrop()).
+ */
+
+void stepQueueAdd(byte p_motor) {
+
+	noInterrupts();
+	step_queue_mask |= (1 << p_motor);
+	interrupts();
+}
+
+
+/** Drop Motor From The Queue
+
+ Clears p_motor's steps from every queued segment and hands it back to its
+ plan. Returns the number of steps dropped.
+ */
+
+unsigned long stepQueueDrop(byte p_motor) {
+
+	noInterrupts();
+	unsigned long steps = stepQueueTally(p_motor);
+	for (byte i = 0; i < STEP_QUEUE_SIZE; i++)
+		step_queue[i].steps[p_motor] = 0;
+	step_queue_mask &= ~(1 << p_motor);
+	interrupts();
+
+	return steps;
+}
+
+
+/** Worst-Case ISR Cycles
+
+ Returns the longest time spent in the step ISR, in CPU cycles from the
+ timer event, and optionally starts the measurement over.
+ */
+
+unsigned int stepCoreMaxCycles(bool p_reset) {
+
+	noInterrupts();
+	unsigned int cycles = step_max_cycles;
+	if (p_reset)
+		step_max_cycles = 0;
+	interrupts();
+
+	return cycles;
+}
+
+
+ // Steps p_motor has queued, call with interrupts off
+unsigned long stepQueueTally(byte p_motor) {
+
+	unsigned long steps = 0;
+
+	for (byte i = 0, seg = step_head; i < step_count; i++, seg = (seg + 1) % STEP_QUEUE_SIZE)
+		steps += step_queue[seg].steps[p_motor];
+
+	return steps;
+}
+
+
+ // One tick of the motor plans, returns the step bits due
+byte stepPlanTick() {
+
+	byte fired = 0;
+	bool still_running = false;
+
+	// Motors handed to the queue are stepped from their segments instead
+	if (step_queue_mask) {
+		fired = stepQueueTick();
+		still_running = true;
+	}
+
+	 //steps all motors at once, noting which are still running after this step
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (step_queue_mask & (1 << i))
+			continue;
+
+		if (motor[i].running()) {
+			motor[i].checkRefresh();					// Reset motor steps, cycles, error, etc for the new ISR run
+			if (motor[i].checkStep())
+				fired |= stepMask[i];
+			if (motor[i].running())
+				still_running = true;
+		}
+	}
+
+	// Nothing left to step: stop the timer and let loop() do the rest
+	if (!still_running) {
+		stepCoreStop();
+		motionDone = true;
+	}
+
+	return fired;
+}
+
+
+ // One tick of the segment queue, returns the step bits due
+byte stepQueueTick() {
+
+	if (step_ticks == 0) {
+
+		// Done with the head segment, move on to the next one
+		if (step_loaded) {
+			step_head = (step_head + 1) % STEP_QUEUE_SIZE;
+			step_count--;
+			step_loaded = false;
+		}
+
+		// Nothing queued, idle until something is
+		if (!step_count)
+			return 0;
+
+		step_segment& seg = step_queue[step_head];
+		step_ticks = seg.ticks;
+		step_loaded = true;
+
+		// Directions only change between segments, a full tick before the next
+		// step. Motors still on their plans keep their own.
+		for (byte i = 0; i < MOTOR_COUNT; i++) {
+			if (step_queue_mask & (1 << i)) {
+				if (seg.dir & (1 << i))
+					*step_dir_port[i] |= step_dir_mask[i];
+				else
+					*step_dir_port[i] &= ~step_dir_mask[i];
+			}
+
+			step_acc[i] = 65535;
+		}
+	}
+
+	step_ticks--;
+
+	step_segment& seg = step_queue[step_head];
+	byte fired = 0;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if (seg.steps[i]) {
+			uint16_t last = step_acc[i];
+			step_acc[i] += seg.rate[i];
+			if (step_acc[i] < last) {
+				seg.steps[i]--;
+				fired |= stepMask[i];
+			}
+		}
+	}
+
+	return fired;
+}
+
+
+ // Step ISR, run every time Timer1 triggers
+void stepCoreISR() {
+
+	// Clear the TOP flag left from the last period, so it only shows whether
+	// this run went past TOP (TOV1 is cleared by taking the interrupt)
+	TIFR1 = _BV(ICF1);
+
+	byte fired = (step_source == STEP_SRC_QUEUE) ? stepQueueTick() : stepPlanTick();
+
+	// All three step pins share one port (OM_MOTx_STPREG), so a single write
+	// fires every motor that is due. The register comes from the pin assignment
+	// defines and can be pointed elsewhere when building off the board.
+	if (fired) {
+		OM_MOT1_STPREG |= fired;
+		delayMicroseconds(1);
+		OM_MOT1_STPREG &= ~fired;
+	}
+
+	// Timer1 runs phase and frequency correct at the CPU clock (periods under
+	// 8ms): it interrupts at BOTTOM, counts up to TOP (ICR1) and back down.
+	// Once past TOP the count has to be unfolded, and past BOTTOM again the
+	// run took longer than the whole period.
+	unsigned int count = TCNT1;
+	byte flags = TIFR1;
+	unsigned int cycles;
+
+	if (flags & _BV(TOV1))
+		cycles = 2 * ICR1 + count;
+	else if (flags & _BV(ICF1))
+		cycles = 2 * ICR1 - count;
+	else
+		cycles = count;
+
+	if (cycles > step_max_cycles)
+		step_max_cycles = cycles;
+
+	profRecord(PROF_STEP_ISR, cycles / (F_CPU / 1000000L));
+}
@@ -0,0 +1,352 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Precomputed point moves
+  ========================================
+
+  MoCoBus point moves (sends, home, simple and complex moves) don't run on
+  the motor plans. Each one is laid out up front as a trapezoid in ISR
+  ticks, and taskSteps() cuts it into step core segments a little ahead of
+  the ISR: every segment gives the motor its step count and a fixed point
+  rate, so the ISR does one add and compare per axis instead of asking the
+  plan about every tick.
+
+  OMMotorFunctions still gets the move, so running(), isSending() and the
+  rest read as they always have, but the ISR never steps it from the plan:
+  the motor is handed to the queue (stepQueueAdd()) before the library
+  starts the move, and the library is stopped before the motor is handed
+  back. currentPos() is kept up from the steps the queue has taken.
+
+  A move started while the motor runs on its plan (continuous or joystick)
+  goes to the library as before.
+
+*/
+
+const unsigned long STEP_MOVE_SEGMENT_US	= 20000;	// Length of each queued segment
+
+struct step_move {
+	unsigned long	steps;		// Length of the move
+	unsigned long	queued;		// Steps handed to the queue so far
+	unsigned long	t;			// Ticks handed to the queue so far
+	long			start;		// Position the move started from
+	bool			dir;
+	float			t_accel;	// Ramp up, in ticks
+	float			t_decel;	// Ramp down, in ticks
+	float			t_total;	// Whole move, in ticks
+	float			v_top;		// Top speed, in steps per tick
+};
+
+step_move step_moves[MOTOR_COUNT];
+byte step_moves_active = 0;			// Motors making a precomputed move
+unsigned int step_move_ticks = 1;	// Ticks per queued segment
+
+
+/** Precomputed Move
+
+ Moves p_motor p_steps in direction p_dir at its continuous speed and
+ acceleration, in place of OMMotorFunctions::move(). The caller starts the
+ ISR as before.
+ */
+
+void stepMove(byte p_motor, bool p_dir, unsigned long p_steps) {
+
+	stepMoveCancel(p_motor);
+
+	bool planned = stepMovePlan(p_motor, p_dir, p_steps);
+	motor[p_motor].move(p_dir, p_steps);
+	stepMoveStarted(p_motor, planned);
+}
+
+
+/** Precomputed Move To Position
+
+ Sends p_motor to p_pos at its continuous speed and acceleration, in place
+ of OMMotorFunctions::moveTo(p_pos, true). The caller starts the ISR as
+ before.
+ */
+
+void stepMoveTo(byte p_motor, long p_pos) {
+
+	stepMoveCancel(p_motor);
+
+	long dist = p_pos - motor[p_motor].currentPos();
+	bool planned = stepMovePlan(p_motor, dist > 0, abs(dist));
+	motor[p_motor].moveTo(p_pos, true);
+	stepMoveStarted(p_motor, planned);
+}
+
+
+/** Precomputed Timed Move
+
+ Moves p_motor p_steps so that it arrives after p_time ms, ramping up over
+ p_accel ms and down over p_decel ms, in place of the timed
+ OMMotorFunctions::move(). The caller starts the ISR as before.
+ */
+
+void stepMoveTimed(byte p_motor, bool p_dir, unsigned long p_steps, unsigned long p_time, unsigned long p_accel, unsigned long p_decel) {
+
+	stepMoveCancel(p_motor);
+
+	float tps = stepMoveTickRate();
+	float t_total = p_time * tps / MILLIS_PER_SECOND;
+	float t_accel = p_accel * tps / MILLIS_PER_SECOND;
+	float t_decel = p_decel * tps / MILLIS_PER_SECOND;
+
+	// Ramps longer than the move share it out between them
+	if (t_accel + t_decel > t_total && t_accel + t_decel > 0) {
+		float k = t_total / (t_accel + t_decel);
+		t_accel *= k;
+		t_decel *= k;
+	}
+
+	bool planned = stepMoveReady(p_motor, p_steps) && stepMoveLayout(p_motor, p_dir, p_steps, t_accel, t_decel, t_total);
+	motor[p_motor].move(p_dir, p_steps, p_time, p_accel, p_decel);
+	stepMoveStarted(p_motor, planned);
+}
+
+
+/** Cancel Precomputed Move
+
+ Stops p_motor's precomputed move where it is, if it has one, and brings
+ its position up to date.
+ */
+
+void stepMoveCancel(byte p_motor) {
+
+	if (!(step_moves_active & (1 << p_motor)))
+		return;
+
+	// Stop the library first, so the plan has nothing to step once the motor is handed back
+	motor[p_motor].stop();
+	unsigned long left = stepQueueDrop(p_motor);
+	stepMovePosition(p_motor, step_moves[p_motor].queued - left);
+	step_moves_active &= ~(1 << p_motor);
+}
+
+
+/** Feed Precomputed Moves
+
+ Brings each moving motor's position up to date, finishes the moves the ISR
+ has stepped out, and tops the step queue up with the next segment of the
+ rest.
+ */
+
+void taskSteps() {
+
+	if (!step_moves_active)
+		return;
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+		if (!(step_moves_active & (1 << i)))
+			continue;
+
+		step_move& m = step_moves[i];
+		unsigned long left = stepQueueSteps(i);
+		stepMovePosition(i, m.queued - left);
+
+		// All stepped out: stop the library before the motor goes back to its plan
+		if (m.queued == m.steps && left == 0) {
+			motor[i].stop();
+			stepQueueDrop(i);
+			step_moves_active &= ~(1 << i);
+		}
+	}
+
+	while (!stepQueueFull() && stepMovePending()) {
+
+		for (byte i = 0; i < MOTOR_COUNT; i++) {
+
+			step_move& m = step_moves[i];
+
+			if (!(step_moves_active & (1 << i)) || m.queued >= m.steps) {
+				stepQueueSet(i, 0, 0, m.dir);
+				continue;
+			}
+
+			m.t += step_move_ticks;
+			float pos = stepMoveProfile(i, m.t);
+			unsigned long want = (pos >= m.steps) ? m.steps : (unsigned long)(pos + 0.5);
+			unsigned long steps = (want > m.queued) ? want - m.queued : 0;
+
+			// At most a step a tick, anything over follows in the next segment
+			if (steps > step_move_ticks)
+				steps = step_move_ticks;
+
+			m.queued += steps;
+			unsigned int rate = (steps >= step_move_ticks) ? 65535 : (unsigned int)((steps << 16) / step_move_ticks);
+			stepQueueSet(i, steps, rate, m.dir);
+		}
+
+		stepQueuePush(step_move_ticks);
+	}
+}
+
+
+ // ISR ticks per second
+float stepMoveTickRate() {
+	return 1000000.0 / motor[0].curSamplePeriod();
+}
+
+
+ // True if a move of p_steps can be laid out for p_motor
+bool stepMoveReady(byte p_motor, unsigned long p_steps) {
+
+	// Continuous and joystick moves stay on the plan, and so does anything started over them
+	return p_steps > 0 && !motor[p_motor].running();
+}
+
+
+ // Lays out a move at p_motor's continuous speed and acceleration
+bool stepMovePlan(byte p_motor, bool p_dir, unsigned long p_steps) {
+
+	if (!stepMoveReady(p_motor, p_steps))
+		return false;
+
+	float tps = stepMoveTickRate();
+	float speed = abs(motor[p_motor].contSpeed());
+	if (speed < 1)
+		speed = motor[p_motor].maxSpeed();
+
+	float accel = motor[p_motor].contAccel();
+
+	// Steps per tick, and ticks to reach it
+	float v = speed / tps;
+	if (v <= 0)
+		return false;
+	if (v > 1)
+		v = 1;
+
+	float t_ramp = (accel > 0) ? v * tps * tps / accel : 0;
+
+	// Too short to reach full speed: ramp distance goes with the square of the peak
+	if (v * t_ramp > p_steps) {
+		float k = sqrt(p_steps / (v * t_ramp));
+		v *= k;
+		t_ramp *= k;
+	}
+
+	return stepMoveLayout(p_motor, p_dir, p_steps, t_ramp, t_ramp, p_steps / v + t_ramp);
+}
+
+
+ // Sets p_motor's move up, with the top speed that makes it come out at exactly p_steps
+bool stepMoveLayout(byte p_motor, bool p_dir, unsigned long p_steps, float p_accel, float p_decel, float p_total) {
+
+	step_move& m = step_moves[p_motor];
+	float cruise = p_total - (p_accel + p_decel) / 2;
+
+	if (cruise <= 0)
+		return false;
+
+	m.v_top = p_steps / cruise;
+
+	// Faster than the ISR can step: stretch the whole move to a step a tick
+	if (m.v_top > 1) {
+		p_accel *= m.v_top;
+		p_decel *= m.v_top;
+		p_total *= m.v_top;
+		m.v_top = 1;
+	}
+
+	m.steps = p_steps;
+	m.queued = 0;
+	m.t = 0;
+	m.start = motor[p_motor].currentPos();
+	m.dir = p_dir;
+	m.t_accel = p_accel;
+	m.t_decel = p_decel;
+	m.t_total = p_total;
+
+	// First move of a batch starts the queue afresh
+	if (!step_moves_active) {
+		step_move_ticks = max(1UL, STEP_MOVE_SEGMENT_US / motor[0].curSamplePeriod());
+		stepQueueClear();
+	}
+
+	// Off the plan before the library starts the move, so the ISR never steps it from both
+	stepQueueAdd(p_motor);
+
+	return true;
+}
+
+
+ // Takes the move on once the library has started it
+void stepMoveStarted(byte p_motor, bool p_planned) {
+
+	if (!p_planned)
+		return;
+
+	// The library turned it down (disabled motor, say), so neither runs it
+	if (!motor[p_motor].running()) {
+		stepQueueDrop(p_motor);
+		return;
+	}
+
+	step_moves_active |= (1 << p_motor);
+}
+
+
+ // Steps into the move at p_t ticks
+float stepMoveProfile(byte p_motor, float p_t) {
+
+	step_move& m = step_moves[p_motor];
+
+	if (p_t >= m.t_total)
+		return m.steps;
+
+	if (p_t < m.t_accel)
+		return m.v_top * p_t * p_t / (2 * m.t_accel);
+
+	if (p_t <= m.t_total - m.t_decel)
+		return m.v_top * (p_t - m.t_accel / 2);
+
+	float left = m.t_total - p_t;
+	return m.steps - m.v_top * left * left / (2 * m.t_decel);
+}
+
+
+ // True while any move has steps left to queue
+bool stepMovePending() {
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		if ((step_moves_active & (1 << i)) && step_moves[i].queued < step_moves[i].steps)
+			return true;
+	}
+
+	return false;
+}
+
+
+ // Sets p_motor's position p_taken steps into its move
+void stepMovePosition(byte p_motor, unsigned long p_taken) {
+
+	step_move& m = step_moves[p_motor];
+	motor[p_motor].currentPos(m.dir ? m.start + (long)p_taken : m.start - (long)p_taken);
+}
@@ -0,0 +1,173 @@
+/*
+
+
+Motion Engine
+
+See dynamicperception.com for more information
+
+
+(c) 2008-2012 C.A. Church / Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+*/
+
+/*
+
+  ========================================
+  Status telemetry
+  ========================================
+
+  Instead of polling the run status, run time, shot count and positions
+  with separate queries, a host on USB or Bluetooth can subscribe with
+  general command 34. Every subscription period the controller builds a
+  status frame, and sends it unprompted to the node the subscription came
+  from, but only if it differs from the last frame sent.
+
+  MoCoBus is half duplex and only the master may start a transfer, so
+  nothing is pushed there and a subscription from the bus is refused. The
+  bus master polls with general command 135 instead, which returns the
+  same frame as its response.
+
+  Pushed frames are sent to the master address with subaddress 0 and
+  command TELEMETRY_PUSH_CMD, so a host can tell them from responses. All
+  values are big endian, as in the rest of the protocol:
+
+	Byte0     = Device address
+	Byte1     = Run status (see getRunStatus())
+	Byte2-5   = Run time (ms, unsigned long)
+	Byte6-7   = Shots fired (unsigned int)
+	Byte8-19  = Current position of motors 0-2 (steps, long)
+	Byte20-25 = Speed of motors 0-2 (steps/sec, int)
+
+*/
+
+const byte TELEMETRY_ADDR		= 1;			// Bus master address
+const byte TELEMETRY_PUSH_CMD	= 240;			// Command code of a pushed telemetry frame
+const byte TELEMETRY_LEN		= 8 + 6 * MOTOR_COUNT;
+const unsigned int TELEMETRY_MIN_PERIOD = 20;	// Shortest period (ms) allowed
+
+unsigned int telemetry_period = 0;				// Subscription period (ms), 0 when off
+byte telemetry_node = 0;						// Node the subscription came from
+unsigned long telemetry_last = 0;				// millis() at the last frame check
+uint8_t telemetry_frame[TELEMETRY_LEN];			// Frame being built
+uint8_t telemetry_sent[TELEMETRY_LEN];			// Last frame sent
+
+
+/** Set Telemetry Period
+
+ Subscribes the node that sent the current command to status frames
+ every p_period ms. 0 unsubscribes. MoCoBus can't be subscribed, the
+ master polls instead, so a request from the bus changes nothing and
+ returns 0. Returns the period actually set.
+ */
+
+unsigned int telemetryPeriod(unsigned int p_period) {
+
+	// Leaves any USB or Bluetooth subscription alone
+	if (node == MOCOBUS)
+		return 0;
+
+	if (p_period > 0 && p_period < TELEMETRY_MIN_PERIOD)
+		p_period = TELEMETRY_MIN_PERIOD;
+
+	telemetry_period = p_period;
+	telemetry_node = node;
+	telemetry_last = millis();
+
+	// Make sure the first frame goes out
+	memset(telemetry_sent, 0xFF, TELEMETRY_LEN);
+
+	return telemetry_period;
+}
+
+
+/** Get Telemetry Period */
+
+unsigned int telemetryPeriod() {
+	return telemetry_period;
+}
+
+
+ // Writes p_val big endian into the frame at p_pos
+void telemetryPut(byte p_pos, unsigned long p_val, byte p_len) {
+
+	for (byte i = 0; i < p_len; i++)
+		telemetry_frame[p_pos + i] = p_val >> (8 * (p_len - 1 - i));
+}
+
+
+/** Build Telemetry Frame
+
+ Fills the status frame with the current values and returns it. The
+ frame is TELEMETRY_LEN bytes long.
+ */
+
+uint8_t* telemetryFrame() {
+
+	unsigned long time = kf_running ? kf_getRunTime() : getRunTime();
+
+	telemetry_frame[0] = device_address;
+	telemetry_frame[1] = getRunStatus();
+	telemetryPut(2, time, 4);
+	telemetryPut(6, camera_fired, 2);
+
+	for (byte i = 0; i < MOTOR_COUNT; i++) {
+		telemetryPut(8 + i * 4, motor[i].currentPos(), 4);
+		telemetryPut(8 + MOTOR_COUNT * 4 + i * 2, (int) motor[i].desiredSpeed(), 2);
+	}
+
+	return telemetry_frame;
+}
+
+
+/** Telemetry Frame Length */
+
+byte telemetryLength() {
+	return TELEMETRY_LEN;
+}
+
+
+/** Telemetry Task
+
+ Called from the scheduler. Builds a frame every telemetry period and
+ pushes it to the subscribed USB or Bluetooth host if it has changed.
+ */
+
+void taskTelemetry() {
+
+	if (telemetry_period == 0 || millis() - telemetry_last < telemetry_period)
+		return;
+
+	telemetry_last = millis();
+
+	telemetryFrame();
+
+	if (memcmp(telemetry_frame, telemetry_sent, TELEMETRY_LEN) == 0)
+		return;
+
+	memcpy(telemetry_sent, telemetry_frame, TELEMETRY_LEN);
+
+	switch (telemetry_node) {
+		case USB:
+			NodeUSB.sendPacket(TELEMETRY_ADDR, 0, TELEMETRY_PUSH_CMD, TELEMETRY_LEN, telemetry_frame);
+			break;
+		case BLE:
+			NodeBlue.sendPacket(TELEMETRY_ADDR, 0, TELEMETRY_PUSH_CMD, TELEMETRY_LEN, telemetry_frame);
+			break;
+		default:
+			break;
+	}
+}
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""
+gen_sketch.py - Build a single C++ translation unit from the Motion Engine sketch
+
+Does what the Arduino IDE does before it compiles a sketch: the main .ino
+goes first, the other tabs follow in alphabetical order, and a prototype
+for every function defined in them is inserted ahead of the first function
+definition. #line directives keep compiler errors pointing at the .ino files.
+
+Prototypes are found on the preprocessed sketch, so functions in inactive
+#if branches (other DFMoco boards) are left out, as they are on the board.
+
+Usage: gen_sketch.py <sketch dir> <output .cpp> -- <preprocessor command...>
+
+The preprocessor command is run with the concatenated sketch on stdin and
+must write the preprocessed text (with line markers) to stdout, for example
+"g++ -E -x c++ -Iinclude -".
+"""
+
+import os
+import re
+import subprocess
+import sys
+
+MAIN = "Motion_Engine.ino"
+
+# Statements that open a brace at file scope without being functions
+NOT_FUNCTIONS = ("struct", "class", "union", "enum", "namespace", "typedef", "extern", "template")
+
+
+def sketch_files(p_dir):
+    others = sorted(f for f in os.listdir(p_dir) if f.endswith(".ino") and f != MAIN)
+    return [MAIN] + others
+
+
+def concatenate(p_dir, p_files):
+    parts = []
+    for name in p_files:
+        path = os.path.abspath(os.path.join(p_dir, name))
+        with open(path) as f:
+            text = f.read()
+        parts.append('#line 1 "%s"\n%s\n' % (path, text))
+    return "".join(parts)
+
+
+def blank(p_text):
+    """ Replaces comments and string/char literals with spaces, keeping offsets. """
+    out = list(p_text)
+    i = 0
+    n = len(p_text)
+    while i < n:
+        c = p_text[i]
+        nxt = p_text[i + 1] if i + 1 < n else ""
+        if c == "/" and nxt == "/":
+            j = p_text.find("\n", i)
+            j = n if j < 0 else j
+        elif c == "/" and nxt == "*":
+            j = p_text.find("*/", i + 2)
+            j = n if j < 0 else j + 2
+        elif c in "\"'":
+            j = i + 1
+            while j < n and p_text[j] != c:
+                j += 2 if p_text[j] == "\\" else 1
+            j += 1
+        else:
+            i += 1
+            continue
+        for k in range(i, min(j, n)):
+            if out[k] != "\n":
+                out[k] = " "
+        i = j
+    return "".join(out)
+
+
+def strip_defaults(p_params):
+    """ Drops default arguments from a parameter list. """
+    out = []
+    depth = 0
+    skipping = False
+    for c in p_params:
+        if c in "([{<":
+            depth += 1
+        elif c in ")]}>":
+            depth -= 1
+        if depth == 0 and c == ",":
+            skipping = False
+        elif depth == 0 and c == "=":
+            skipping = True
+            continue
+        if not skipping:
+            out.append(c)
+    return "".join(out)
+
+
+def find_functions(p_text, p_sketch):
+    """
+    Returns (signature, file, line) for each function defined at file scope in
+    preprocessed text, only for code that came from the sketch's .ino files.
+    """
+    text = blank(p_text)
+    found = []
+    depth = 0
+    start = 0
+    cur_file = ""
+    cur_line = 1
+    line_at = []        # (offset, file, line) for every line start
+    pos = 0
+    for raw in text.split("\n"):
+        m = re.match(r'\s*#\s*(?:line\s+)?(\d+)\s+"([^"]*)"', p_text[pos:pos + len(raw)])
+        if m:
+            cur_line = int(m.group(1)) - 1
+            cur_file = m.group(2)
+            line_at.append((pos, None, 0))
+        else:
+            line_at.append((pos, cur_file, cur_line))
+        cur_line += 1
+        pos += len(raw) + 1
+
+    # Blank out the line markers themselves
+    chars = list(text)
+    for off, f, _ in line_at:
+        if f is None:
+            k = off
+            while k < len(chars) and chars[k] != "\n":
+                chars[k] = " "
+                k += 1
+    text = "".join(chars)
+
+    def where(p_off):
+        lo, hi = 0, len(line_at) - 1
+        while lo < hi:
+            mid = (lo + hi + 1) // 2
+            if line_at[mid][0] <= p_off:
+                lo = mid
+            else:
+                hi = mid - 1
+        return line_at[lo][1], line_at[lo][2]
+
+    for i, c in enumerate(text):
+        if c == "{":
+            if depth == 0:
+                seg = text[start:i]
+                stmt = " ".join(seg.split())
+                fname, fline = where(start + len(seg) - len(seg.lstrip()))
+                m = re.match(r"^(.*?)\b(\w+)\s*\((.*)\)\s*(const)?$", stmt, re.S)
+                if (m and fname in p_sketch and not stmt.startswith(NOT_FUNCTIONS)
+                        and "=" not in m.group(1) and m.group(1).strip()
+                        and m.group(2) not in ("if", "while", "for", "switch")):
+                    sig = "%s%s(%s)" % (m.group(1), m.group(2), strip_defaults(m.group(3)))
+                    found.append((" ".join(sig.split()), fname, fline))
+            depth += 1
+        elif c == "}":
+            depth -= 1
+            if depth == 0:
+                start = i + 1
+        elif c == ";" and depth == 0:
+            start = i + 1
+    return found
+
+
+def first_function_line(p_dir, p_functions):
+    """ File and line of the first function definition of the main file. """
+    main = os.path.abspath(os.path.join(p_dir, MAIN))
+    lines = [l for f, l in ((f, l) for _, f, l in p_functions) if f == main]
+    return main, min(lines)
+
+
+def main():
+    if len(sys.argv) < 4 or sys.argv[3] != "--":
+        sys.stderr.write(__doc__)
+        return 2
+
+    sketch_dir, out_path, cpp = sys.argv[1], sys.argv[2], sys.argv[4:]
+    files = sketch_files(sketch_dir)
+    paths = set(os.path.abspath(os.path.join(sketch_dir, f)) for f in files)
+    source = concatenate(sketch_dir, files)
+
+    pre = subprocess.run(cpp, input=source, capture_output=True, text=True)
+    if pre.returncode != 0:
+        sys.stderr.write(pre.stderr)
+        return pre.returncode
+
+    functions = find_functions(pre.stdout, paths)
+
+    seen = set()
+    protos = []
+    for sig, _, _ in functions:
+        if sig not in seen:
+            seen.add(sig)
+            protos.append(sig + ";")
+
+    # Insert the prototypes ahead of the first function of the main file
+    main_path, line = first_function_line(sketch_dir, functions)
+    out = []
+    for name in files:
+        path = os.path.abspath(os.path.join(sketch_dir, name))
+        with open(path) as f:
+            lines = f.read().split("\n")
+        if path == main_path:
+            out.append('#line 1 "%s"' % path)
+            out.extend(lines[:line - 1])
+            out.append("// Prototypes, as generated by the Arduino IDE")
+            out.extend(protos)
+            out.append('#line %d "%s"' % (line, path))
+            out.extend(lines[line - 1:])
+        else:
+            out.append('#line 1 "%s"' % path)
+            out.extend(lines)
+
+    with open(out_path, "w") as f:
+        f.write('#include <Arduino.h>\n')
+        f.write("\n".join(out))
+        f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
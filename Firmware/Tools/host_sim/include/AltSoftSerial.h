@@ -0,0 +1,18 @@
+/*
+
+  AltSoftSerial.h - host stand-in, the Bluetooth module's serial port
+
+*/
+
+#ifndef _SIM_ALTSOFTSERIAL_h
+#define _SIM_ALTSOFTSERIAL_h
+
+#include <Arduino.h>
+
+class AltSoftSerial : public SimSerial {
+
+public:
+	AltSoftSerial() : SimSerial("ble") {}
+};
+
+#endif
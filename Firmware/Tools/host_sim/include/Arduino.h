@@ -0,0 +1,222 @@
+/*
+
+  Arduino.h - host stand-in for the Arduino core
+
+  Just enough of the core, avr-libc and the AT90USB1287 registers for the
+  Motion Engine sketch to build and run on the host. Time, ports and
+  interrupts are simulated by sim_core.cpp, see ../README.txt.
+
+*/
+
+#ifndef _SIM_ARDUINO_h
+#define _SIM_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "binary.h"
+
+typedef uint8_t		byte;
+typedef bool		boolean;
+typedef unsigned int	word;
+
+#define HIGH		0x1
+#define LOW			0x0
+
+#define INPUT		0x0
+#define OUTPUT		0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE		1
+#define FALLING		2
+#define RISING		3
+
+#define DEC			10
+#define HEX			16
+#define OCT			8
+#define BIN			2
+
+#define PI			3.1415926535897932384626433832795
+
+#define min(a,b)		((a)<(b)?(a):(b))
+#define max(a,b)		((a)>(b)?(a):(b))
+#define abs(x)			((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define sq(x)			((x)*(x))
+
+#define lowByte(w)		((uint8_t) ((w) & 0xff))
+#define highByte(w)		((uint8_t) ((w) >> 8))
+#define bitRead(value, bit)	(((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)	((value) |= (1UL << (bit)))
+#define bitClear(value, bit)	((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define bit(b)			(1UL << (b))
+#define _BV(b)			(1 << (b))
+
+
+/*  ================================
+    avr-libc
+    ===============================*/
+
+#define PROGMEM
+#define PSTR(s)					(s)
+#define PGM_P					const char*
+#define pgm_read_byte(p)		(*(const uint8_t*)(p))
+#define pgm_read_word(p)		sim_pgm_read_word(p)
+#define pgm_read_dword(p)		(*(const uint32_t*)(p))
+#define pgm_read_float(p)		(*(const float*)(p))
+#define pgm_read_ptr(p)			(*(void* const*)(p))
+#define strcpy_P				strcpy
+#define strlen_P				strlen
+#define strcmp_P				strcmp
+#define memcpy_P				memcpy
+
+	// Tables of pointers are read with pgm_read_word() on the AVR, where a
+	// pointer is a word. Hand back the whole pointer on the host.
+template <typename T>
+inline uintptr_t sim_pgm_read_word(T* const* p_addr) { return (uintptr_t) *p_addr; }
+inline uint16_t sim_pgm_read_word(const void* p_addr) { return *(const uint16_t*) p_addr; }
+
+class __FlashStringHelper;
+#define F(s)					(reinterpret_cast<const __FlashStringHelper*>(s))
+
+	// Status register, only the interrupt flag (bit 7) means anything
+struct SimSreg {
+	operator uint8_t() const;
+	SimSreg& operator=(uint8_t p_val);
+};
+
+extern SimSreg SREG;
+
+void sim_cli();
+void sim_sei();
+
+#define cli()					sim_cli()
+#define sei()					sim_sei()
+#define interrupts()			sim_sei()
+#define noInterrupts()			sim_cli()
+
+
+/*  ================================
+    Registers
+    ===============================*/
+
+ // An I/O port, which reports the step pulses written to it
+struct SimPort {
+	volatile uint8_t value;
+	uint8_t index;
+
+	operator uint8_t() const { return value; }
+	SimPort& operator=(uint8_t p_val);
+	SimPort& operator|=(uint8_t p_val) { return *this = value | p_val; }
+	SimPort& operator&=(uint8_t p_val) { return *this = value & p_val; }
+	SimPort& operator^=(uint8_t p_val) { return *this = value ^ p_val; }
+};
+
+extern SimPort sim_port[6];
+extern volatile uint8_t sim_ddr[6];
+extern volatile uint8_t sim_pin[6];
+
+#define PORTA	sim_port[0]
+#define PORTB	sim_port[1]
+#define PORTC	sim_port[2]
+#define PORTD	sim_port[3]
+#define PORTE	sim_port[4]
+#define PORTF	sim_port[5]
+
+#define DDRA	sim_ddr[0]
+#define DDRB	sim_ddr[1]
+#define DDRC	sim_ddr[2]
+#define DDRD	sim_ddr[3]
+#define DDRE	sim_ddr[4]
+#define DDRF	sim_ddr[5]
+
+#define PINA	sim_pin[0]
+#define PINB	sim_pin[1]
+#define PINC	sim_pin[2]
+#define PIND	sim_pin[3]
+#define PINE	sim_pin[4]
+#define PINF	sim_pin[5]
+
+#define PORTF0	0
+#define PORTF1	1
+#define PORTF2	2
+#define PORTF3	3
+#define PORTF4	4
+#define PORTF5	5
+#define PORTF6	6
+#define PORTF7	7
+
+	// Timer1, phase and frequency correct, as TimerOne runs it
+uint16_t sim_timer1_count();
+uint16_t sim_timer1_top();
+
+	// Timer1 interrupt flags, cleared by writing a one
+struct SimTifr {
+	operator uint8_t() const;
+	SimTifr& operator=(uint8_t p_val);
+};
+
+extern SimTifr sim_tifr1;
+
+#define TCNT1	(sim_timer1_count())
+#define ICR1	(sim_timer1_top())
+#define TIFR1	sim_tifr1
+
+#define TOV1	0
+#define OCF1A	1
+#define OCF1B	2
+#define OCF1C	3
+#define ICF1	5
+
+	// Top of the host's data segment, for the free memory report
+extern char _end;
+#define RAMEND	((uintptr_t)&_end - 1)
+
+
+/*  ================================
+    Pins
+    ===============================*/
+
+	// Pin p is bit p % 8 of port p / 8, which puts the step pins on PORTF
+#define digitalPinToPort(p)			((p) >> 3)
+#define digitalPinToBitMask(p)		((uint8_t)(1 << ((p) & 7)))
+#define portOutputRegister(p)		(&sim_port[(p)].value)
+#define portInputRegister(p)		(&sim_pin[(p)])
+
+#define A0	38
+#define A1	39
+#define A2	40
+#define A3	41
+
+void pinMode(uint8_t p_pin, uint8_t p_mode);
+void digitalWrite(uint8_t p_pin, uint8_t p_val);
+int digitalRead(uint8_t p_pin);
+int analogRead(uint8_t p_pin);
+void attachInterrupt(uint8_t p_int, void (*p_func)(), int p_mode);
+void detachInterrupt(uint8_t p_int);
+
+
+/*  ================================
+    Time
+    ===============================*/
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long p_ms);
+void delayMicroseconds(unsigned int p_us);
+
+long random(long p_max);
+long random(long p_min, long p_max);
+void randomSeed(unsigned long p_seed);
+
+#include "Print.h"
+#include "WString.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+
+#endif
@@ -0,0 +1,10 @@
+/*
+
+  CubicBezier.h - host stand-in, the sketch includes it but uses nothing from it
+
+*/
+
+#ifndef _SIM_CUBICBEZIER_h
+#define _SIM_CUBICBEZIER_h
+
+#endif
@@ -0,0 +1,30 @@
+/*
+
+  EEPROM.h - host stand-in, 4K of EEPROM that reads 0xFF until written
+
+*/
+
+#ifndef _SIM_EEPROM_h
+#define _SIM_EEPROM_h
+
+#include <Arduino.h>
+
+#define E2END	0xFFF
+
+	// Writes complete at once
+#define eeprom_is_ready()	(1)
+
+class EEPROMClass {
+
+	uint8_t m_data[E2END + 1];
+
+public:
+	EEPROMClass() { memset(m_data, 0xFF, sizeof(m_data)); }
+
+	uint8_t read(int p_addr) { return m_data[p_addr & E2END]; }
+	void write(int p_addr, uint8_t p_val) { m_data[p_addr & E2END] = p_val; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
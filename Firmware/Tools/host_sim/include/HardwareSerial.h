@@ -0,0 +1,63 @@
+/*
+
+  HardwareSerial.h - host stand-in for the board's serial ports
+
+  Every port is a SimSerial. Bytes the harness feeds in are read back by
+  the sketch, and everything the sketch writes is kept for the report.
+  availableForWrite() reports the room left in a 64 byte transmit buffer
+  that drains at the port's baud rate, so code that paces its output on it
+  sees the same back-pressure as on the board.
+
+*/
+
+#ifndef _SIM_HARDWARESERIAL_h
+#define _SIM_HARDWARESERIAL_h
+
+#include <stdint.h>
+#include "Stream.h"
+
+class SimSerial : public Stream {
+
+	const char*		m_name;
+	unsigned long	m_baud;
+	uint8_t			m_rx[256];
+	uint8_t			m_rxHead;
+	uint8_t			m_rxTail;
+	uint8_t*		m_tx;
+	size_t			m_txLen;
+	size_t			m_txSize;
+	uint64_t		m_txFreeAt;			// Simulated time the transmit buffer is empty
+
+public:
+	SimSerial* next;
+
+	SimSerial(const char* p_name);
+
+	void begin(unsigned long p_baud);
+	void end() {}
+	operator bool() { return true; }
+
+	int available();
+	int read();
+	int peek();
+	int availableForWrite();
+	size_t write(uint8_t p_byte);
+	using Print::write;
+
+	// Harness side
+	const char* name() const { return m_name; }
+	bool feed(uint8_t p_byte);
+	const uint8_t* output() const { return m_tx; }
+	size_t outputLength() const { return m_txLen; }
+	void clearOutput() { m_txLen = 0; }
+
+	static SimSerial* find(const char* p_name);
+};
+
+	// MoCoBus (RS485), and the USB CDC port
+extern SimSerial Serial;
+extern SimSerial USBSerial;
+
+typedef SimSerial HardwareSerial;
+
+#endif
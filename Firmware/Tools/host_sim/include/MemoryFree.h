@@ -0,0 +1,12 @@
+/*
+
+  MemoryFree.h - host stand-in
+
+*/
+
+#ifndef _SIM_MEMORYFREE_h
+#define _SIM_MEMORYFREE_h
+
+int freeMemory();
+
+#endif
@@ -0,0 +1,16 @@
+/*
+
+  MsTimer2.h - host stand-in, runs its callback as a simulated interrupt
+
+*/
+
+#ifndef _SIM_MSTIMER2_h
+#define _SIM_MSTIMER2_h
+
+namespace MsTimer2 {
+	void set(unsigned long p_ms, void (*p_func)());
+	void start();
+	void stop();
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+
+  OMCamera.h - host stand-in for the OpenMoCo camera library
+
+  Focus, exposure and post-exposure delay are timed on MsTimer2 and signal
+  the sketch's handler when they begin and end, as the library does (see
+  the library code kept in OM_CameraMaster.ino).
+
+*/
+
+#ifndef _SIM_OMCAMERA_h
+#define _SIM_OMCAMERA_h
+
+#include <Arduino.h>
+
+#define OM_CAMFOC		1
+#define OM_CAMEXP		2
+#define OM_CAMWAIT		3
+#define OM_CAM_FFIN		4
+#define OM_CAM_EFIN		5
+#define OM_CAM_WFIN		6
+
+#define OM_CAM_INFOC	1
+#define OM_CAM_INEXP	2
+#define OM_CAM_INDLY	3
+
+class OMCamera {
+
+	static bool		s_debug;
+	static uint8_t	s_curAct;
+	static bool		s_busy;
+	static void		(*f_camSignal)(uint8_t);
+
+	unsigned long	m_interval;
+	unsigned long	m_trigger;
+	unsigned int	m_focus;
+	unsigned int	m_delay;
+	unsigned int	m_maxShots;
+	uint8_t			m_expFocus;
+
+	static void start(uint8_t p_act, uint8_t p_signal, uint8_t p_done, unsigned long p_time);
+
+public:
+	bool	enable;
+	uint8_t	repeat;
+
+	OMCamera();
+
+	static void debugOutput(bool p_state) { s_debug = p_state; }
+	static void stop();
+
+	void setHandler(void (*p_func)(uint8_t)) { f_camSignal = p_func; }
+	bool busy() { return s_busy; }
+
+	void expose();
+	void expose(unsigned long p_time);
+	void focus();
+	void wait();
+
+	unsigned long intervalTime() { return m_interval; }
+	void intervalTime(unsigned long p_time) { m_interval = p_time; }
+	unsigned long triggerTime() { return m_trigger; }
+	void triggerTime(unsigned long p_time) { m_trigger = p_time; }
+	unsigned int focusTime() { return m_focus; }
+	void focusTime(unsigned int p_time) { m_focus = p_time; }
+	unsigned int delayTime() { return m_delay; }
+	void delayTime(unsigned int p_time) { m_delay = p_time; }
+	uint8_t exposureFocus() { return m_expFocus; }
+	void exposureFocus(uint8_t p_focus) { m_expFocus = p_focus; }
+	unsigned int getMaxShots() { return m_maxShots; }
+	void setMaxShots(unsigned int p_shots) { m_maxShots = p_shots; }
+};
+
+#endif
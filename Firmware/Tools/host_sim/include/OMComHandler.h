@@ -0,0 +1,33 @@
+/*
+
+  OMComHandler.h - host stand-in for the OpenMoCo common line handler
+
+  A single node is always its own master, the common lines are not
+  simulated.
+
+*/
+
+#ifndef _SIM_OMCOMHANDLER_h
+#define _SIM_OMCOMHANDLER_h
+
+#include <Arduino.h>
+
+class OMComHandler {
+
+	bool		m_master;
+	uint8_t		m_watch;
+	void		(*f_watch)(unsigned int);
+
+public:
+	OMComHandler() : m_master(true), m_watch(0), f_watch(0) {}
+
+	bool master() { return m_master; }
+	void master(bool p_master) { m_master = p_master; }
+	void watchHandler(void (*p_func)(unsigned int)) { f_watch = p_func; }
+	void watch(uint8_t p_line) { m_watch = p_line; }
+	void stopWatch() { m_watch = 0; }
+	bool slaveClear() { return false; }
+	void masterSignal() {}
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+
+  OMEEPROM.h - host stand-in for the OpenMoCo EEPROM helpers
+
+  The first OFFSET bytes hold a saved marker and the sketch's memory
+  version, the sketch's addresses start after them.
+
+*/
+
+#ifndef _SIM_OMEEPROM_h
+#define _SIM_OMEEPROM_h
+
+#include <EEPROM.h>
+
+namespace OMEEPROM {
+
+	const int OFFSET		= 3;
+	const uint8_t SAVED		= 0x5A;
+
+	inline bool saved() { return EEPROM.read(0) == SAVED; }
+	inline unsigned int version() { return EEPROM.read(1) | (EEPROM.read(2) << 8); }
+
+	inline void version(unsigned int p_version) {
+		EEPROM.write(0, SAVED);
+		EEPROM.write(1, p_version & 0xFF);
+		EEPROM.write(2, p_version >> 8);
+	}
+
+	template <typename T>
+	void write(int p_pos, const T& p_val, int p_count = 1) {
+		const uint8_t* src = (const uint8_t*) &p_val;
+		for (unsigned int i = 0; i < sizeof(T) * p_count; i++)
+			EEPROM.write(OFFSET + p_pos + i, src[i]);
+	}
+
+	template <typename T>
+	void read(int p_pos, T& p_val, int p_count = 1) {
+		uint8_t* dst = (uint8_t*) &p_val;
+		for (unsigned int i = 0; i < sizeof(T) * p_count; i++)
+			dst[i] = EEPROM.read(OFFSET + p_pos + i);
+	}
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+
+  OMMoCoBus.h - host stand-in for the OpenMoCo MoCoBus library
+
+  A packet is a header of five 0x00 bytes and one 0xFF, then the address,
+  sub-address, command, data length and data:
+
+	00 00 00 00 00 FF <addr> <subaddr> <command> <len> <data...>
+
+  Responses are packets to address 0, with the status as the sub-address
+  and the data type as the command. Data is in network (big-endian) order:
+
+	00 00 00 00 00 FF 00 <status> <type> <len> <data...>
+
+  The response layout and the command values below are the stand-in's
+  own; the sketch only depends on the names.
+
+*/
+
+#ifndef _SIM_OMMOCOBUS_h
+#define _SIM_OMMOCOBUS_h
+
+#include <Arduino.h>
+
+#define OM_SER_BPS				19200
+#define OM_SER_BCAST_ADDR		1
+#define OM_SER_MASTER_ADDR		0
+#define OM_SER_BUFLEN			128
+
+	// Broadcast commands
+#define OM_BCAST_START			1
+#define OM_BCAST_STOP			2
+#define OM_BCAST_PAUSE			3
+#define OM_BCAST_SET_ADDRESS	4
+#define OM_GRAFFIK_MODE_USB		5
+#define OM_BCAST_KF_START		6
+#define OM_BCAST_KF_STOP		7
+#define OM_BCAST_KF_PAUSE		8
+#define OM_BCAST_GET_ADDRESS	9
+
+	// Response data types
+#define OM_RES_NONE				0
+#define OM_RES_BYTE				1
+#define OM_RES_UINT				2
+#define OM_RES_INT				3
+#define OM_RES_ULONG			4
+#define OM_RES_LONG				5
+#define OM_RES_FLOAT			6
+#define OM_RES_STRING			7
+
+class OMMoCoBus {
+
+protected:
+	Stream*		m_stream;
+	uint8_t		m_address;
+
+	void writeHeader();
+
+public:
+	OMMoCoBus(Stream* p_stream, uint8_t p_address);
+
+	uint8_t address() { return m_address; }
+	void address(uint8_t p_address) { m_address = p_address; }
+
+	void sendPacket(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_command, uint8_t p_len, uint8_t* p_data);
+	void sendPacket(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_command) { sendPacket(p_addr, p_subaddr, p_command, 0, 0); }
+
+	static int ntoi(uint8_t* p_buf);
+	static unsigned int ntoui(uint8_t* p_buf);
+	static long ntol(uint8_t* p_buf);
+	static unsigned long ntoul(uint8_t* p_buf);
+	static float ntof(uint8_t* p_buf);
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+
+  OMMoCoNode.h - host stand-in for the OpenMoCo MoCoBus node
+
+  check() parses whole packets out of the node's stream and passes them
+  to the handler for this address, the broadcast handler or the not-us
+  handler, as the library does.
+
+*/
+
+#ifndef _SIM_OMMOCONODE_h
+#define _SIM_OMMOCONODE_h
+
+#include "OMMoCoBus.h"
+
+class OMMoCoNode : public OMMoCoBus {
+
+	void (*f_handler)(uint8_t, uint8_t, uint8_t*);
+	void (*f_notUs)(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t*);
+	void (*f_bcast)(uint8_t, uint8_t, uint8_t*);
+	void (*f_addr)(uint8_t);
+
+	unsigned int	m_version;
+	const char*		m_id;
+	uint8_t			m_buf[OM_SER_BUFLEN + 10];
+	uint8_t			m_got;
+
+	void respond(uint8_t p_stat, uint8_t p_type, const uint8_t* p_data, uint8_t p_len);
+
+public:
+	OMMoCoNode(Stream* p_stream, uint8_t p_address, unsigned int p_version, char* p_id);
+
+	using OMMoCoBus::address;
+
+	void check();
+	void setHandler(void (*p_func)(uint8_t, uint8_t, uint8_t*)) { f_handler = p_func; }
+	void setNotUsHandler(void (*p_func)(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t*)) { f_notUs = p_func; }
+	void setBCastHandler(void (*p_func)(uint8_t, uint8_t, uint8_t*)) { f_bcast = p_func; }
+	void addressCallback(void (*p_func)(uint8_t)) { f_addr = p_func; }
+	void setSoftSerial(bool) {}
+
+	void response(uint8_t p_stat);
+	void response(uint8_t p_stat, uint8_t p_resp);
+	void response(uint8_t p_stat, unsigned int p_resp);
+	void response(uint8_t p_stat, int p_resp);
+	void response(uint8_t p_stat, unsigned long p_resp);
+	void response(uint8_t p_stat, long p_resp);
+	void response(uint8_t p_stat, float p_resp);
+	void response(uint8_t p_stat, char* p_resp, int p_len);
+
+	size_t write(uint8_t p_byte) { return m_stream->write(p_byte); }
+};
+
+#endif
@@ -0,0 +1,12 @@
+/*
+
+  OMMotor.h - host stand-in
+
+*/
+
+#ifndef _SIM_OMMOTOR_h
+#define _SIM_OMMOTOR_h
+
+#include "OMMotorFunctions.h"
+
+#endif
@@ -0,0 +1,169 @@
+/*
+
+  OMMotorFunctions.h - host stand-in for the OpenMoCo stepper motor library
+
+  Models what the sketch relies on: a motor that, asked once per step ISR
+  tick through checkStep(), says when it is due a step. Point moves run a
+  trapezoid at contSpeed()/contAccel(), continuous moves ramp towards
+  contSpeed(), and program moves approximate the library's plans. It does
+  not reproduce the library's easing curves.
+
+*/
+
+#ifndef _SIM_OMMOTORFUNCTIONS_h
+#define _SIM_OMMOTORFUNCTIONS_h
+
+#include <Arduino.h>
+
+#define INCH		0
+#define CM			1
+#define DEG			2
+
+class OMMotorFunctions {
+
+	enum { MODE_IDLE, MODE_MOVE, MODE_CONT };
+
+	static uint8_t	s_planType;
+	static bool		s_debug;
+
+	uint8_t		m_mode;
+	bool		m_enable;
+	bool		m_sleep;
+	bool		m_dir;
+	bool		m_continuous;
+	bool		m_sending;
+	bool		m_backCheck;
+	bool		m_programDone;
+	uint8_t		m_ms;
+	uint8_t		m_lastMs;
+	uint8_t		m_backlash;
+	uint8_t		m_easing;
+	uint8_t		m_units;
+	unsigned int m_maxSpeed;
+	unsigned int m_maxStepRate;
+	float		m_contSpeed;
+	float		m_contAccel;
+	float		m_gbox;
+	float		m_plat;
+
+	long		m_pos;
+	long		m_startPos;
+	long		m_stopPos;
+	long		m_endPos;
+	long		m_maxSteps;
+	unsigned long m_leadIn;
+	unsigned long m_travel;
+	unsigned long m_leadOut;
+	unsigned long m_accelLen;
+	unsigned long m_decelLen;
+
+	// Motion state
+	unsigned long m_left;		// Steps left in a point move
+	float		m_vel;			// Current speed, steps/s, always positive
+	float		m_top;			// Point move top speed
+	float		m_accel;		// Point move acceleration, steps/s^2, 0 for none
+	float		m_decel;
+	float		m_phase;		// Fraction of a step owed
+
+	void startMove(bool p_dir, unsigned long p_steps, float p_top, float p_accel, float p_decel);
+
+public:
+	uint8_t		stpflg;
+	uint8_t		mt_plan;
+	bool		autoPause;
+
+	OMMotorFunctions(int p_step, int p_dir, int p_slp, int p_ms1, int p_ms2, int p_ms3, uint8_t p_stpreg, uint8_t p_stpflg);
+
+	static void debugOutput(bool p_state) { s_debug = p_state; }
+	static uint8_t planType() { return s_planType; }
+	static void planType(uint8_t p_type) { s_planType = p_type; }
+
+	// Settings
+	bool enable() { return m_enable; }
+	void enable(bool p_en) { m_enable = p_en; }
+	bool sleep() { return m_sleep; }
+	void sleep(bool p_sleep) { m_sleep = p_sleep; }
+	bool dir() { return m_dir; }
+	void dir(bool p_dir) { m_dir = p_dir; }
+	bool continuous() { return m_continuous; }
+	void continuous(bool p_cont) { m_continuous = p_cont; }
+	uint8_t ms() { return m_ms; }
+	void ms(uint8_t p_ms) { m_lastMs = m_ms; m_ms = p_ms; }
+	uint8_t lastMs() { return m_lastMs; }
+	void restoreLastMs() { m_ms = m_lastMs; }
+	uint8_t backlash() { return m_backlash; }
+	void backlash(uint8_t p_back) { m_backlash = p_back; }
+	uint8_t easing() { return m_easing; }
+	void easing(uint8_t p_easing) { m_easing = p_easing; }
+	uint8_t units() { return m_units; }
+	void units(uint8_t p_units) { m_units = p_units; }
+	float gboxRatio() { return m_gbox; }
+	void gboxRatio(float p_ratio) { m_gbox = p_ratio; }
+	float platRatio() { return m_plat; }
+	void platRatio(float p_ratio) { m_plat = p_ratio; }
+	bool programBackCheck() { return m_backCheck; }
+	void programBackCheck(bool p_check) { m_backCheck = p_check; }
+	unsigned int maxSpeed() { return m_maxSpeed; }
+	void maxSpeed(unsigned int p_speed) { m_maxSpeed = p_speed; }
+	uint8_t maxStepRate(unsigned int p_rate);
+	unsigned int maxStepRate() { return m_maxStepRate; }
+	unsigned long curSamplePeriod() { return 1000000UL / m_maxStepRate; }
+	float contSpeed() { return m_contSpeed; }
+	void contSpeed(float p_speed);
+	float contAccel() { return m_contAccel; }
+	void contAccel(float p_accel) { m_contAccel = p_accel; }
+	void maxSteps(long p_steps) { m_maxSteps = p_steps; }
+	bool isSending() { return m_sending; }
+	void setSending(bool p_sending) { m_sending = p_sending; }
+
+	// Positions
+	long currentPos() { return m_pos; }
+	void currentPos(long p_pos) { m_pos = p_pos; }
+	long startPos() { return m_startPos; }
+	void startPos(long p_pos) { m_startPos = p_pos; }
+	long stopPos() { return m_stopPos; }
+	void stopPos(long p_pos) { m_stopPos = p_pos; }
+	long endPos() { return m_endPos; }
+	void endPos(long p_pos) { m_endPos = p_pos; }
+	void homeSet() { m_pos = 0; }
+
+	// Program plan
+	unsigned long planLeadIn() { return m_leadIn; }
+	void planLeadIn(unsigned long p_len) { m_leadIn = p_len; }
+	unsigned long planTravelLength() { return m_travel; }
+	void planTravelLength(unsigned long p_len) { m_travel = p_len; }
+	unsigned long planLeadOut() { return m_leadOut; }
+	void planLeadOut(unsigned long p_len) { m_leadOut = p_len; }
+	unsigned long planAccelLength() { return m_accelLen; }
+	void planAccelLength(unsigned long p_len) { m_accelLen = p_len; }
+	unsigned long planDecelLength() { return m_decelLen; }
+	void planDecelLength(unsigned long p_len) { m_decelLen = p_len; }
+	bool programDone() { return m_programDone; }
+	void programDone(bool p_done) { m_programDone = p_done; }
+	void planRun();
+	void planReverse();
+	void programMove();
+	void resetProgramMove() { m_programDone = false; }
+	void resumeMove() {}
+	void updateSpline() {}
+	float getTopSpeed();
+	float desiredSpeed();
+
+	// Moves
+	bool running() { return m_mode != MODE_IDLE; }
+	void move(bool p_dir, unsigned long p_steps);
+	void move(bool p_dir, unsigned long p_steps, unsigned long p_time, unsigned long p_accel, unsigned long p_decel);
+	void moveTo(long p_pos, bool p_send = false);
+	void moveToStart() { moveTo(m_startPos, true); }
+	void moveToStop() { moveTo(m_stopPos, true); }
+	void moveToEnd() { moveTo(m_endPos, true); }
+	void home() { moveTo(0, true); }
+	void stop();
+	void clear();
+
+	// Step ISR
+	void checkRefresh() {}
+	bool checkStep();
+};
+
+#endif
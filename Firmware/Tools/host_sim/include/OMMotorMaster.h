@@ -0,0 +1,16 @@
+/*
+
+  OMMotorMaster.h - host stand-in
+
+  The sketch keeps its own copy of the library header, with the motor pin
+  assignments, as OM_MotorMaster.h.
+
+*/
+
+#ifndef _SIM_OMMOTORMASTER_h
+#define _SIM_OMMOTORMASTER_h
+
+#include "OMMotorFunctions.h"
+#include "OM_MotorMaster.h"
+
+#endif
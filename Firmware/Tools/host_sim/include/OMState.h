@@ -0,0 +1,27 @@
+/*
+
+  OMState.h - host stand-in for the OpenMoCo state engine
+
+*/
+
+#ifndef _SIM_OMSTATE_h
+#define _SIM_OMSTATE_h
+
+#include <Arduino.h>
+
+class OMState {
+
+	uint8_t		m_count;
+	volatile uint8_t m_state;
+	void		(*m_handlers[16])();
+
+public:
+	OMState(uint8_t p_count);
+
+	void setHandler(uint8_t p_state, void (*p_func)());
+	uint8_t state() { return m_state; }
+	void state(uint8_t p_state) { m_state = p_state; }
+	void checkCycle();
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+
+  Print.h - host stand-in for the Arduino Print class
+
+*/
+
+#ifndef _SIM_PRINT_h
+#define _SIM_PRINT_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class __FlashStringHelper;
+class String;
+
+class Print {
+
+	size_t printNumber(unsigned long p_n, uint8_t p_base);
+
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t) = 0;
+	virtual size_t write(const uint8_t* p_buf, size_t p_len);
+	size_t write(const char* p_str);
+	size_t write(const char* p_buf, size_t p_len) { return write((const uint8_t*)p_buf, p_len); }
+
+	size_t print(const __FlashStringHelper* p_str);
+	size_t print(const String& p_str);
+	size_t print(const char p_str[]);
+	size_t print(char p_c);
+	size_t print(unsigned char p_n, int p_base = 10);
+	size_t print(int p_n, int p_base = 10);
+	size_t print(unsigned int p_n, int p_base = 10);
+	size_t print(long p_n, int p_base = 10);
+	size_t print(unsigned long p_n, int p_base = 10);
+	size_t print(double p_n, int p_digits = 2);
+
+	size_t println(const __FlashStringHelper* p_str);
+	size_t println(const String& p_str);
+	size_t println(const char p_str[]);
+	size_t println(char p_c);
+	size_t println(unsigned char p_n, int p_base = 10);
+	size_t println(int p_n, int p_base = 10);
+	size_t println(unsigned int p_n, int p_base = 10);
+	size_t println(long p_n, int p_base = 10);
+	size_t println(unsigned long p_n, int p_base = 10);
+	size_t println(double p_n, int p_digits = 2);
+	size_t println();
+};
+
+#endif
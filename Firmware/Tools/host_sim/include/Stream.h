@@ -0,0 +1,21 @@
+/*
+
+  Stream.h - host stand-in for the Arduino Stream class
+
+*/
+
+#ifndef _SIM_STREAM_h
+#define _SIM_STREAM_h
+
+#include "Print.h"
+
+class Stream : public Print {
+
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() {}
+};
+
+#endif
@@ -0,0 +1,27 @@
+/*
+
+  TimerOne.h - host stand-in, runs its callback as a simulated interrupt
+
+  initialize() sets up the phase and frequency correct mode TimerOne uses:
+  ICR1 is half the period in timer counts and TCNT1 runs up to it and back
+  down, see sim_timer1_count().
+
+*/
+
+#ifndef _SIM_TIMERONE_h
+#define _SIM_TIMERONE_h
+
+class TimerOne {
+
+public:
+	void initialize(long p_period = 1000000);
+	void setPeriod(long p_period);
+	void attachInterrupt(void (*p_isr)(), long p_period = -1);
+	void detachInterrupt();
+	void start();
+	void stop();
+};
+
+extern TimerOne Timer1;
+
+#endif
@@ -0,0 +1,56 @@
+/*
+
+  WString.h - host stand-in for the Arduino String class
+
+  Just what the sketch's debug output needs: strings built from text and
+  numbers, joined with +, cut with substring() and printed. Text past the buffer is cut off.
+
+*/
+
+#ifndef _SIM_WSTRING_h
+#define _SIM_WSTRING_h
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Print.h"
+
+class String {
+
+	char	m_str[128];
+
+public:
+	String(const char* p_str = "") { snprintf(m_str, sizeof(m_str), "%s", p_str); }
+	String(char p_c) { snprintf(m_str, sizeof(m_str), "%c", p_c); }
+	String(unsigned char p_n) { snprintf(m_str, sizeof(m_str), "%u", p_n); }
+	String(int p_n) { snprintf(m_str, sizeof(m_str), "%d", p_n); }
+	String(unsigned int p_n) { snprintf(m_str, sizeof(m_str), "%u", p_n); }
+	String(long p_n) { snprintf(m_str, sizeof(m_str), "%ld", p_n); }
+	String(unsigned long p_n) { snprintf(m_str, sizeof(m_str), "%lu", p_n); }
+	String(double p_n) { snprintf(m_str, sizeof(m_str), "%.2f", p_n); }
+
+	const char* c_str() const { return m_str; }
+	unsigned int length() const { return strlen(m_str); }
+
+	String substring(unsigned int p_from, unsigned int p_to) const {
+		String part;
+		if (p_to > length())
+			p_to = length();
+		if (p_from < p_to)
+			snprintf(part.m_str, sizeof(part.m_str), "%.*s", (int)(p_to - p_from), m_str + p_from);
+		return part;
+	}
+
+	String& operator+=(const String& p_str) {
+		size_t len = strlen(m_str);
+		snprintf(m_str + len, sizeof(m_str) - len, "%s", p_str.m_str);
+		return *this;
+	}
+
+	friend String operator+(String p_a, const String& p_b) { return p_a += p_b; }
+};
+
+inline size_t Print::print(const String& p_str) { return write(p_str.c_str()); }
+inline size_t Print::println(const String& p_str) { return print(p_str) + println(); }
+
+#endif
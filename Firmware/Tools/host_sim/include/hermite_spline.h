@@ -0,0 +1,10 @@
+/*
+
+  hermite_spline.h - host stand-in, the sketch includes it but uses nothing from it
+
+*/
+
+#ifndef _SIM_HERMITE_SPLINE_h
+#define _SIM_HERMITE_SPLINE_h
+
+#endif
@@ -0,0 +1,74 @@
+/*
+
+  key_frames.h - host stand-in for the key frame spline library
+
+  Each axis is a cubic Hermite spline through its key frames: abscissas
+  (xn), positions (fn) and slopes (dn).
+
+*/
+
+#ifndef _SIM_KEY_FRAMES_h
+#define _SIM_KEY_FRAMES_h
+
+#include <Arduino.h>
+
+#define KF_POINTS	10
+
+class KeyFrames {
+
+	static KeyFrames*	s_axes;
+	static uint8_t		s_axisCount;
+	static uint8_t		s_axis;
+	static int			s_updateRate;
+	static unsigned long s_contVidTime;
+	static float		s_maxVel;
+	static float		s_maxAccel;
+
+	float		m_xn[KF_POINTS];
+	float		m_fn[KF_POINTS];
+	float		m_dn[KF_POINTS];
+	uint8_t		m_xnCount;
+	uint8_t		m_fnCount;
+	uint8_t		m_dnCount;
+	uint8_t		m_kfCount;
+
+	uint8_t segment(float p_x);
+
+public:
+	KeyFrames();
+
+	static void setAxisArray(KeyFrames* p_axes, uint8_t p_count) { s_axes = p_axes; s_axisCount = p_count; }
+	static uint8_t getAxisCount() { return s_axisCount; }
+	static void setAxis(uint8_t p_axis) { s_axis = p_axis; }
+	static uint8_t getAxis() { return s_axis; }
+	static int updateRate() { return s_updateRate; }
+	static void updateRate(int p_rate) { s_updateRate = p_rate; }
+	static unsigned long getContVidTime() { return s_contVidTime; }
+	static void setContVidTime(unsigned long p_time) { s_contVidTime = p_time; }
+	static void setMaxVel(float p_vel) { s_maxVel = p_vel; }
+	static void setMaxAccel(float p_accel) { s_maxAccel = p_accel; }
+
+	void setKFCount(uint8_t p_count) { m_kfCount = min((int) p_count, KF_POINTS); }
+	uint8_t getKFCount() { return m_kfCount; }
+
+	void setXN(float p_x) { if (m_xnCount < KF_POINTS) m_xn[m_xnCount++] = p_x; }
+	void setFN(float p_f) { if (m_fnCount < KF_POINTS) m_fn[m_fnCount++] = p_f; }
+	void setDN(float p_d) { if (m_dnCount < KF_POINTS) m_dn[m_dnCount++] = p_d; }
+	float getXN(uint8_t p_i) { return m_xn[p_i % KF_POINTS]; }
+	float getFN(uint8_t p_i) { return m_fn[p_i % KF_POINTS]; }
+	float getDN(uint8_t p_i) { return m_dn[p_i % KF_POINTS]; }
+	uint8_t countXN() { return m_xnCount; }
+	uint8_t countFN() { return m_fnCount; }
+	uint8_t countDN() { return m_dnCount; }
+	void resetXN() { m_xnCount = 0; }
+	void resetFN() { m_fnCount = 0; }
+	void resetDN() { m_dnCount = 0; }
+
+	float pos(float p_x);
+	float vel(float p_x);
+	float accel(float p_x);
+	bool validateVel();
+	bool validateAccel();
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+
+  sim.h - harness side of the host simulation
+
+*/
+
+#ifndef _SIM_h
+#define _SIM_h
+
+#include <stdint.h>
+
+	// Simulated time, in microseconds since reset
+uint64_t sim_now();
+
+	// Runs loop-context time forward to p_until, taking interrupts as they fall due
+void sim_advance(uint64_t p_until);
+
+	// Called around each pass of loop(), to charge the pass its (scaled) host time
+void sim_loop_begin();
+void sim_loop_end();
+
+	// Host time to simulated time: simulated us per host us, 0 for a fixed cost
+void sim_cost_scale(double p_scale);
+	// Simulated cost of a loop pass when the cost scale is 0
+void sim_loop_cost(unsigned int p_us);
+
+	// Serial input due at a given time
+void sim_queue_input(const char* p_port, uint64_t p_at, const uint8_t* p_data, unsigned int p_len);
+	// An input pin driven to a level at a given time
+void sim_queue_pin(uint8_t p_pin, uint64_t p_at, uint8_t p_level);
+
+	// Thrown in loop context once simulated time passes p_at, for code
+	// that never returns to loop()
+struct sim_stopped {};
+void sim_stop_at(uint64_t p_at);
+
+struct sim_isr_stats {
+	const char*	name;
+	unsigned long count;
+	double		host_ns_total;
+	double		host_ns_max;
+	double		sim_us_total;		// Simulated time spent in the ISR
+	double		sim_us_max;
+	double		late_us_total;		// How far after its timer event the ISR started
+	double		late_us_max;
+	unsigned long dropped;			// Timer events lost while the ISR was still pending
+};
+
+struct sim_step_stats {
+	unsigned long pulses;
+	long		position;			// Net steps, from the pulses and the direction pin
+	double		interval_min_us;
+	double		interval_max_us;
+	uint64_t	last_us;
+};
+
+const sim_isr_stats& sim_timer1_stats();
+const sim_isr_stats& sim_mstimer2_stats();
+const sim_step_stats& sim_steps(uint8_t p_motor);
+
+	// Loop pass statistics, in simulated us
+void sim_loop_stats(unsigned long& p_passes, double& p_mean, double& p_max);
+
+	// Firmware's idea of each motor's position, defined next to the sketch
+long sim_fw_position(uint8_t p_motor);
+
+#endif
@@ -0,0 +1,386 @@
+/*
+
+  main.cpp - replays a recorded command stream into the sketch and reports
+  how the step timing held up
+
+  Usage: motion_sim [options] <stream>
+
+	--cost-scale <x>	Simulated us per host us of sketch code (default 100),
+						0 for a fixed cost per loop pass
+	--loop-us <n>		Loop pass cost when the cost scale is 0 (default 20)
+	--until <ms>		Stop after this much simulated time, even if the
+						stream ends later
+	--trace				Print every packet the sketch sends
+	--dump <port>		Print everything the sketch wrote to a port, for
+						the DFMoco text protocol
+
+  Stream lines, see streams/*.txt:
+
+	<ms> <port> pkt <addr> <subaddr> <command> [data bytes, hex]
+	<ms> <port> hex <bytes, hex>
+	<ms> <port> text <text, \r and \n escapes allowed>
+	<ms> pin <pin> <0|1>
+	<ms> expect <port> <status> [data bytes, hex]
+	<ms> end
+
+  Ports are bus (MoCoBus), usb and ble. Lines must be in time order. Each
+  expect line is checked against the next response packet on its port,
+  in order; the time is ignored.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include "sim.h"
+
+void setup();
+void loop();
+
+static const uint8_t MOTORS = 3;
+
+struct expectation {
+	std::string	port;
+	uint8_t		status;
+	bool		has_data;
+	std::vector<uint8_t> data;
+	int			line;
+};
+
+static std::vector<expectation> expects;
+
+struct options {
+	double		cost_scale;
+	unsigned int loop_us;
+	double		until_ms;
+	bool		trace;
+	const char*	dump;
+	const char*	stream;
+};
+
+static void usage() {
+	fprintf(stderr, "usage: motion_sim [--cost-scale x] [--loop-us n] [--until ms] [--trace] [--dump port] <stream>\n");
+	exit(2);
+}
+
+static std::vector<std::string> split(const std::string& p_line) {
+	std::vector<std::string> out;
+	size_t i = 0;
+	while (i < p_line.size()) {
+		while (i < p_line.size() && isspace((unsigned char) p_line[i]))
+			i++;
+		size_t j = i;
+		while (j < p_line.size() && !isspace((unsigned char) p_line[j]))
+			j++;
+		if (j > i)
+			out.push_back(p_line.substr(i, j - i));
+		i = j;
+	}
+	return out;
+}
+
+static uint8_t hexByte(const std::string& p_tok, const char* p_file, int p_line) {
+	char* end;
+	unsigned long v = strtoul(p_tok.c_str(), &end, 16);
+	if (*end || v > 255) {
+		fprintf(stderr, "%s:%d: bad byte '%s'\n", p_file, p_line, p_tok.c_str());
+		exit(2);
+	}
+	return (uint8_t) v;
+}
+
+ // Queues the stream's input, returns the time it ends in ms
+static double loadStream(const char* p_path) {
+
+	FILE* f = fopen(p_path, "r");
+	if (!f) {
+		perror(p_path);
+		exit(2);
+	}
+
+	double end_ms = 0;
+	char buf[1024];
+	int line = 0;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		line++;
+		std::string s(buf);
+		size_t hash = s.find('#');
+		if (hash != std::string::npos && s.find(" text ") == std::string::npos)
+			s.erase(hash);
+
+		std::vector<std::string> tok = split(s);
+		if (tok.empty())
+			continue;
+
+		double at = atof(tok[0].c_str());
+		end_ms = at > end_ms ? at : end_ms;
+
+		if (tok.size() >= 2 && tok[1] == "end")
+			continue;
+
+		if (tok.size() >= 2 && tok[1] == "expect") {
+			if (tok.size() < 4) {
+				fprintf(stderr, "%s:%d: expected <ms> expect <port> <status> [data]\n", p_path, line);
+				exit(2);
+			}
+			expectation e;
+			e.port = tok[2];
+			e.status = (uint8_t) atoi(tok[3].c_str());
+			e.has_data = tok.size() > 4;
+			for (size_t i = 4; i < tok.size(); i++)
+				e.data.push_back(hexByte(tok[i], p_path, line));
+			e.line = line;
+			expects.push_back(e);
+			continue;
+		}
+
+		if (tok.size() >= 2 && tok[1] == "pin") {
+			if (tok.size() != 4) {
+				fprintf(stderr, "%s:%d: expected <ms> pin <pin> <level>\n", p_path, line);
+				exit(2);
+			}
+			sim_queue_pin((uint8_t) atoi(tok[2].c_str()), (uint64_t) (at * 1000), (uint8_t) atoi(tok[3].c_str()));
+			continue;
+		}
+
+		if (tok.size() < 3) {
+			fprintf(stderr, "%s:%d: expected <ms> <port> <kind> ...\n", p_path, line);
+			exit(2);
+		}
+
+		std::vector<uint8_t> data;
+
+		if (tok[2] == "pkt") {
+			if (tok.size() < 6) {
+				fprintf(stderr, "%s:%d: pkt needs address, subaddress and command\n", p_path, line);
+				exit(2);
+			}
+			static const uint8_t header[] = { 0, 0, 0, 0, 0, 0xFF };
+			data.assign(header, header + sizeof(header));
+			data.push_back((uint8_t) atoi(tok[3].c_str()));
+			data.push_back((uint8_t) atoi(tok[4].c_str()));
+			data.push_back((uint8_t) atoi(tok[5].c_str()));
+			data.push_back((uint8_t) (tok.size() - 6));
+			for (size_t i = 6; i < tok.size(); i++)
+				data.push_back(hexByte(tok[i], p_path, line));
+		}
+		else if (tok[2] == "hex") {
+			for (size_t i = 3; i < tok.size(); i++)
+				data.push_back(hexByte(tok[i], p_path, line));
+		}
+		else if (tok[2] == "text") {
+			size_t start = s.find(" text ") + 6;
+			std::string text = s.substr(start);
+			while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+				text.pop_back();
+			for (size_t i = 0; i < text.size(); i++) {
+				if (text[i] == '\\' && i + 1 < text.size()) {
+					char c = text[++i];
+					data.push_back(c == 'r' ? '\r' : c == 'n' ? '\n' : c);
+				}
+				else
+					data.push_back(text[i]);
+			}
+		}
+		else {
+			fprintf(stderr, "%s:%d: unknown kind '%s'\n", p_path, line, tok[2].c_str());
+			exit(2);
+		}
+
+		sim_queue_input(tok[1].c_str(), (uint64_t) (at * 1000), data.data(), data.size());
+	}
+
+	fclose(f);
+	return end_ms;
+}
+
+ // Prints the MoCoBus packets in a port's output, returns how many there were.
+ // Each packet's offset in the output is added to p_found, if given.
+static unsigned long packets(const char* p_port, bool p_print, std::vector<size_t>* p_found = 0) {
+
+	SimSerial* port = SimSerial::find(p_port);
+	if (!port)
+		return 0;
+
+	const uint8_t* out = port->output();
+	size_t len = port->outputLength();
+	unsigned long count = 0;
+
+	for (size_t i = 0; i + 10 <= len; i++) {
+		if (out[i] || out[i + 1] || out[i + 2] || out[i + 3] || out[i + 4] || out[i + 5] != 0xFF)
+			continue;
+		size_t data_len = out[i + 9];
+		if (i + 10 + data_len > len)
+			break;
+		if (p_found)
+			p_found->push_back(i);
+		if (p_print) {
+			printf("# %s: %u %u %u [%u]", p_port, out[i + 6], out[i + 7], out[i + 8], out[i + 9]);
+			for (size_t j = 0; j < data_len; j++)
+				printf(" %02x", out[i + 10 + j]);
+			printf("\n");
+		}
+		count++;
+		i += 9 + data_len;
+	}
+
+	return count;
+}
+
+ // Checks the expect lines against each port's responses, returns how many failed
+static unsigned long checkExpects(const char* p_stream) {
+
+	static const char* const ports[] = { "bus", "usb", "ble" };
+	unsigned long failed = 0;
+
+	for (size_t p = 0; p < sizeof(ports) / sizeof(ports[0]); p++) {
+
+		std::vector<size_t> found;
+		packets(ports[p], false, &found);
+		SimSerial* port = SimSerial::find(ports[p]);
+		size_t next = 0;
+
+		for (size_t i = 0; i < expects.size(); i++) {
+			const expectation& e = expects[i];
+			if (e.port != ports[p])
+				continue;
+
+			if (next >= found.size()) {
+				fprintf(stderr, "%s:%d: no response on %s\n", p_stream, e.line, ports[p]);
+				failed++;
+				continue;
+			}
+
+			const uint8_t* pkt = port->output() + found[next++];
+			bool ok = pkt[7] == e.status;
+			if (e.has_data)
+				ok = ok && pkt[9] == e.data.size() && !memcmp(pkt + 10, e.data.data(), e.data.size());
+
+			if (!ok) {
+				fprintf(stderr, "%s:%d: unexpected response on %s, status %u\n", p_stream, e.line, ports[p], pkt[7]);
+				failed++;
+			}
+		}
+	}
+
+	return failed;
+}
+
+static void isrReport(const sim_isr_stats& p_s, bool p_last) {
+	double n = p_s.count ? p_s.count : 1;
+	printf("    \"%s\": { \"count\": %lu, \"host_ns_mean\": %.0f, \"host_ns_max\": %.0f, "
+		"\"sim_us_mean\": %.2f, \"sim_us_max\": %.2f, \"late_us_mean\": %.2f, \"late_us_max\": %.2f, "
+		"\"dropped\": %lu }%s\n",
+		p_s.name, p_s.count, p_s.host_ns_total / n, p_s.host_ns_max,
+		p_s.sim_us_total / n, p_s.sim_us_max, p_s.late_us_total / n, p_s.late_us_max,
+		p_s.dropped, p_last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+
+	options opt = { 100, 20, 0, false, 0, 0 };
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--cost-scale") && i + 1 < argc)
+			opt.cost_scale = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--loop-us") && i + 1 < argc)
+			opt.loop_us = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--until") && i + 1 < argc)
+			opt.until_ms = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--trace"))
+			opt.trace = true;
+		else if (!strcmp(argv[i], "--dump") && i + 1 < argc)
+			opt.dump = argv[++i];
+		else if (argv[i][0] == '-' || opt.stream)
+			usage();
+		else
+			opt.stream = argv[i];
+	}
+
+	if (!opt.stream)
+		usage();
+
+	sim_cost_scale(opt.cost_scale);
+	sim_loop_cost(opt.loop_us);
+
+	double end_ms = loadStream(opt.stream);
+	if (opt.until_ms > 0)
+		end_ms = opt.until_ms;
+
+	long fw_start[MOTORS] = { 0 };
+	long pulse_start[MOTORS] = { 0 };
+
+	sim_stop_at((uint64_t) (end_ms * 1000));
+
+	try {
+		setup();
+
+		for (uint8_t i = 0; i < MOTORS; i++) {
+			fw_start[i] = sim_fw_position(i);
+			pulse_start[i] = sim_steps(i).position;
+		}
+
+		while (sim_now() < end_ms * 1000) {
+			sim_loop_begin();
+			loop();
+			sim_loop_end();
+		}
+	}
+	catch (const sim_stopped&) {
+	}
+
+	if (opt.trace) {
+		packets("bus", true);
+		packets("usb", true);
+		packets("ble", true);
+	}
+
+	if (opt.dump) {
+		SimSerial* port = SimSerial::find(opt.dump);
+		if (port)
+			fwrite(port->output(), 1, port->outputLength(), stdout);
+	}
+
+	unsigned long passes;
+	double pass_mean, pass_max;
+	sim_loop_stats(passes, pass_mean, pass_max);
+
+	printf("{\n");
+	printf("  \"stream\": \"%s\",\n", opt.stream);
+	printf("  \"sim_ms\": %.1f,\n", sim_now() / 1000.0);
+	printf("  \"cost_scale\": %g,\n", opt.cost_scale);
+	printf("  \"loop\": { \"passes\": %lu, \"us_mean\": %.2f, \"us_max\": %.2f },\n", passes, pass_mean, pass_max);
+	printf("  \"isr\": {\n");
+	isrReport(sim_timer1_stats(), false);
+	isrReport(sim_mstimer2_stats(), true);
+	printf("  },\n");
+	printf("  \"motors\": [\n");
+
+	bool missed = false;
+	for (uint8_t i = 0; i < MOTORS; i++) {
+		const sim_step_stats& s = sim_steps(i);
+		long fw_moved = sim_fw_position(i) - fw_start[i];
+		long pulse_moved = s.position - pulse_start[i];
+		long lost = fw_moved - pulse_moved;
+		missed |= (lost != 0);
+		printf("    { \"pulses\": %lu, \"pulse_moved\": %ld, \"fw_moved\": %ld, \"missed_steps\": %ld, "
+			"\"interval_us_min\": %.1f, \"interval_us_max\": %.1f }%s\n",
+			s.pulses, pulse_moved, fw_moved, lost, s.interval_min_us, s.interval_max_us,
+			i + 1 < MOTORS ? "," : "");
+	}
+
+	printf("  ],\n");
+	printf("  \"responses\": { \"bus\": %lu, \"usb\": %lu, \"ble\": %lu },\n",
+		packets("bus", false), packets("usb", false), packets("ble", false));
+
+	unsigned long failed = checkExpects(opt.stream);
+	printf("  \"expects\": { \"checked\": %lu, \"failed\": %lu }\n", (unsigned long) expects.size(), failed);
+	printf("}\n");
+
+	return (missed || failed) ? 1 : 0;
+}
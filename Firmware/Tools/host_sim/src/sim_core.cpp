@@ -0,0 +1,768 @@
+/*
+
+  sim_core.cpp - simulated clock, interrupts, ports and serial ports
+
+  The sketch runs on the host CPU, so simulated time is charged from host
+  time: every stretch of sketch code between two calls into the core
+  (millis(), micros(), a port write, ...) costs its host run time times
+  the cost scale. With a cost scale of 0 loop passes cost a fixed time and
+  interrupts only what they delay for.
+
+  Interrupts are taken at those calls. One whose event fell during an
+  earlier stretch of loop code is run as if it had preempted it at the
+  event time, and the loop is pushed back by the time it took. As on the
+  AVR, interrupts don't nest, and a timer event that comes round again
+  before its ISR could run is lost, and counted.
+
+*/
+
+#include <time.h>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include <Arduino.h>
+#include <MsTimer2.h>
+#include <TimerOne.h>
+#include <EEPROM.h>
+#include <MemoryFree.h>
+#include "sim.h"
+
+static const double CYCLES_PER_US = F_CPU / 1000000.0;
+
+
+/*  ================================
+    Clock
+    ===============================*/
+
+static double	g_now = 0;				// Simulated us
+static double	g_scale = 100;			// Simulated us per host us
+static unsigned int g_loop_cost = 20;
+static bool		g_in_isr = false;
+static bool		g_irq = true;			// Interrupt flag
+static double	g_irq_since = 0;		// When interrupts were last enabled
+static double	g_isr_free = 0;			// When the last ISR returned
+static uint64_t	g_host_mark = 0;
+static double	g_stop_at = 0;			// Loop context stops here, 0 to run on
+
+static double	g_pass_start;
+static unsigned long g_passes = 0;
+static double	g_pass_total = 0;
+static double	g_pass_max = 0;
+
+static uint64_t host_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+ // Charges the sketch code run since the last call into the core
+static void sync() {
+	uint64_t host = host_ns();
+	if (g_host_mark == 0)
+		g_host_mark = host;
+	if (g_scale > 0)
+		g_now += (host - g_host_mark) * g_scale / 1000.0;
+	g_host_mark = host;
+}
+
+ // Leaves the core, so its own run time isn't charged to the sketch
+static void leave() {
+	g_host_mark = host_ns();
+}
+
+static void dispatch(double p_limit);
+
+uint64_t sim_now() {
+	return (uint64_t) g_now;
+}
+
+void sim_cost_scale(double p_scale) {
+	g_scale = p_scale;
+}
+
+void sim_loop_cost(unsigned int p_us) {
+	g_loop_cost = p_us;
+}
+
+void sim_stop_at(uint64_t p_at) {
+	g_stop_at = p_at;
+}
+
+
+/*  ================================
+    Timers
+    ===============================*/
+
+struct sim_timer {
+	void		(*isr)();
+	bool		running;
+	double		origin;			// Simulated us the timer was started
+	double		period;			// us between events
+	double		next;			// Next event
+	sim_isr_stats stats;
+};
+
+static sim_timer g_t1 = { 0, false, 0, 1000, 0, { "timer1" } };
+static sim_timer g_t2 = { 0, false, 0, 1000, 0, { "mstimer2" } };
+static double	g_t1_event = 0;			// Event the running Timer1 ISR is for
+static unsigned int g_t1_prescale = 1;
+static unsigned int g_t1_top = 0;
+static uint8_t	g_t1_flags = 0;
+static double	g_t1_flags_at = 0;		// Flags are up to date to this time
+
+TimerOne Timer1;
+SimTifr sim_tifr1;
+
+ // Timer1 counts since it was started, at the prescaled clock
+static double t1Counts(double p_at) {
+	return (p_at - g_t1.origin) * CYCLES_PER_US / g_t1_prescale;
+}
+
+ // Raises TOV1 at BOTTOM and ICF1 at TOP (ICR1) for everything up to p_at
+static void t1UpdateFlags(double p_at) {
+
+	if (!g_t1.running || p_at <= g_t1_flags_at || g_t1_top == 0) {
+		g_t1_flags_at = max(g_t1_flags_at, p_at);
+		return;
+	}
+
+	double span = 2.0 * g_t1_top;
+	double from = t1Counts(g_t1_flags_at);
+	double to = t1Counts(p_at);
+
+	if (floor(to / span) > floor(from / span))
+		g_t1_flags |= _BV(TOV1);
+	if (floor((to - g_t1_top) / span) > floor((from - g_t1_top) / span))
+		g_t1_flags |= _BV(ICF1);
+
+	g_t1_flags_at = p_at;
+}
+
+uint16_t sim_timer1_count() {
+	sync();
+	double span = 2.0 * g_t1_top;
+	double c = span > 0 ? fmod(t1Counts(g_now), span) : 0;
+	leave();
+	return (uint16_t) (c <= g_t1_top ? c : span - c);
+}
+
+uint16_t sim_timer1_top() {
+	return g_t1_top;
+}
+
+SimTifr::operator uint8_t() const {
+	sync();
+	t1UpdateFlags(g_now);
+	leave();
+	return g_t1_flags;
+}
+
+SimTifr& SimTifr::operator=(uint8_t p_val) {
+	sync();
+	t1UpdateFlags(g_now);
+	g_t1_flags &= ~p_val;
+	leave();
+	return *this;
+}
+
+ // Period, prescaler and TOP as TimerOne picks them
+void TimerOne::initialize(long p_period) {
+	setPeriod(p_period);
+}
+
+void TimerOne::setPeriod(long p_period) {
+	sync();
+
+	unsigned long cycles = (unsigned long) (F_CPU / 2000000.0 * p_period);
+	static const unsigned int prescales[] = { 1, 8, 64, 256, 1024 };
+	g_t1_prescale = 1024;
+	for (unsigned int p : prescales) {
+		if (cycles / p < 65536) {
+			g_t1_prescale = p;
+			break;
+		}
+	}
+	g_t1_top = min(cycles / g_t1_prescale, 65535UL);
+
+	g_t1.period = 2.0 * g_t1_top * g_t1_prescale / CYCLES_PER_US;
+	g_t1.origin = g_now;
+	g_t1.next = g_now + g_t1.period;
+	g_t1.running = true;
+	g_t1_flags = 0;
+	g_t1_flags_at = g_now;
+	leave();
+}
+
+void TimerOne::attachInterrupt(void (*p_isr)(), long p_period) {
+	if (p_period > 0)
+		setPeriod(p_period);
+	g_t1.isr = p_isr;
+}
+
+void TimerOne::detachInterrupt() {
+	g_t1.isr = 0;
+}
+
+void TimerOne::start() {
+	sync();
+	g_t1.origin = g_now;
+	g_t1.next = g_now + g_t1.period;
+	g_t1.running = true;
+	leave();
+}
+
+void TimerOne::stop() {
+	g_t1.running = false;
+}
+
+void MsTimer2::set(unsigned long p_ms, void (*p_func)()) {
+	g_t2.period = max(p_ms, 1UL) * 1000.0;
+	g_t2.isr = p_func;
+}
+
+void MsTimer2::start() {
+	sync();
+	g_t2.origin = g_now;
+	g_t2.next = g_now + g_t2.period;
+	g_t2.running = true;
+	leave();
+}
+
+void MsTimer2::stop() {
+	g_t2.running = false;
+}
+
+const sim_isr_stats& sim_timer1_stats() {
+	return g_t1.stats;
+}
+
+const sim_isr_stats& sim_mstimer2_stats() {
+	return g_t2.stats;
+}
+
+
+/*  ================================
+    Interrupts
+    ===============================*/
+
+SimSreg SREG;
+
+SimSreg::operator uint8_t() const {
+	return g_irq ? 0x80 : 0;
+}
+
+SimSreg& SimSreg::operator=(uint8_t p_val) {
+	if (p_val & 0x80)
+		sim_sei();
+	else
+		sim_cli();
+	return *this;
+}
+
+void sim_cli() {
+	if (g_in_isr) {
+		g_irq = false;
+		return;
+	}
+	sync();
+	dispatch(g_now);
+	g_irq = false;
+	leave();
+}
+
+void sim_sei() {
+	if (g_in_isr) {
+		g_irq = true;
+		return;
+	}
+	sync();
+	if (!g_irq) {
+		g_irq = true;
+		g_irq_since = g_now;
+	}
+	dispatch(g_now);
+	leave();
+}
+
+ // Runs one timer ISR for the event at p_timer.next
+static void runIsr(sim_timer& p_timer) {
+
+	double event = p_timer.next;
+	double start = max(event, max(g_isr_free, g_irq_since));
+	double loop_now = g_now;
+
+	g_in_isr = true;
+	g_irq = false;
+	g_now = start;
+
+	if (&p_timer == &g_t1) {
+		g_t1_event = event;
+		t1UpdateFlags(start);
+		g_t1_flags &= ~_BV(TOV1);		// Cleared by taking the interrupt
+	}
+
+	uint64_t host_start = host_ns();
+	g_host_mark = host_start;
+	p_timer.isr();
+	sync();
+	double host = (double) (host_ns() - host_start);
+
+	double end = g_now;
+	double took = end - start;
+
+	g_in_isr = false;
+	g_irq = true;
+	g_isr_free = end;
+
+	sim_isr_stats& s = p_timer.stats;
+	s.count++;
+	s.host_ns_total += host;
+	s.host_ns_max = max(s.host_ns_max, host);
+	s.sim_us_total += took;
+	s.sim_us_max = max(s.sim_us_max, took);
+	s.late_us_total += start - event;
+	s.late_us_max = max(s.late_us_max, start - event);
+
+	// The next event, and any that passed while this one ran. The
+	// first of those is still flagged and runs as soon as it can, the
+	// rest are lost.
+	p_timer.next += p_timer.period;
+	while (p_timer.next + p_timer.period <= end) {
+		p_timer.next += p_timer.period;
+		s.dropped++;
+	}
+
+	// The loop was preempted for the length of the ISR
+	g_now = max(loop_now, start) + took;
+}
+
+static void feedInput();
+
+ // Takes every interrupt that is due by p_limit
+static void dispatch(double p_limit) {
+
+	feedInput();
+
+	// DF mode never returns to loop(), so the run is ended from here
+	if (g_stop_at > 0 && g_now >= g_stop_at && !g_in_isr) {
+		leave();
+		throw sim_stopped();
+	}
+
+	while (g_irq && !g_in_isr) {
+		sim_timer* due = 0;
+		if (g_t1.running && g_t1.isr && g_t1.next <= p_limit)
+			due = &g_t1;
+		if (g_t2.running && g_t2.isr && g_t2.next <= p_limit && (!due || g_t2.next < due->next))
+			due = &g_t2;
+		if (!due)
+			break;
+		runIsr(*due);
+	}
+}
+
+void sim_advance(uint64_t p_until) {
+	sync();
+	while (g_now < p_until) {
+		double step = min((double) p_until, g_now + 100.0);
+		dispatch(step);
+		if (g_now < step)
+			g_now = step;
+	}
+	dispatch(g_now);
+	leave();
+}
+
+void sim_loop_begin() {
+	sync();
+	dispatch(g_now);
+	g_pass_start = g_now;
+	leave();
+}
+
+void sim_loop_end() {
+	sync();
+	if (g_scale <= 0)
+		g_now += g_loop_cost;
+	dispatch(g_now);
+
+	double pass = g_now - g_pass_start;
+	g_passes++;
+	g_pass_total += pass;
+	g_pass_max = max(g_pass_max, pass);
+	leave();
+}
+
+void sim_loop_stats(unsigned long& p_passes, double& p_mean, double& p_max) {
+	p_passes = g_passes;
+	p_mean = g_passes ? g_pass_total / g_passes : 0;
+	p_max = g_pass_max;
+}
+
+
+/*  ================================
+    Time
+    ===============================*/
+
+unsigned long micros() {
+	sync();
+	if (!g_in_isr)
+		dispatch(g_now);
+	unsigned long now = (uint32_t) g_now;
+	leave();
+	return now;
+}
+
+unsigned long millis() {
+	sync();
+	if (!g_in_isr)
+		dispatch(g_now);
+	unsigned long now = (uint32_t) (g_now / 1000);
+	leave();
+	return now;
+}
+
+void delay(unsigned long p_ms) {
+	if (g_in_isr) {
+		sync();
+		g_now += p_ms * 1000.0;
+		leave();
+		return;
+	}
+	sync();
+	sim_advance((uint64_t) g_now + p_ms * 1000);
+}
+
+void delayMicroseconds(unsigned int p_us) {
+	if (g_in_isr) {
+		sync();
+		g_now += p_us;
+		leave();
+		return;
+	}
+	sync();
+	sim_advance((uint64_t) g_now + p_us);
+}
+
+long random(long p_max) {
+	return p_max > 0 ? rand() % p_max : 0;
+}
+
+long random(long p_min, long p_max) {
+	return p_max > p_min ? p_min + rand() % (p_max - p_min) : p_min;
+}
+
+void randomSeed(unsigned long p_seed) {
+	srand(p_seed);
+}
+
+
+/*  ================================
+    Ports and pins
+    ===============================*/
+
+SimPort sim_port[6] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 3 }, { 0, 4 }, { 0, 5 } };
+volatile uint8_t sim_ddr[6];
+volatile uint8_t sim_pin[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+	// Step and direction pins of the three motors (OM_MotorMaster.h)
+static const uint8_t STEP_PINS[3]	= { 45, 46, 47 };
+static const uint8_t DIR_PINS[3]	= { 16, 21, 34 };
+
+static sim_step_stats g_steps[3];
+
+static bool pinLevel(uint8_t p_pin) {
+	return sim_port[p_pin >> 3].value & (1 << (p_pin & 7));
+}
+
+SimPort& SimPort::operator=(uint8_t p_val) {
+
+	uint8_t rising = p_val & ~value;
+	value = p_val;
+
+	if (!rising)
+		return *this;
+
+	for (uint8_t i = 0; i < 3; i++) {
+		if ((STEP_PINS[i] >> 3) != index || !(rising & (1 << (STEP_PINS[i] & 7))))
+			continue;
+
+		sync();
+		sim_step_stats& s = g_steps[i];
+		double interval = g_now - s.last_us;
+		if (s.pulses) {
+			if (s.pulses == 1 || interval < s.interval_min_us)
+				s.interval_min_us = interval;
+			if (interval > s.interval_max_us)
+				s.interval_max_us = interval;
+		}
+		s.pulses++;
+		s.last_us = (uint64_t) g_now;
+		s.position += pinLevel(DIR_PINS[i]) ? 1 : -1;
+		leave();
+	}
+
+	return *this;
+}
+
+const sim_step_stats& sim_steps(uint8_t p_motor) {
+	return g_steps[p_motor];
+}
+
+void pinMode(uint8_t p_pin, uint8_t p_mode) {
+	if (p_mode == OUTPUT)
+		sim_ddr[p_pin >> 3] |= (1 << (p_pin & 7));
+	else
+		sim_ddr[p_pin >> 3] &= ~(1 << (p_pin & 7));
+}
+
+void digitalWrite(uint8_t p_pin, uint8_t p_val) {
+	if (p_val)
+		sim_port[p_pin >> 3] |= (1 << (p_pin & 7));
+	else
+		sim_port[p_pin >> 3] &= ~(1 << (p_pin & 7));
+}
+
+int digitalRead(uint8_t p_pin) {
+	uint8_t bit = 1 << (p_pin & 7);
+	if (sim_ddr[p_pin >> 3] & bit)
+		return pinLevel(p_pin);
+	return (sim_pin[p_pin >> 3] & bit) ? HIGH : LOW;
+}
+
+ // Mid-scale readings: a healthy supply, motors attached and idle
+int analogRead(uint8_t p_pin) {
+	return 512;
+}
+
+void attachInterrupt(uint8_t, void (*)(), int) {}
+
+void detachInterrupt(uint8_t) {}
+
+
+/*  ================================
+    Serial ports
+    ===============================*/
+
+struct sim_input {
+	SimSerial*	port;			// 0 for a pin change
+	double		at;
+	std::vector<uint8_t> data;
+	uint8_t		pin;
+	uint8_t		level;
+};
+
+static std::deque<sim_input> g_input;
+static SimSerial* g_serials = 0;
+
+SimSerial Serial("bus");
+SimSerial USBSerial("usb");
+
+SimSerial::SimSerial(const char* p_name) :
+	m_name(p_name), m_baud(19200), m_rxHead(0), m_rxTail(0),
+	m_tx(0), m_txLen(0), m_txSize(0), m_txFreeAt(0) {
+
+	next = g_serials;
+	g_serials = this;
+}
+
+SimSerial* SimSerial::find(const char* p_name) {
+	for (SimSerial* s = g_serials; s; s = s->next)
+		if (!strcmp(s->m_name, p_name))
+			return s;
+	return 0;
+}
+
+void SimSerial::begin(unsigned long p_baud) {
+	m_baud = p_baud;
+}
+
+ // The USB port moves 64 bytes per 1ms frame whatever its baud rate
+static double byteTime(const char* p_name, unsigned long p_baud) {
+	if (!strcmp(p_name, "usb"))
+		return 1000.0 / 64;
+	return 10000000.0 / max(p_baud, 300UL);
+}
+
+int SimSerial::available() {
+	// DF mode polls the port without calling into the clock
+	if (!g_in_isr) {
+		sync();
+		dispatch(g_now);
+		leave();
+	}
+	return (uint8_t) (m_rxHead - m_rxTail);
+}
+
+int SimSerial::read() {
+	if (m_rxHead == m_rxTail)
+		return -1;
+	return m_rx[m_rxTail++];
+}
+
+int SimSerial::peek() {
+	if (m_rxHead == m_rxTail)
+		return -1;
+	return m_rx[m_rxTail];
+}
+
+bool SimSerial::feed(uint8_t p_byte) {
+	if ((uint8_t) (m_rxHead + 1) == m_rxTail)
+		return false;
+	m_rx[m_rxHead++] = p_byte;
+	return true;
+}
+
+int SimSerial::availableForWrite() {
+	sync();
+	double queued = (m_txFreeAt - g_now) / byteTime(m_name, m_baud);
+	leave();
+	return queued <= 0 ? 64 : max(0, 64 - (int) ceil(queued));
+}
+
+size_t SimSerial::write(uint8_t p_byte) {
+
+	// Wait for room in the transmit buffer, as the core does
+	while (!g_in_isr && availableForWrite() == 0)
+		delayMicroseconds((unsigned int) byteTime(m_name, m_baud));
+
+	sync();
+	double free_at = max((double) m_txFreeAt, g_now);
+	m_txFreeAt = (uint64_t) (free_at + byteTime(m_name, m_baud));
+	leave();
+
+	if (m_txLen == m_txSize) {
+		m_txSize = m_txSize ? m_txSize * 2 : 1024;
+		m_tx = (uint8_t*) realloc(m_tx, m_txSize);
+	}
+	m_tx[m_txLen++] = p_byte;
+	return 1;
+}
+
+void sim_queue_input(const char* p_port, uint64_t p_at, const uint8_t* p_data, unsigned int p_len) {
+	sim_input in;
+	in.port = SimSerial::find(p_port);
+	in.at = p_at;
+	in.data.assign(p_data, p_data + p_len);
+	in.pin = 0;
+	in.level = 0;
+	if (in.port)
+		g_input.push_back(in);
+}
+
+void sim_queue_pin(uint8_t p_pin, uint64_t p_at, uint8_t p_level) {
+	sim_input in;
+	in.port = 0;
+	in.at = p_at;
+	in.pin = p_pin;
+	in.level = p_level;
+	g_input.push_back(in);
+}
+
+ // Moves input that has arrived into the ports' receive buffers
+static void feedInput() {
+	while (!g_input.empty() && g_input.front().at <= g_now) {
+		sim_input& in = g_input.front();
+		if (!in.port) {
+			if (in.level)
+				sim_pin[in.pin >> 3] |= (1 << (in.pin & 7));
+			else
+				sim_pin[in.pin >> 3] &= ~(1 << (in.pin & 7));
+			g_input.pop_front();
+			continue;
+		}
+		size_t fed = 0;
+		while (fed < in.data.size() && in.port->feed(in.data[fed]))
+			fed++;
+		if (fed < in.data.size()) {
+			in.data.erase(in.data.begin(), in.data.begin() + fed);
+			break;
+		}
+		g_input.pop_front();
+	}
+}
+
+
+/*  ================================
+    Print
+    ===============================*/
+
+size_t Print::write(const uint8_t* p_buf, size_t p_len) {
+	size_t n = 0;
+	while (p_len--)
+		n += write(*p_buf++);
+	return n;
+}
+
+size_t Print::write(const char* p_str) {
+	return p_str ? write((const uint8_t*) p_str, strlen(p_str)) : 0;
+}
+
+size_t Print::printNumber(unsigned long p_n, uint8_t p_base) {
+	char buf[8 * sizeof(long) + 1];
+	char* str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (p_base < 2)
+		p_base = 10;
+	do {
+		unsigned long m = p_n;
+		p_n /= p_base;
+		char c = m - p_base * p_n;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (p_n);
+	return write(str);
+}
+
+size_t Print::print(const __FlashStringHelper* p_str) { return write((const char*) p_str); }
+size_t Print::print(const char p_str[]) { return write(p_str); }
+size_t Print::print(char p_c) { return write((uint8_t) p_c); }
+size_t Print::print(unsigned char p_n, int p_base) { return print((unsigned long) p_n, p_base); }
+size_t Print::print(unsigned int p_n, int p_base) { return print((unsigned long) p_n, p_base); }
+size_t Print::print(int p_n, int p_base) { return print((long) p_n, p_base); }
+
+size_t Print::print(long p_n, int p_base) {
+	if (p_base == 0)
+		return write((uint8_t) p_n);
+	if (p_base == 10 && p_n < 0)
+		return print('-') + printNumber(-p_n, 10);
+	return printNumber(p_n, p_base);
+}
+
+size_t Print::print(unsigned long p_n, int p_base) {
+	if (p_base == 0)
+		return write((uint8_t) p_n);
+	return printNumber(p_n, p_base);
+}
+
+size_t Print::print(double p_n, int p_digits) {
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%.*f", p_digits, p_n);
+	return write(buf);
+}
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const __FlashStringHelper* p_str) { return print(p_str) + println(); }
+size_t Print::println(const char p_str[]) { return print(p_str) + println(); }
+size_t Print::println(char p_c) { return print(p_c) + println(); }
+size_t Print::println(unsigned char p_n, int p_base) { return print(p_n, p_base) + println(); }
+size_t Print::println(int p_n, int p_base) { return print(p_n, p_base) + println(); }
+size_t Print::println(unsigned int p_n, int p_base) { return print(p_n, p_base) + println(); }
+size_t Print::println(long p_n, int p_base) { return print(p_n, p_base) + println(); }
+size_t Print::println(unsigned long p_n, int p_base) { return print(p_n, p_base) + println(); }
+size_t Print::println(double p_n, int p_digits) { return print(p_n, p_digits) + println(); }
+
+
+/*  ================================
+    Memory
+    ===============================*/
+
+EEPROMClass EEPROM;
+
+	// avr-libc's malloc state, read by OM_Memory
+char* __brkval = 0;
+void* __flp = 0;
+
+int freeMemory() {
+	return 2048;
+}
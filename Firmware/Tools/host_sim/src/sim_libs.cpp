@@ -0,0 +1,517 @@
+/*
+
+  sim_libs.cpp - stand-ins for the OpenMoCo and key frame libraries
+
+  See the headers for what each models.
+
+*/
+
+#include <Arduino.h>
+#include <MsTimer2.h>
+#include <OMMoCoNode.h>
+#include <OMMotorFunctions.h>
+#include <OMCamera.h>
+#include <OMState.h>
+#include <key_frames.h>
+
+
+/*  ================================
+    MoCoBus
+    ===============================*/
+
+OMMoCoBus::OMMoCoBus(Stream* p_stream, uint8_t p_address) :
+	m_stream(p_stream), m_address(p_address) {
+}
+
+void OMMoCoBus::writeHeader() {
+	for (uint8_t i = 0; i < 5; i++)
+		m_stream->write((uint8_t) 0);
+	m_stream->write((uint8_t) 0xFF);
+}
+
+void OMMoCoBus::sendPacket(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_command, uint8_t p_len, uint8_t* p_data) {
+	writeHeader();
+	m_stream->write(p_addr);
+	m_stream->write(p_subaddr);
+	m_stream->write(p_command);
+	m_stream->write(p_len);
+	for (uint8_t i = 0; i < p_len; i++)
+		m_stream->write(p_data[i]);
+}
+
+int OMMoCoBus::ntoi(uint8_t* p_buf) {
+	return (int16_t) ntoui(p_buf);
+}
+
+unsigned int OMMoCoBus::ntoui(uint8_t* p_buf) {
+	return ((unsigned int) p_buf[0] << 8) | p_buf[1];
+}
+
+long OMMoCoBus::ntol(uint8_t* p_buf) {
+	return (int32_t) ntoul(p_buf);
+}
+
+unsigned long OMMoCoBus::ntoul(uint8_t* p_buf) {
+	return ((uint32_t) p_buf[0] << 24) | ((uint32_t) p_buf[1] << 16) | ((uint32_t) p_buf[2] << 8) | p_buf[3];
+}
+
+float OMMoCoBus::ntof(uint8_t* p_buf) {
+	uint32_t bits = ntoul(p_buf);
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+OMMoCoNode::OMMoCoNode(Stream* p_stream, uint8_t p_address, unsigned int p_version, char* p_id) :
+	OMMoCoBus(p_stream, p_address), f_handler(0), f_notUs(0), f_bcast(0), f_addr(0),
+	m_version(p_version), m_id(p_id), m_got(0) {
+}
+
+ // Reads what has arrived, handling each complete packet
+void OMMoCoNode::check() {
+
+	while (m_stream->available()) {
+		uint8_t c = m_stream->read();
+
+		// Header: five zeros then 0xFF, resynchronising on anything else
+		if (m_got < 6) {
+			if (m_got < 5 ? c == 0 : c == 0xFF)
+				m_buf[m_got++] = c;
+			else
+				m_got = (c == 0) ? 1 : 0;
+			continue;
+		}
+
+		m_buf[m_got++] = c;
+
+		if (m_got < 10 || m_got < 10 + m_buf[9])
+			continue;
+
+		m_got = 0;
+
+		uint8_t addr = m_buf[6];
+		uint8_t subaddr = m_buf[7];
+		uint8_t command = m_buf[8];
+		uint8_t* data = m_buf + 10;
+
+		if (addr == m_address) {
+			if (f_handler)
+				f_handler(subaddr, command, data);
+		}
+		else if (addr == OM_SER_BCAST_ADDR) {
+			if (f_bcast)
+				f_bcast(subaddr, command, data);
+		}
+		else if (f_notUs)
+			f_notUs(addr, subaddr, command, m_buf[9], data);
+
+		// One packet per check, as the library does
+		return;
+	}
+}
+
+void OMMoCoNode::respond(uint8_t p_stat, uint8_t p_type, const uint8_t* p_data, uint8_t p_len) {
+	sendPacket(OM_SER_MASTER_ADDR, p_stat, p_type, p_len, (uint8_t*) p_data);
+}
+
+ // Writes p_size bytes of p_val, most significant first
+static void networkOrder(uint32_t p_val, uint8_t* p_out, uint8_t p_size) {
+	for (uint8_t i = 0; i < p_size; i++)
+		p_out[i] = p_val >> (8 * (p_size - 1 - i));
+}
+
+void OMMoCoNode::response(uint8_t p_stat) {
+	respond(p_stat, OM_RES_NONE, 0, 0);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, uint8_t p_resp) {
+	respond(p_stat, OM_RES_BYTE, &p_resp, 1);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, unsigned int p_resp) {
+	uint8_t out[2];
+	networkOrder(p_resp, out, 2);
+	respond(p_stat, OM_RES_UINT, out, 2);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, int p_resp) {
+	uint8_t out[2];
+	networkOrder((uint16_t) p_resp, out, 2);
+	respond(p_stat, OM_RES_INT, out, 2);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, unsigned long p_resp) {
+	uint8_t out[4];
+	networkOrder(p_resp, out, 4);
+	respond(p_stat, OM_RES_ULONG, out, 4);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, long p_resp) {
+	uint8_t out[4];
+	networkOrder((uint32_t) p_resp, out, 4);
+	respond(p_stat, OM_RES_LONG, out, 4);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, float p_resp) {
+	uint32_t bits;
+	uint8_t out[4];
+	memcpy(&bits, &p_resp, sizeof(bits));
+	networkOrder(bits, out, 4);
+	respond(p_stat, OM_RES_FLOAT, out, 4);
+}
+
+void OMMoCoNode::response(uint8_t p_stat, char* p_resp, int p_len) {
+	respond(p_stat, OM_RES_STRING, (const uint8_t*) p_resp, p_len);
+}
+
+
+/*  ================================
+    Motors
+    ===============================*/
+
+uint8_t OMMotorFunctions::s_planType = 0;
+bool OMMotorFunctions::s_debug = false;
+
+	// Direction pins, by step flag (PORTF5-7)
+static uint8_t motorDirPin(uint8_t p_flag) {
+	static const uint8_t pins[] = { 16, 21, 34 };
+	return pins[(p_flag - 5) % 3];
+}
+
+OMMotorFunctions::OMMotorFunctions(int p_step, int p_dir, int p_slp, int p_ms1, int p_ms2, int p_ms3, uint8_t p_stpreg, uint8_t p_stpflg) :
+	m_mode(MODE_IDLE), m_enable(false), m_sleep(false), m_dir(true), m_continuous(false),
+	m_sending(false), m_backCheck(false), m_programDone(false), m_ms(1), m_lastMs(1),
+	m_backlash(0), m_easing(0), m_units(0), m_maxSpeed(1000), m_maxStepRate(5000),
+	m_contSpeed(100), m_contAccel(0), m_gbox(1), m_plat(1),
+	m_pos(0), m_startPos(0), m_stopPos(0), m_endPos(0), m_maxSteps(0),
+	m_leadIn(0), m_travel(0), m_leadOut(0), m_accelLen(0), m_decelLen(0),
+	m_left(0), m_vel(0), m_top(0), m_accel(0), m_decel(0), m_phase(0),
+	stpflg(p_stpflg), mt_plan(0), autoPause(false) {
+}
+
+uint8_t OMMotorFunctions::maxStepRate(unsigned int p_rate) {
+	if (p_rate != 10000 && p_rate != 5000 && p_rate != 4000 && p_rate != 2000 && p_rate != 1000)
+		return false;
+	m_maxStepRate = p_rate;
+	return true;
+}
+
+void OMMotorFunctions::contSpeed(float p_speed) {
+	m_contSpeed = p_speed;
+	if (p_speed < 0)
+		m_dir = false;
+	else if (p_speed > 0 && m_mode == MODE_CONT)
+		m_dir = true;
+}
+
+void OMMotorFunctions::startMove(bool p_dir, unsigned long p_steps, float p_top, float p_accel, float p_decel) {
+	if (!m_enable || p_steps == 0 || p_top <= 0) {
+		m_mode = MODE_IDLE;
+		return;
+	}
+	m_dir = p_dir;
+	m_left = p_steps;
+	m_top = min(p_top, (float) m_maxStepRate);
+	m_accel = p_accel;
+	m_decel = p_decel;
+	m_vel = (p_accel > 0) ? 0 : m_top;
+	m_phase = 0;
+	m_mode = MODE_MOVE;
+}
+
+void OMMotorFunctions::move(bool p_dir, unsigned long p_steps) {
+
+	// No steps in continuous mode runs until stopped
+	if (p_steps == 0) {
+		if (!m_continuous || !m_enable)
+			return;
+		m_dir = p_dir;
+		m_phase = 0;
+		m_mode = MODE_CONT;
+		return;
+	}
+
+	float speed = fabs(m_contSpeed) > 0 ? fabs(m_contSpeed) : m_maxSpeed;
+	startMove(p_dir, p_steps, speed, m_contAccel, m_contAccel);
+}
+
+ // A move of p_steps arriving after p_time ms, ramping up over p_accel ms and down over p_decel ms
+void OMMotorFunctions::move(bool p_dir, unsigned long p_steps, unsigned long p_time, unsigned long p_accel, unsigned long p_decel) {
+
+	float cruise = p_time - (p_accel + p_decel) / 2.0f;
+	if (cruise <= 0)
+		cruise = max(p_time, 1UL);
+
+	float top = p_steps / (cruise / 1000.0f);
+	float accel = p_accel ? top / (p_accel / 1000.0f) : 0;
+	float decel = p_decel ? top / (p_decel / 1000.0f) : 0;
+	startMove(p_dir, p_steps, top, accel, decel);
+}
+
+void OMMotorFunctions::moveTo(long p_pos, bool p_send) {
+	long dist = p_pos - m_pos;
+	if (dist == 0)
+		return;
+	bool save = m_continuous;
+	m_continuous = false;
+	move(dist > 0, dist > 0 ? dist : -dist);
+	m_continuous = save;
+}
+
+ // One SMS shot's share of the travel
+void OMMotorFunctions::programMove() {
+	long dist = m_stopPos - m_startPos;
+	unsigned long shots = max(m_travel, 1UL);
+	long steps = dist / (long) shots;
+	if (steps == 0)
+		return;
+	move(steps > 0, steps > 0 ? steps : -steps);
+	if ((steps > 0 && m_pos + steps >= m_stopPos) || (steps < 0 && m_pos + steps <= m_stopPos))
+		m_programDone = true;
+}
+
+ // A continuous program: the whole travel as one timed move
+void OMMotorFunctions::planRun() {
+	long dist = m_stopPos - m_pos;
+	m_programDone = false;
+	if (dist == 0 || s_planType == 0)
+		return;
+	move(dist > 0, dist > 0 ? dist : -dist, max(m_travel, 1UL), m_accelLen, m_decelLen);
+}
+
+void OMMotorFunctions::planReverse() {
+	long start = m_startPos;
+	m_startPos = m_stopPos;
+	m_stopPos = start;
+}
+
+float OMMotorFunctions::getTopSpeed() {
+	return m_mode == MODE_MOVE ? m_top : fabs(m_contSpeed);
+}
+
+float OMMotorFunctions::desiredSpeed() {
+	return m_dir ? m_vel : -m_vel;
+}
+
+void OMMotorFunctions::stop() {
+	m_mode = MODE_IDLE;
+	m_vel = 0;
+	m_left = 0;
+}
+
+void OMMotorFunctions::clear() {
+	stop();
+	m_programDone = false;
+}
+
+ // Called once per step ISR tick, true when a step is due
+bool OMMotorFunctions::checkStep() {
+
+	if (m_mode == MODE_IDLE)
+		return false;
+
+	float dt = 1.0f / m_maxStepRate;
+
+	if (m_mode == MODE_CONT) {
+		float target = fabs(m_contSpeed);
+		if (m_contAccel > 0) {
+			float dv = m_contAccel * dt;
+			m_vel = (m_vel < target) ? min(m_vel + dv, target) : max(m_vel - dv, target);
+		}
+		else
+			m_vel = target;
+
+		if (m_vel <= 0 && target <= 0) {
+			stop();
+			return false;
+		}
+	}
+	else {
+		// Ramp down in time to stop on the last step
+		bool braking = m_decel > 0 && (m_vel * m_vel) / (2 * m_decel) >= m_left;
+		if (braking)
+			m_vel = max(m_vel - m_decel * dt, m_decel * dt);
+		else if (m_accel > 0 && m_vel < m_top)
+			m_vel = min(m_vel + m_accel * dt, m_top);
+	}
+
+	m_phase += min(m_vel * dt, 1.0f);
+	if (m_phase < 1.0f)
+		return false;
+
+	m_phase -= 1.0f;
+	digitalWrite(motorDirPin(stpflg), m_dir ? HIGH : LOW);
+	m_pos += m_dir ? 1 : -1;
+
+	if (m_mode == MODE_MOVE && --m_left == 0)
+		stop();
+
+	return true;
+}
+
+
+/*  ================================
+    Camera
+    ===============================*/
+
+bool OMCamera::s_debug = false;
+uint8_t OMCamera::s_curAct = 0;
+bool OMCamera::s_busy = false;
+void (*OMCamera::f_camSignal)(uint8_t) = 0;
+
+static uint8_t g_camDone = 0;
+
+OMCamera::OMCamera() :
+	m_interval(1000), m_trigger(100), m_focus(0), m_delay(100), m_maxShots(0),
+	m_expFocus(0), enable(false), repeat(0) {
+}
+
+ // Starts an action of p_time ms, signalling p_signal now and p_done at the end
+void OMCamera::start(uint8_t p_act, uint8_t p_signal, uint8_t p_done, unsigned long p_time) {
+
+	if (p_time == 0) {
+		if (f_camSignal)
+			f_camSignal(p_done);
+		return;
+	}
+
+	s_curAct = p_act;
+	g_camDone = p_done;
+	s_busy = true;
+	MsTimer2::set(p_time, OMCamera::stop);
+	MsTimer2::start();
+
+	if (f_camSignal)
+		f_camSignal(p_signal);
+}
+
+void OMCamera::stop() {
+	MsTimer2::stop();
+	bool was_busy = s_busy;
+	s_busy = false;
+	s_curAct = 0;
+	if (was_busy && f_camSignal)
+		f_camSignal(g_camDone);
+}
+
+void OMCamera::expose() {
+	expose(m_trigger);
+}
+
+void OMCamera::expose(unsigned long p_time) {
+	start(OM_CAM_INEXP, OM_CAMEXP, OM_CAM_EFIN, p_time);
+}
+
+void OMCamera::focus() {
+	start(OM_CAM_INFOC, OM_CAMFOC, OM_CAM_FFIN, m_focus);
+}
+
+void OMCamera::wait() {
+	start(OM_CAM_INDLY, OM_CAMWAIT, OM_CAM_WFIN, m_delay);
+}
+
+
+/*  ================================
+    State engine
+    ===============================*/
+
+OMState::OMState(uint8_t p_count) : m_count(min(p_count, (uint8_t) 16)), m_state(0) {
+	memset(m_handlers, 0, sizeof(m_handlers));
+}
+
+void OMState::setHandler(uint8_t p_state, void (*p_func)()) {
+	if (p_state < m_count)
+		m_handlers[p_state] = p_func;
+}
+
+void OMState::checkCycle() {
+	if (m_state < m_count && m_handlers[m_state])
+		m_handlers[m_state]();
+}
+
+
+/*  ================================
+    Key frames
+    ===============================*/
+
+KeyFrames* KeyFrames::s_axes = 0;
+uint8_t KeyFrames::s_axisCount = 0;
+uint8_t KeyFrames::s_axis = 0;
+int KeyFrames::s_updateRate = 10;
+unsigned long KeyFrames::s_contVidTime = 10000;
+float KeyFrames::s_maxVel = 4000;
+float KeyFrames::s_maxAccel = 20000;
+
+KeyFrames::KeyFrames() : m_xnCount(0), m_fnCount(0), m_dnCount(0), m_kfCount(0) {
+	memset(m_xn, 0, sizeof(m_xn));
+	memset(m_fn, 0, sizeof(m_fn));
+	memset(m_dn, 0, sizeof(m_dn));
+}
+
+ // Segment holding p_x, clamped to the spline's ends
+uint8_t KeyFrames::segment(float p_x) {
+	uint8_t s = 0;
+	while (s + 2 < m_kfCount && p_x > m_xn[s + 1])
+		s++;
+	return s;
+}
+
+float KeyFrames::pos(float p_x) {
+	if (m_kfCount < 2)
+		return m_kfCount ? m_fn[0] : 0;
+	uint8_t s = segment(p_x);
+	float h = m_xn[s + 1] - m_xn[s];
+	float t = h > 0 ? constrain((p_x - m_xn[s]) / h, 0.0f, 1.0f) : 0;
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return (2 * t3 - 3 * t2 + 1) * m_fn[s] + (t3 - 2 * t2 + t) * h * m_dn[s]
+		+ (-2 * t3 + 3 * t2) * m_fn[s + 1] + (t3 - t2) * h * m_dn[s + 1];
+}
+
+float KeyFrames::vel(float p_x) {
+	if (m_kfCount < 2)
+		return 0;
+	uint8_t s = segment(p_x);
+	float h = m_xn[s + 1] - m_xn[s];
+	if (h <= 0)
+		return 0;
+	float t = constrain((p_x - m_xn[s]) / h, 0.0f, 1.0f);
+	float t2 = t * t;
+	return ((6 * t2 - 6 * t) * m_fn[s] + (3 * t2 - 4 * t + 1) * h * m_dn[s]
+		+ (-6 * t2 + 6 * t) * m_fn[s + 1] + (3 * t2 - 2 * t) * h * m_dn[s + 1]) / h;
+}
+
+float KeyFrames::accel(float p_x) {
+	if (m_kfCount < 2)
+		return 0;
+	uint8_t s = segment(p_x);
+	float h = m_xn[s + 1] - m_xn[s];
+	if (h <= 0)
+		return 0;
+	float t = constrain((p_x - m_xn[s]) / h, 0.0f, 1.0f);
+	return ((12 * t - 6) * m_fn[s] + (6 * t - 4) * h * m_dn[s]
+		+ (-12 * t + 6) * m_fn[s + 1] + (6 * t - 2) * h * m_dn[s + 1]) / (h * h);
+}
+
+ // Samples the spline; velocities are per ms, the limits per second
+bool KeyFrames::validateVel() {
+	if (m_kfCount < 2)
+		return true;
+	float x0 = m_xn[0];
+	float len = m_xn[m_kfCount - 1] - x0;
+	for (int i = 0; i <= 100; i++)
+		if (fabs(vel(x0 + len * i / 100)) * 1000 > s_maxVel)
+			return false;
+	return true;
+}
+
+bool KeyFrames::validateAccel() {
+	if (m_kfCount < 2)
+		return true;
+	float x0 = m_xn[0];
+	float len = m_xn[m_kfCount - 1] - x0;
+	for (int i = 0; i <= 100; i++)
+		if (fabs(accel(x0 + len * i / 100)) * 1000000 > s_maxAccel)
+			return false;
+	return true;
+}
@@ -0,0 +1,16 @@
+/*
+
+  sketch_tu.cpp - the sketch, as the Arduino IDE builds it, plus what the
+  harness needs to look at inside it
+
+*/
+
+#include "sketch.cpp"
+#include "sim.h"
+
+ // Position the firmware believes each motor is at
+long sim_fw_position(uint8_t p_motor) {
+	if (df_mode)
+		return motors[p_motor].position;
+	return motor[p_motor].currentPos();
+}
@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+"""
+Decodes the binary log records the Motion Engine sends over USB when the
+DB_BINLOG debug flag is set (see Motion_Engine/OM_Log.h). The records come
+packed in MoCoBus packets with command LOG_PUSH_CMD; any other packets in
+the capture are skipped.
+
+The token text and the serial command messages are read straight from the
+firmware sources, so the decoder stays in step with the firmware it sits
+next to.
+
+Usage:
+	log_decode.py <capture file>        decode a raw capture
+	log_decode.py /dev/ttyACM0          decode live from the serial port
+"""
+
+import os
+import re
+import struct
+import sys
+
+LOG_SYNC = 0xA5
+LOG_RECORD_LEN = 12
+LOG_CMD = 0
+LOG_PUSH_CMD = 241
+
+# MoCoBus packet header, followed by address, subaddress, command and data length
+PACKET_HEADER = b'\x00\x00\x00\x00\x00\xff'
+PACKET_HEAD_LEN = len(PACKET_HEADER) + 4
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Motion_Engine')
+
+# Serial command handler for each subaddress
+HANDLERS = {0: 'serMain', 1: 'serMotor', 2: 'serMotor', 3: 'serMotor', 4: 'serCamera', 5: 'serKeyFrame'}
+GROUPS = {0: 'Gen. ', 1: 'Mot. ', 2: 'Mot. ', 3: 'Mot. ', 4: 'Cam. ', 5: 'Kf. '}
+
+
+def read_source(name):
+	with open(os.path.join(SRC, name)) as f:
+		return f.read()
+
+
+def load_tokens():
+	""" Token text, in token order, from the LOG_S_ table in OM_Log.ino """
+	return re.findall(r'^const char LOG_S_\w+\[\]\s+PROGMEM = "(.*)";', read_source('OM_Log.ino'), re.M)
+
+
+def load_commands():
+	""" {handler: {command: message}} from the msg = "..." lines in OM_Serial_Com_Client.ino """
+	src = read_source('OM_Serial_Com_Client.ino')
+	commands = {}
+	handler = None
+	case = None
+
+	for line in src.splitlines():
+		m = re.match(r'^void (ser\w+)\(', line)
+		if m:
+			handler = m.group(1)
+			commands.setdefault(handler, {})
+			continue
+		m = re.match(r'\s*case (\d+):', line)
+		if m:
+			case = int(m.group(1))
+			continue
+		m = re.match(r'\s*msg = "(.*)";', line)
+		if m and handler and case is not None:
+			commands[handler].setdefault(case, m.group(1))
+
+	return commands
+
+
+def packets(stream):
+	""" Yields (subaddress, command, data) for each MoCoBus packet, resyncing on the header """
+	buf = b''
+	while True:
+		data = stream.read(64)
+		if not data:
+			return
+		buf += data
+		while True:
+			start = buf.find(PACKET_HEADER)
+			if start < 0:
+				buf = buf[-(len(PACKET_HEADER) - 1):]
+				break
+			buf = buf[start:]
+			if len(buf) < PACKET_HEAD_LEN:
+				break
+			subaddr, command, length = struct.unpack('BBB', buf[7:PACKET_HEAD_LEN])
+			if len(buf) < PACKET_HEAD_LEN + length:
+				break
+			yield subaddr, command, buf[PACKET_HEAD_LEN:PACKET_HEAD_LEN + length]
+			buf = buf[PACKET_HEAD_LEN + length:]
+
+
+def records(stream):
+	""" Yields the log records out of the log packets, skipping any other traffic """
+	for subaddr, command, data in packets(stream):
+		if subaddr != 0 or command != LOG_PUSH_CMD:
+			continue
+		for i in range(0, len(data) - LOG_RECORD_LEN + 1, LOG_RECORD_LEN):
+			rec = data[i:i + LOG_RECORD_LEN]
+			if bytearray(rec[:1])[0] == LOG_SYNC:
+				yield rec
+
+
+def decode(rec, tokens, commands):
+	token, subaddr, command, time = struct.unpack('<xBBBL', rec[:8])
+
+	if token == LOG_CMD:
+		value = struct.unpack('<f', rec[8:])[0]
+		text = commands.get(HANDLERS.get(subaddr), {}).get(command, '?')
+		if subaddr in (1, 2, 3):
+			line = '%s%d - motor %d - %s' % (GROUPS[subaddr], command, subaddr - 1, text)
+		else:
+			line = '%s%d - %s' % (GROUPS.get(subaddr, 'Unknown '), command, text)
+		if value != -1e9:
+			line += '%g' % value
+	else:
+		value = struct.unpack('<l', rec[8:])[0]
+		line = tokens[token] if token < len(tokens) else 'Unknown token %d' % token
+		if line.endswith(': '):
+			line += str(value)
+
+	return 'Time: %d - %s' % (time, line)
+
+
+def main():
+	if len(sys.argv) != 2:
+		sys.exit(__doc__)
+
+	tokens = load_tokens()
+	commands = load_commands()
+
+	with open(sys.argv[1], 'rb') as stream:
+		for rec in records(stream):
+			print(decode(rec, tokens, commands))
+
+
+if __name__ == '__main__':
+	main()